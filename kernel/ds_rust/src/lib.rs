@@ -1,14 +1,19 @@
-#![no_std]
-#![no_main]
+// The "host" feature builds a std library for the benchmarks in host_bench
+#![cfg_attr(not(feature = "host"), no_std)]
+#![cfg_attr(not(feature = "host"), no_main)]
 
 // Panic handler for bare metal
+#[cfg(not(feature = "host"))]
 #[panic_handler]
 fn panic(_info: &core::panic::PanicInfo) -> ! {
     loop {}
 }
 
 use core::ptr;
+use core::cell::Cell;
 use core::ffi::{c_char, c_int, c_void};
+use core::arch::x86_64::_rdtsc;
+use core::sync::atomic::{AtomicU32, Ordering};
 
 // External GPU functions
 extern "C" {
@@ -21,6 +26,103 @@ extern "C" {
         width: u32,
         height: u32,
     );
+    fn gpu_blit_stream(
+        dst: *mut u32,
+        dst_pitch: u32,
+        src: *const u32,
+        src_pitch: u32,
+        width: u32,
+        height: u32,
+    );
+    fn gpu_stream_fence();
+    fn gpu_get_stream_threshold() -> u32;
+    fn gpu_describe_pixel_format(
+        bpp: u16,
+        red_size: u8,
+        red_shift: u8,
+        green_size: u8,
+        green_shift: u8,
+        blue_size: u8,
+        blue_shift: u8,
+    ) -> GpuPixelFormat;
+    fn gpu_scale_row(dst: *mut u32, src: *const u32, width: u32, scale: u32);
+    fn gpu_convert_blit(
+        dst: *mut u8,
+        dst_pitch: u32,
+        src: *const u32,
+        src_pitch: u32,
+        width: u32,
+        height: u32,
+        format: *const GpuPixelFormat,
+    );
+}
+
+// External logger functions
+extern "C" {
+    fn logger_write_port(port: u32, data: *const u8, length: u32);
+}
+
+// virtio-console port for captured frames, UART when absent (must match virtio_console.h)
+const CAPTURE_PORT: u32 = 2;
+
+// External binary trace functions (see trace.h)
+extern "C" {
+    fn trace_emit(event: u32, phase: u32, a0: u64, a1: u64, a2: u64);
+}
+
+// Trace event ids and phases (must match trace.h)
+const TRACE_DS_COMPOSITE: u32 = 3;
+const TRACE_DS_PRESENT: u32 = 4;
+const TRACE_DS_SCANOUT: u32 = 5;
+const TRACE_ALLOC: u32 = 10;
+const TRACE_BEGIN: u32 = b'B' as u32;
+const TRACE_END: u32 = b'E' as u32;
+const TRACE_INSTANT: u32 = b'i' as u32;
+
+// External hardware counter scopes (see pmu.h)
+extern "C" {
+    fn perf_scope(name: *const c_char) -> u32;
+    fn perf_begin(scope: u32);
+    fn perf_end(scope: u32);
+}
+
+// Scope ids, registered with the C side on first use (must match pmu.h)
+const PERF_SCOPE_NONE: u32 = u32::MAX;
+static PERF_DS_RENDER: AtomicU32 = AtomicU32::new(PERF_SCOPE_NONE);
+static PERF_DS_PRESENT: AtomicU32 = AtomicU32::new(PERF_SCOPE_NONE);
+
+fn perf_scope_id(cache: &AtomicU32, name: &'static [u8]) -> u32 {
+    let mut id = cache.load(Ordering::Relaxed);
+    if id == PERF_SCOPE_NONE {
+        id = unsafe { perf_scope(name.as_ptr() as *const c_char) };
+        cache.store(id, Ordering::Relaxed);
+    }
+    id
+}
+
+// Frame capture modes (headless rendering regression and performance tests)
+const CAPTURE_OFF: u32 = 0;
+const CAPTURE_HASH: u32 = 1;  // One "FRAME" line with a content hash per presented frame
+const CAPTURE_RLE: u32 = 2;   // Full frame as run-length encoded RGB after each "FRAME" line
+
+// Emit a "CAPSTATS" summary line every this many captured frames
+const CAPTURE_STATS_INTERVAL: u64 = 60;
+
+// Canonical composition format - everything else is converted at flush time
+const PIXEL_FORMAT_XRGB8888: u32 = 0;
+
+// Pixel format descriptor (must match GPU module definition)
+#[repr(C)]
+#[derive(Copy, Clone)]
+pub struct GpuPixelFormat {
+    pub kind: u32,
+    pub bytes_per_pixel: u32,
+    pub red_size: u8,
+    pub red_shift: u8,
+    pub green_size: u8,
+    pub green_shift: u8,
+    pub blue_size: u8,
+    pub blue_shift: u8,
 }
 
 // Limine framebuffer structure (must match C struct)
@@ -126,6 +228,20 @@ struct DisplayServer {
     wallpaper_width: u32,
     wallpaper_height: u32,
     has_wallpaper: bool,
+    pixel_format: GpuPixelFormat,  // Native framebuffer format (backbuffer is always XRGB8888)
+    scanout_active: bool,          // Fullscreen surface is being scanned out directly
+    framebuffer_stale: bool,       // Something else wrote VRAM: scanline hashes are out of date
+    scale: u32,                    // Integer HiDPI factor: clients and the backbuffer use logical pixels
+    bytes_flushed: Cell<u64>,      // Bytes written to the framebuffer during the current frame
+    flush_stream: Cell<bool>,      // Current flush uses non-temporal stores (see begin_flush)
+    capture_mode: u32,
+    capture_offscreen: bool,       // Render into the backbuffer only, never touch VRAM
+    capture_frames: u64,
+    capture_total_bytes: u64,
+    capture_total_cycles: u64,
+    capture_last_tsc: u64,
+    capture_tsc_hz: u64,
+    outline: DirtyRect,            // Interactive resize preview, drawn above surfaces
 }
 
 // Backbuffer for double buffering - statically allocated
@@ -133,6 +249,90 @@ struct DisplayServer {
 const MAX_BACKBUFFER_SIZE: usize = 3840 * 2160;
 static mut BACKBUFFER: [u32; MAX_BACKBUFFER_SIZE] = [0; MAX_BACKBUFFER_SIZE];
 
+// HiDPI upscaling: largest supported factor and the row staging buffer.
+// Wider scaled rows (5K and up) are written in chunks of this many pixels.
+const MAX_SCALE: u32 = 4;
+const MAX_SCALED_ROW: usize = 3840;
+static mut SCALE_ROW_BUFFER: [u32; MAX_SCALED_ROW] = [0; MAX_SCALED_ROW];
+
+// Per-scanline-segment hashes of what was last written to the framebuffer.
+// Dirty segments whose content hash didn't change are not rewritten to VRAM.
+// A hash of 0 means "unknown" and always forces a write.
+const SCANLINE_SEGMENT_WIDTH: usize = 64;
+const MAX_SEGMENTS_PER_ROW: usize = 3840 / SCANLINE_SEGMENT_WIDTH;
+const MAX_SCANLINES: usize = 2160;
+static mut SCANLINE_HASHES: [u32; MAX_SEGMENTS_PER_ROW * MAX_SCANLINES] = [0; MAX_SEGMENTS_PER_ROW * MAX_SCANLINES];
+
+// FNV-1a over whole pixels, continuing from a previous hash
+#[inline(always)]
+unsafe fn hash_pixels(mut hash: u32, src: *const u32, len: usize) -> u32 {
+    for i in 0..len {
+        hash = (hash ^ *src.add(i)).wrapping_mul(0x01000193);
+    }
+    hash
+}
+
+// Segment hash, forced non-zero so it never reads as "unknown"
+#[inline(always)]
+unsafe fn hash_segment(src: *const u32, len: usize) -> u32 {
+    hash_pixels(0x811c9dc5, src, len) | 1
+}
+
+// Small output buffer for capture lines and frame payloads (serial or virtio-console)
+struct LineBuffer {
+    buf: [u8; 256],
+    len: usize,
+}
+
+impl LineBuffer {
+    fn new() -> Self {
+        LineBuffer { buf: [0; 256], len: 0 }
+    }
+    
+    fn push_str(&mut self, bytes: &[u8]) {
+        for &b in bytes {
+            if self.len == self.buf.len() {
+                self.flush();
+            }
+            self.buf[self.len] = b;
+            self.len += 1;
+        }
+    }
+    
+    fn push_dec(&mut self, mut value: u64) {
+        let mut digits = [0u8; 20];
+        let mut count = 0;
+        loop {
+            digits[count] = b'0' + (value % 10) as u8;
+            value /= 10;
+            count += 1;
+            if value == 0 {
+                break;
+            }
+        }
+        while count > 0 {
+            count -= 1;
+            self.push_str(&[digits[count]]);
+        }
+    }
+    
+    fn push_hex(&mut self, value: u32) {
+        const HEX: &[u8; 16] = b"0123456789abcdef";
+        for i in (0..8).rev() {
+            self.push_str(&[HEX[((value >> (i * 4)) & 0xF) as usize]]);
+        }
+    }
+    
+    fn flush(&mut self) {
+        if self.len > 0 {
+            unsafe {
+                logger_write_port(CAPTURE_PORT, self.buf.as_ptr(), self.len as u32);
+            }
+            self.len = 0;
+        }
+    }
+}
+
 // Wallpaper buffer - store decoded image for desktop background
 const MAX_WALLPAPER_SIZE: usize = 1920 * 1080; // Support up to Full HD
 static mut WALLPAPER_BUFFER: [u32; MAX_WALLPAPER_SIZE] = [0; MAX_WALLPAPER_SIZE];
@@ -142,6 +342,31 @@ static mut SURFACE_POOL: [Option<Surface>; 32] = [const { None }; 32];
 const MAX_BUFFER_SIZE: usize = 800 * 600; // VGA resolution
 static mut BUFFER_POOL: [[u32; MAX_BUFFER_SIZE]; 32] = [[0; MAX_BUFFER_SIZE]; 32];
 
+// One screen-sized buffer for a surface too large for its pool slot (a
+// maximized window), so fullscreen surfaces can be scanned out directly
+const MAX_SCANOUT_SIZE: usize = 1920 * 1080;
+static mut SCANOUT_BUFFER: [u32; MAX_SCANOUT_SIZE] = [0; MAX_SCANOUT_SIZE];
+static mut SCANOUT_OWNER: Option<usize> = None; // Surface pool slot using it
+
+// Backing store of a surface pool slot
+unsafe fn slot_buffer(slot: usize) -> *mut u32 {
+    if SCANOUT_OWNER == Some(slot) {
+        ptr::addr_of_mut!(SCANOUT_BUFFER) as *mut u32
+    } else {
+        BUFFER_POOL[slot].as_mut_ptr()
+    }
+}
+
+// Largest width * height the surface in a pool slot can be resized to: the
+// scanout buffer while it's free or already the slot's, otherwise the slot
+unsafe fn slot_capacity(slot: usize) -> usize {
+    if SCANOUT_OWNER.map_or(true, |owner| owner == slot) {
+        MAX_SCANOUT_SIZE
+    } else {
+        MAX_BUFFER_SIZE
+    }
+}
+
 // Display server state
 static mut DS_STATE: Option<DisplayServer> = None;
 
@@ -167,13 +392,49 @@ impl DisplayServer {
             wallpaper_width: 0,
             wallpaper_height: 0,
             has_wallpaper: false,
+            pixel_format: GpuPixelFormat {
+                kind: PIXEL_FORMAT_XRGB8888,
+                bytes_per_pixel: 4,
+                red_size: 8,
+                red_shift: 16,
+                green_size: 8,
+                green_shift: 8,
+                blue_size: 8,
+                blue_shift: 0,
+            },
+            scanout_active: false,
+            framebuffer_stale: false,
+            scale: 1,
+            bytes_flushed: Cell::new(0),
+            flush_stream: Cell::new(false),
+            capture_mode: CAPTURE_OFF,
+            capture_offscreen: false,
+            capture_frames: 0,
+            capture_total_bytes: 0,
+            capture_total_cycles: 0,
+            capture_last_tsc: 0,
+            capture_tsc_hz: 0,
+            outline: DirtyRect::new(),
         };
         
-        // Initialize backbuffer dimensions
+        // Initialize backbuffer dimensions and negotiate the scanout format
         unsafe {
             if !framebuffer.is_null() {
-                ds.backbuffer_width = (*framebuffer).width as u32;
-                ds.backbuffer_height = (*framebuffer).height as u32;
+                // Default scale: one logical pixel per 1920x1080 "unit" of screen (2x on 4K)
+                let fit_w = (*framebuffer).width as u32 / 1920;
+                let fit_h = (*framebuffer).height as u32 / 1080;
+                ds.scale = fit_w.min(fit_h).max(1).min(MAX_SCALE);
+                ds.backbuffer_width = (*framebuffer).width as u32 / ds.scale;
+                ds.backbuffer_height = (*framebuffer).height as u32 / ds.scale;
+                ds.pixel_format = gpu_describe_pixel_format(
+                    (*framebuffer).bpp,
+                    (*framebuffer).red_mask_size,
+                    (*framebuffer).red_mask_shift,
+                    (*framebuffer).green_mask_size,
+                    (*framebuffer).green_mask_shift,
+                    (*framebuffer).blue_mask_size,
+                    (*framebuffer).blue_mask_shift,
+                );
             }
         }
         
@@ -208,8 +469,8 @@ impl DisplayServer {
                 self.dirty_rect = DirtyRect {
                     x: 0,
                     y: 0,
-                    width: (*fb).width as u32,
-                    height: (*fb).height as u32,
+                    width: (*fb).width as u32 / self.scale,
+                    height: (*fb).height as u32 / self.scale,
                     valid: true,
                 };
                 self.full_redraw = true;
@@ -253,6 +514,8 @@ impl DisplayServer {
             };
             
             new_surface.buffer = BUFFER_POOL[slot].as_mut_ptr();
+            trace_emit(TRACE_ALLOC, TRACE_INSTANT, width as u64 * height as u64 * 4,
+                       new_surface.buffer as u64, 0);
             
             SURFACE_POOL[slot] = Some(new_surface);
             SURFACE_POOL[slot].as_mut().unwrap() as *mut Surface
@@ -288,6 +551,9 @@ impl DisplayServer {
                     let surface_id = (*surface).id as usize;
                     if surface_id < 32 {
                         SURFACE_POOL[surface_id] = None;
+                        if SCANOUT_OWNER == Some(surface_id) {
+                            SCANOUT_OWNER = None;
+                        }
                     }
                 }
                 break;
@@ -319,16 +585,31 @@ impl DisplayServer {
         self.sort_surfaces_by_z_order();
     }
 
-    fn set_surface_size(&mut self, surface: *mut Surface, width: u32, height: u32) {
+    // Returns false (and keeps the old size) if no buffer can hold the new size
+    fn set_surface_size(&mut self, surface: *mut Surface, width: u32, height: u32) -> bool {
         unsafe {
             let old_x = (*surface).x;
             let old_y = (*surface).y;
             let old_width = (*surface).width;
             let old_height = (*surface).height;
             
-            let buffer_size = (width * height) as usize;
+            let slot = (*surface).id as usize;
+            if slot >= 32 {
+                return false;
+            }
+            
+            // Sizes above the pool slot limit move to the scanout buffer, if it's free
+            let buffer_size = width as usize * height as usize;
             if buffer_size > MAX_BUFFER_SIZE {
-                return; // New size too large
+                if buffer_size > slot_capacity(slot) {
+                    return false; // New size too large
+                }
+                SCANOUT_OWNER = Some(slot);
+            } else if SCANOUT_OWNER == Some(slot) {
+                SCANOUT_OWNER = None;
+            }
+            if !(*surface).buffer.is_null() {
+                (*surface).buffer = slot_buffer(slot);
             }
             
             (*surface).width = width;
@@ -338,6 +619,24 @@ impl DisplayServer {
             self.mark_dirty(old_x, old_y, old_width, old_height);
             self.mark_dirty(old_x, old_y, width, height);
         }
+        true
+    }
+
+    // Hidden surfaces keep their pool buffer but are detached from compositing
+    // (a null buffer is skipped by every render path)
+    fn set_surface_visible(&mut self, surface: *mut Surface, visible: bool) {
+        unsafe {
+            let slot = (*surface).id as usize;
+            if slot >= 32 {
+                return;
+            }
+            (*surface).buffer = if visible {
+                slot_buffer(slot)
+            } else {
+                ptr::null_mut()
+            };
+            self.mark_dirty((*surface).x, (*surface).y, (*surface).width, (*surface).height);
+        }
     }
 
     fn sort_surfaces_by_z_order(&mut self) {
@@ -357,6 +656,11 @@ impl DisplayServer {
 
     fn get_surface_buffer(&self, surface: *mut Surface) -> *mut u32 {
         unsafe {
+            // Clients keep drawing into hidden surfaces
+            let slot = (*surface).id as usize;
+            if (*surface).buffer.is_null() && slot < 32 {
+                return slot_buffer(slot);
+            }
             (*surface).buffer
         }
     }
@@ -425,6 +729,61 @@ impl DisplayServer {
         }
     }
 
+    // Show (or move) the resize outline; only the old and new outline areas are damaged
+    fn set_outline(&mut self, x: i32, y: i32, width: u32, height: u32) {
+        if self.outline.valid {
+            let old = self.outline;
+            self.mark_dirty(old.x, old.y, old.width, old.height);
+        }
+        self.outline = DirtyRect { x, y, width, height, valid: true };
+        self.mark_dirty(x, y, width, height);
+    }
+    
+    fn clear_outline(&mut self) {
+        if self.outline.valid {
+            let old = self.outline;
+            self.mark_dirty(old.x, old.y, old.width, old.height);
+            self.outline.clear();
+        }
+    }
+    
+    // Draw the resize outline frame into the dirty part of the backbuffer
+    fn render_outline_to_backbuffer(&mut self, dirty: &DirtyRect) {
+        const OUTLINE_WIDTH: i32 = 2;
+        const OUTLINE_COLOR: u32 = 0x4a90e2;
+        
+        let o = self.outline;
+        if !o.valid || !dirty.valid {
+            return;
+        }
+        let right = o.x + o.width as i32;
+        let bottom = o.y + o.height as i32;
+        let edges = [
+            (o.x, o.y, right, o.y + OUTLINE_WIDTH),                  // Top
+            (o.x, bottom - OUTLINE_WIDTH, right, bottom),            // Bottom
+            (o.x, o.y, o.x + OUTLINE_WIDTH, bottom),                 // Left
+            (right - OUTLINE_WIDTH, o.y, right, bottom),             // Right
+        ];
+        
+        unsafe {
+            let backbuffer = self.get_backbuffer();
+            let bb_width = self.backbuffer_width as usize;
+            
+            for &(x0, y0, x1, y1) in edges.iter() {
+                let start_x = x0.max(dirty.x).max(0);
+                let start_y = y0.max(dirty.y).max(0);
+                let end_x = x1.min(dirty.x + dirty.width as i32).min(self.backbuffer_width as i32);
+                let end_y = y1.min(dirty.y + dirty.height as i32).min(self.backbuffer_height as i32);
+                
+                for y in start_y..end_y {
+                    for x in start_x..end_x {
+                        *backbuffer.add(y as usize * bb_width + x as usize) = OUTLINE_COLOR;
+                    }
+                }
+            }
+        }
+    }
+
     fn surface_overlaps_dirty(&self, surface: *mut Surface, dirty: &DirtyRect) -> bool {
         if !dirty.valid {
             return false;
@@ -658,10 +1017,9 @@ impl DisplayServer {
                 return;
             }
             
-            let fb_ptr = (*fb).address;
-            let fb_pitch = (*fb).pitch as usize / 4;
-            let fb_width = (*fb).width as usize;
-            let fb_height = (*fb).height as usize;
+            // Everything up to the final write is in logical pixels
+            let fb_width = (*fb).width as usize / self.scale as usize;
+            let fb_height = (*fb).height as usize / self.scale as usize;
             
             let backbuffer = self.get_backbuffer();
             let bb_width = self.backbuffer_width as usize;
@@ -678,15 +1036,172 @@ impl DisplayServer {
                 return;
             }
             
+            self.begin_flush(width, height);
+            
+            // Too large for the hash table, write everything
+            if fb_width > MAX_SEGMENTS_PER_ROW * SCANLINE_SEGMENT_WIDTH || fb_height > MAX_SCANLINES {
+                let src_region = backbuffer.add(start_y * bb_width + start_x);
+                self.blit_to_framebuffer(src_region, bb_width, start_x, start_y, width, height);
+                self.end_flush();
+                return;
+            }
+            
+            // Walk the dirty rows segment by segment and only write segments
+            // whose content changed since they were last sent to the framebuffer
+            let first_seg = start_x / SCANLINE_SEGMENT_WIDTH;
+            let last_seg = (end_x - 1) / SCANLINE_SEGMENT_WIDTH;
+            
+            for y in start_y..end_y {
+                let row = backbuffer.add(y * bb_width);
+                let hashes = (ptr::addr_of_mut!(SCANLINE_HASHES) as *mut u32).add(y * MAX_SEGMENTS_PER_ROW);
+                
+                // Start of the current run of changed segments, if any
+                let mut run_start: Option<usize> = None;
+                
+                for seg in first_seg..=last_seg {
+                    let seg_x = seg * SCANLINE_SEGMENT_WIDTH;
+                    let seg_len = SCANLINE_SEGMENT_WIDTH.min(fb_width - seg_x);
+                    let hash = hash_segment(row.add(seg_x), seg_len);
+                    
+                    if *hashes.add(seg) != hash {
+                        *hashes.add(seg) = hash;
+                        if run_start.is_none() {
+                            run_start = Some(seg_x);
+                        }
+                    } else if let Some(run_x) = run_start {
+                        self.blit_to_framebuffer(row.add(run_x), bb_width, run_x, y, seg_x - run_x, 1);
+                        run_start = None;
+                    }
+                }
+                
+                if let Some(run_x) = run_start {
+                    let run_end = ((last_seg + 1) * SCANLINE_SEGMENT_WIDTH).min(fb_width);
+                    self.blit_to_framebuffer(row.add(run_x), bb_width, run_x, y, run_end - run_x, 1);
+                }
+            }
+            
+            self.end_flush();
+        }
+    }
+    
+    // Choose the store type for a whole flush from the size of its dirty region.
+    // The flush is written as many small blits (single-row runs when hashing),
+    // so deciding per blit would almost never stream and fence after every row.
+    fn begin_flush(&self, width: usize, height: usize) {
+        unsafe {
+            let scale = self.scale as usize;
+            let bytes = (width * height * scale * scale * 4) as u64;
+            let threshold = gpu_get_stream_threshold();
+            self.flush_stream.set(threshold != u32::MAX && bytes >= threshold as u64);
+        }
+    }
+    
+    // Make the flush's streaming stores visible before anything that follows
+    fn end_flush(&self) {
+        if self.flush_stream.get() {
+            unsafe {
+                gpu_stream_fence();
+            }
+            self.flush_stream.set(false);
+        }
+    }
+
+    // Forget what the framebuffer holds, so the next flush writes every dirty segment.
+    // Needed whenever the framebuffer is written behind the hash table's back.
+    fn invalidate_scanline_hashes(&mut self) {
+        unsafe {
+            ptr::write_bytes(ptr::addr_of_mut!(SCANLINE_HASHES) as *mut u32, 0,
+                             MAX_SEGMENTS_PER_ROW * MAX_SCANLINES);
+        }
+    }
+
+    // Write a block of logical XRGB8888 pixels to the framebuffer at logical (x, y),
+    // upscaling by the HiDPI factor on the way out.
+    // The caller is responsible for clipping the block to the logical screen.
+    fn blit_to_framebuffer(&self, src_region: *const u32, src_pitch: usize,
+                           x: usize, y: usize, width: usize, height: usize) {
+        unsafe {
+            if self.get_framebuffer().is_null() || width == 0 || height == 0 {
+                return;
+            }
+            
+            let scale = self.scale as usize;
+            let bytes = (width * height * scale * scale) as u64 * self.pixel_format.bytes_per_pixel as u64;
+            self.bytes_flushed.set(self.bytes_flushed.get() + bytes);
+            
+            if self.capture_offscreen {
+                return;
+            }
+            
+            if scale == 1 {
+                self.write_framebuffer(src_region, src_pitch, x, y, width, height);
+                return;
+            }
+            
+            // Expand each row horizontally once, then write it scale times
+            // (source pitch 0 repeats the same row)
+            let scaled = ptr::addr_of_mut!(SCALE_ROW_BUFFER) as *mut u32;
+            let chunk_width = MAX_SCALED_ROW / scale;
+            for row in 0..height {
+                let src_row = src_region.add(row * src_pitch);
+                let mut chunk_x = 0;
+                while chunk_x < width {
+                    let w = chunk_width.min(width - chunk_x);
+                    gpu_scale_row(scaled, src_row.add(chunk_x), w as u32, scale as u32);
+                    self.write_framebuffer(scaled, 0, (x + chunk_x) * scale, (y + row) * scale, w * scale, scale);
+                    chunk_x += w;
+                }
+            }
+        }
+    }
+
+    // Write a block of XRGB8888 pixels to the framebuffer at physical (x, y),
+    // converting to the native pixel format if needed
+    fn write_framebuffer(&self, src_region: *const u32, src_pitch: usize,
+                         x: usize, y: usize, width: usize, height: usize) {
+        unsafe {
+            let fb = self.get_framebuffer();
+            
+            let fb_ptr = (*fb).address;
+            let fb_pitch_bytes = (*fb).pitch as usize;
+            
+            // Non-native framebuffer formats go through the conversion kernels
+            if self.pixel_format.kind != PIXEL_FORMAT_XRGB8888 {
+                let bytes_per_pixel = self.pixel_format.bytes_per_pixel as usize;
+                let dst_region = (fb_ptr as *mut u8).add(y * fb_pitch_bytes + x * bytes_per_pixel);
+                gpu_convert_blit(
+                    dst_region,
+                    fb_pitch_bytes as u32,
+                    src_region,
+                    src_pitch as u32,
+                    width as u32,
+                    height as u32,
+                    &self.pixel_format,
+                );
+                return;
+            }
+            
+            let fb_pitch = fb_pitch_bytes / 4;
+            
             // Try GPU-accelerated rendering first
             if gpu_is_available() {
-                let src_region = backbuffer.add(start_y * bb_width + start_x);
-                let dst_region = fb_ptr.add(start_y * fb_pitch + start_x);
+                let dst_region = fb_ptr.add(y * fb_pitch + x);
+                if self.flush_stream.get() {
+                    gpu_blit_stream(
+                        dst_region,
+                        fb_pitch as u32,
+                        src_region,
+                        src_pitch as u32,
+                        width as u32,
+                        height as u32,
+                    );
+                    return;
+                }
                 gpu_blit(
                     dst_region,
                     fb_pitch as u32,
                     src_region,
-                    bb_width as u32,
+                    src_pitch as u32,
                     width as u32,
                     height as u32,
                 );
@@ -694,13 +1209,136 @@ impl DisplayServer {
             }
             
             // Fallback to CPU-based copy
-            for y in start_y..end_y {
-                if width > 0 {
-                    let src = backbuffer.add(y * bb_width + start_x);
-                    let dst = fb_ptr.add(y * fb_pitch + start_x);
-                    core::ptr::copy_nonoverlapping(src, dst, width);
+            for row in 0..height {
+                let src = src_region.add(row * src_pitch);
+                let dst = fb_ptr.add((y + row) * fb_pitch + x);
+                core::ptr::copy_nonoverlapping(src, dst, width);
+            }
+        }
+    }
+
+    // Find a surface that can be scanned out directly: the topmost surface
+    // covering the whole framebuffer, so nothing but the cursor is above it.
+    // Pool slots hold 800x600, so above that only a surface in the scanout
+    // buffer (up to 1920x1080 logical pixels) can qualify.
+    fn find_scanout_surface(&self) -> Option<*mut Surface> {
+        // Captured frames are read back from the backbuffer, so it must stay complete.
+        // The resize outline is also drawn there.
+        if self.surface_count == 0 || self.capture_mode != CAPTURE_OFF || self.outline.valid {
+            return None;
+        }
+        
+        let top = self.surfaces[self.surface_count - 1]?;
+        unsafe {
+            if (*top).buffer.is_null() {
+                return None;
+            }
+            
+            if (*top).x == 0 && (*top).y == 0 &&
+               (*top).width >= self.backbuffer_width &&
+               (*top).height >= self.backbuffer_height {
+                Some(top)
+            } else {
+                None
+            }
+        }
+    }
+
+    // Copy damaged rows straight from a fullscreen surface to the framebuffer.
+    // Only the cursor area goes through the backbuffer.
+    fn render_direct_scanout(&mut self, surface: *mut Surface) {
+        unsafe {
+            const CURSOR_WIDTH: i32 = 12;
+            const CURSOR_HEIGHT: i32 = 16;
+            
+            // Entering scanout: the framebuffer has to be fully refreshed once
+            if !self.scanout_active {
+                self.scanout_active = true;
+                self.mark_full_dirty();
+                self.full_redraw = false;
+            }
+            
+            let bb_width = self.backbuffer_width as usize;
+            let bb_height = self.backbuffer_height as usize;
+            let surf_w = (*surface).width as usize;
+            let surf_buffer = (*surface).buffer;
+            let backbuffer = self.get_backbuffer();
+            
+            // Refresh the backbuffer under the new cursor position from the surface,
+            // so the cursor is drawn over (and later restored to) current content
+            let cursor_visible = self.mouse_x >= 0 && self.mouse_y >= 0 &&
+                self.mouse_x < bb_width as i32 && self.mouse_y < bb_height as i32;
+            let cx0 = (self.mouse_x - 1).max(0) as usize;
+            let cy0 = (self.mouse_y - 1).max(0) as usize;
+            let cx1 = ((self.mouse_x + CURSOR_WIDTH + 1).min(bb_width as i32)).max(0) as usize;
+            let cy1 = ((self.mouse_y + CURSOR_HEIGHT + 1).min(bb_height as i32)).max(0) as usize;
+            
+            if cursor_visible {
+                for y in cy0..cy1 {
+                    core::ptr::copy_nonoverlapping(
+                        surf_buffer.add(y * surf_w + cx0),
+                        backbuffer.add(y * bb_width + cx0),
+                        cx1 - cx0,
+                    );
+                }
+                // The old backup refers to stale backbuffer content
+                self.cursor_backup_valid = false;
+                self.last_cursor_x = -1;
+                self.last_cursor_y = -1;
+                // Marks the cursor area dirty, so it is flushed below
+                self.render_cursor_to_backbuffer();
+            }
+            
+            let dirty = self.dirty_rect;
+            if dirty.valid {
+                let start_x = dirty.x.max(0) as usize;
+                let start_y = dirty.y.max(0) as usize;
+                let end_x = ((dirty.x + dirty.width as i32).min(bb_width as i32)).max(0) as usize;
+                let end_y = ((dirty.y + dirty.height as i32).min(bb_height as i32)).max(0) as usize;
+                
+                if start_x < end_x && start_y < end_y {
+                    self.begin_flush(end_x - start_x, end_y - start_y);
+                    
+                    // Split the damaged rows around the cursor so it never flickers
+                    let splits_cursor = cursor_visible && cx0 < end_x && cx1 > start_x;
+                    let mid_x0 = cx0.max(start_x);
+                    let mid_x1 = cx1.min(end_x);
+                    
+                    let mut y = start_y;
+                    while y < end_y {
+                        let in_cursor_rows = splits_cursor && y >= cy0 && y < cy1;
+                        
+                        // Batch consecutive rows that share the same layout
+                        let run_end = if in_cursor_rows {
+                            end_y.min(cy1)
+                        } else if splits_cursor && y < cy0 {
+                            end_y.min(cy0)
+                        } else {
+                            end_y
+                        };
+                        let rows = run_end - y;
+                        
+                        if in_cursor_rows {
+                            self.blit_to_framebuffer(surf_buffer.add(y * surf_w + start_x), surf_w,
+                                                     start_x, y, mid_x0 - start_x, rows);
+                            self.blit_to_framebuffer(backbuffer.add(y * bb_width + mid_x0), bb_width,
+                                                     mid_x0, y, mid_x1 - mid_x0, rows);
+                            self.blit_to_framebuffer(surf_buffer.add(y * surf_w + mid_x1), surf_w,
+                                                     mid_x1, y, end_x - mid_x1, rows);
+                        } else {
+                            self.blit_to_framebuffer(surf_buffer.add(y * surf_w + start_x), surf_w,
+                                                     start_x, y, end_x - start_x, rows);
+                        }
+                        
+                        y = run_end;
+                    }
+                    
+                    self.end_flush();
                 }
             }
+            
+            self.dirty_rect.clear();
+            self.bytes_flushed.set(0);
         }
     }
 
@@ -713,15 +1351,42 @@ impl DisplayServer {
             
             // Initialize backbuffer on first render
             if !self.backbuffer_initialized {
-                self.backbuffer_width = (*fb).width as u32;
-                self.backbuffer_height = (*fb).height as u32;
+                self.backbuffer_width = (*fb).width as u32 / self.scale;
+                self.backbuffer_height = (*fb).height as u32 / self.scale;
                 self.backbuffer_initialized = true;
                 self.full_redraw = true;
             }
             
+            // Fullscreen surface on top: skip the backbuffer pass entirely
+            if let Some(surface) = self.find_scanout_surface() {
+                trace_emit(TRACE_DS_SCANOUT, TRACE_BEGIN, 0, 0, 0);
+                self.render_direct_scanout(surface);
+                trace_emit(TRACE_DS_SCANOUT, TRACE_END, 0, 0, 0);
+                return;
+            }
+            
+            // Leaving direct scanout: the backbuffer is stale, rebuild it
+            if self.scanout_active {
+                self.scanout_active = false;
+                self.full_redraw = true;
+                self.cursor_backup_valid = false;
+                self.last_cursor_x = -1;
+                self.last_cursor_y = -1;
+            }
+            
+            // VRAM was written behind our back (terminal output): don't trust the hashes
+            if self.framebuffer_stale {
+                self.framebuffer_stale = false;
+                self.invalidate_scanline_hashes();
+            }
+            
             let needs_full_redraw = self.full_redraw || !self.desktop_cleared;
+            trace_emit(TRACE_DS_COMPOSITE, TRACE_BEGIN, 0, 0, 0);
+            let perf_render = perf_scope_id(&PERF_DS_RENDER, b"ds_render\0");
+            perf_begin(perf_render);
             
             if needs_full_redraw {
+                self.invalidate_scanline_hashes();
                 self.clear_backbuffer();
                 self.desktop_cleared = true;
                 self.full_redraw = false;
@@ -750,6 +1415,7 @@ impl DisplayServer {
                         }
                     }
                 }
+                self.render_outline_to_backbuffer(&dirty_rect_copy);
             }
             
             // Always render cursor last on backbuffer
@@ -799,14 +1465,189 @@ impl DisplayServer {
                 self.dirty_rect = dirty_rect_copy;
             }
             
+            let dirty_pixels = if self.dirty_rect.valid {
+                self.dirty_rect.width as u64 * self.dirty_rect.height as u64
+            } else {
+                0
+            };
+            perf_end(perf_render);
+            trace_emit(TRACE_DS_COMPOSITE, TRACE_END, dirty_pixels, 0, 0);
+            
             // Copy backbuffer to framebuffer (always include cursor area if valid)
             if self.dirty_rect.valid {
+                let perf_present = perf_scope_id(&PERF_DS_PRESENT, b"ds_present\0");
+                trace_emit(TRACE_DS_PRESENT, TRACE_BEGIN, 0, 0, 0);
+                perf_begin(perf_present);
                 self.copy_backbuffer_to_framebuffer(&self.dirty_rect);
+                perf_end(perf_present);
+                trace_emit(TRACE_DS_PRESENT, TRACE_END, self.bytes_flushed.get(), 0, 0);
             }
             
             // Clear dirty rectangle after rendering
             self.dirty_rect.clear();
+            
+            if self.capture_mode != CAPTURE_OFF {
+                self.capture_frame();
+            }
+            self.bytes_flushed.set(0);
+        }
+    }
+
+    fn set_scale(&mut self, scale: u32) {
+        unsafe {
+            let fb = self.get_framebuffer();
+            if fb.is_null() || scale == 0 || scale > MAX_SCALE {
+                return;
+            }
+            
+            self.scale = scale;
+            self.backbuffer_width = (*fb).width as u32 / scale;
+            self.backbuffer_height = (*fb).height as u32 / scale;
+            
+            // Cursor backup and scanout state refer to the old geometry
+            self.cursor_backup_valid = false;
+            self.last_cursor_x = -1;
+            self.last_cursor_y = -1;
+            self.mouse_x = self.mouse_x.min(self.backbuffer_width as i32 - 1);
+            self.mouse_y = self.mouse_y.min(self.backbuffer_height as i32 - 1);
+            self.scanout_active = false;
+            self.full_redraw = true;
+        }
+    }
+
+    fn start_capture(&mut self, mode: u32, offscreen: bool, tsc_hz: u64) {
+        self.capture_mode = mode;
+        self.capture_offscreen = offscreen;
+        self.capture_frames = 0;
+        self.capture_total_bytes = 0;
+        self.capture_total_cycles = 0;
+        self.capture_last_tsc = 0;
+        self.capture_tsc_hz = tsc_hz;
+        
+        // First captured frame is a complete image
+        self.full_redraw = true;
+    }
+
+    fn stop_capture(&mut self) {
+        if self.capture_mode == CAPTURE_OFF {
+            return;
+        }
+        
+        self.emit_capture_stats();
+        self.capture_mode = CAPTURE_OFF;
+        
+        // VRAM is stale after offscreen rendering
+        if self.capture_offscreen {
+            self.capture_offscreen = false;
+            self.full_redraw = true;
+        }
+    }
+
+    // Emit the current frame over serial. Frames where nothing reached the
+    // framebuffer are not presented and therefore not captured.
+    fn capture_frame(&mut self) {
+        let bytes = self.bytes_flushed.get();
+        if bytes == 0 {
+            return;
+        }
+        
+        let now = unsafe { _rdtsc() };
+        let cycles = if self.capture_last_tsc != 0 { now - self.capture_last_tsc } else { 0 };
+        self.capture_last_tsc = now;
+        
+        self.capture_frames += 1;
+        self.capture_total_bytes += bytes;
+        self.capture_total_cycles += cycles;
+        
+        let width = self.backbuffer_width as usize;
+        let height = self.backbuffer_height as usize;
+        let backbuffer = self.get_backbuffer();
+        
+        // Content hash over the whole visible frame, for golden-image comparison
+        let mut hash: u32 = 0x811c9dc5;
+        for y in 0..height {
+            unsafe {
+                hash = hash_pixels(hash, backbuffer.add(y * width), width);
+            }
+        }
+        
+        let mut line = LineBuffer::new();
+        line.push_str(b"FRAME ");
+        line.push_dec(self.capture_frames);
+        line.push_str(b" hash=");
+        line.push_hex(hash);
+        line.push_str(b" bytes=");
+        line.push_dec(bytes);
+        line.push_str(b" cycles=");
+        line.push_dec(cycles);
+        line.push_str(b" size=");
+        line.push_dec(width as u64);
+        line.push_str(b"x");
+        line.push_dec(height as u64);
+        line.push_str(b"\n");
+        line.flush();
+        
+        if self.capture_mode == CAPTURE_RLE {
+            self.emit_rle_frame();
+        }
+        
+        if self.capture_frames % CAPTURE_STATS_INTERVAL == 0 {
+            self.emit_capture_stats();
+        }
+    }
+
+    // Frame payload: runs of [count, r, g, b] bytes in row-major order,
+    // terminated by a run with count 0
+    fn emit_rle_frame(&self) {
+        let width = self.backbuffer_width as usize;
+        let total = width * self.backbuffer_height as usize;
+        let backbuffer = self.get_backbuffer();
+        
+        let mut out = LineBuffer::new();
+        let mut i = 0;
+        while i < total {
+            let color = unsafe { *backbuffer.add(i) } & 0xFFFFFF;
+            let mut run = 1;
+            while run < 255 && i + run < total && (unsafe { *backbuffer.add(i + run) } & 0xFFFFFF) == color {
+                run += 1;
+            }
+            
+            if out.len + 4 > out.buf.len() {
+                out.flush();
+            }
+            out.push_str(&[run as u8, (color >> 16) as u8, (color >> 8) as u8, color as u8]);
+            i += run;
         }
+        
+        out.push_str(&[0, 0, 0, 0]);
+        out.flush();
+    }
+
+    fn emit_capture_stats(&self) {
+        let frames = self.capture_frames;
+        let mut line = LineBuffer::new();
+        line.push_str(b"CAPSTATS frames=");
+        line.push_dec(frames);
+        
+        if frames > 0 {
+            line.push_str(b" avg_bytes=");
+            line.push_dec(self.capture_total_bytes / frames);
+            line.push_str(b" avg_cycles=");
+            line.push_dec(self.capture_total_cycles / frames);
+            
+            // Frames/sec with one decimal, if the TSC frequency is known
+            if self.capture_tsc_hz != 0 && self.capture_total_cycles != 0 {
+                let fps10 = (self.capture_tsc_hz as u128 * 10 * frames as u128
+                    / self.capture_total_cycles as u128) as u64;
+                line.push_str(b" fps=");
+                line.push_dec(fps10 / 10);
+                line.push_str(b".");
+                line.push_dec(fps10 % 10);
+            }
+        }
+        
+        line.push_str(b"\n");
+        line.flush();
     }
 
     fn update_cursor_position(&mut self, x: i32, y: i32) {
@@ -880,14 +1721,27 @@ pub extern "C" fn ds_set_surface_z_order(surface: *mut Surface, z_order: c_int)
 }
 
 #[no_mangle]
-pub extern "C" fn ds_set_surface_size(surface: *mut Surface, width: u32, height: u32) {
+pub extern "C" fn ds_set_surface_size(surface: *mut Surface, width: u32, height: u32) -> bool {
     unsafe {
         if let Some(ref mut ds) = DS_STATE {
-            ds.set_surface_size(surface, width, height);
+            ds.set_surface_size(surface, width, height)
+        } else {
+            false
         }
     }
 }
 
+// Largest width * height ds_set_surface_size currently accepts for the surface
+#[no_mangle]
+pub extern "C" fn ds_get_surface_capacity(surface: *mut Surface) -> u32 {
+    unsafe {
+        if surface.is_null() || (*surface).id as usize >= 32 {
+            return 0;
+        }
+        slot_capacity((*surface).id as usize) as u32
+    }
+}
+
 #[no_mangle]
 pub extern "C" fn ds_get_surface_buffer(surface: *mut Surface) -> *mut u32 {
     unsafe {
@@ -925,3 +1779,108 @@ pub extern "C" fn ds_render() {
         }
     }
 }
+
+#[no_mangle]
+pub extern "C" fn ds_set_surface_visible(surface: *mut Surface, visible: bool) {
+    unsafe {
+        if let Some(ref mut ds) = DS_STATE {
+            if !surface.is_null() {
+                ds.set_surface_visible(surface, visible);
+            }
+        }
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn ds_set_outline(x: c_int, y: c_int, width: u32, height: u32) {
+    unsafe {
+        if let Some(ref mut ds) = DS_STATE {
+            ds.set_outline(x, y, width, height);
+        }
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn ds_clear_outline() {
+    unsafe {
+        if let Some(ref mut ds) = DS_STATE {
+            ds.clear_outline();
+        }
+    }
+}
+
+// True when the next ds_render() has something to flush
+#[no_mangle]
+pub extern "C" fn ds_has_damage() -> bool {
+    unsafe {
+        if let Some(ref ds) = DS_STATE {
+            ds.dirty_rect.valid || ds.full_redraw || !ds.backbuffer_initialized
+        } else {
+            false
+        }
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn ds_capture_start(mode: u32, offscreen: bool, tsc_hz: u64) {
+    unsafe {
+        if let Some(ref mut ds) = DS_STATE {
+            if mode == CAPTURE_HASH || mode == CAPTURE_RLE {
+                ds.start_capture(mode, offscreen, tsc_hz);
+            }
+        }
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn ds_capture_stop() {
+    unsafe {
+        if let Some(ref mut ds) = DS_STATE {
+            ds.stop_capture();
+        }
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn ds_invalidate_scanline_hashes() {
+    unsafe {
+        if let Some(ref mut ds) = DS_STATE {
+            ds.framebuffer_stale = true;
+        }
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn ds_set_scale(scale: u32) {
+    unsafe {
+        if let Some(ref mut ds) = DS_STATE {
+            ds.set_scale(scale);
+        }
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn ds_get_scale() -> u32 {
+    unsafe {
+        if let Some(ref ds) = DS_STATE {
+            ds.scale
+        } else {
+            1
+        }
+    }
+}
+
+// Logical screen size that clients lay themselves out in
+#[no_mangle]
+pub extern "C" fn ds_get_screen_size(width: *mut u32, height: *mut u32) {
+    unsafe {
+        if let Some(ref ds) = DS_STATE {
+            if !width.is_null() {
+                *width = ds.backbuffer_width;
+            }
+            if !height.is_null() {
+                *height = ds.backbuffer_height;
+            }
+        }
+    }
+}
@@ -1,7 +1,9 @@
-#![no_std]
-#![no_main]
+// The "host" feature builds a std library for the benchmarks in host_bench
+#![cfg_attr(not(feature = "host"), no_std)]
+#![cfg_attr(not(feature = "host"), no_main)]
 
 // Panic handler for bare metal
+#[cfg(not(feature = "host"))]
 #[panic_handler]
 fn panic(_info: &core::panic::PanicInfo) -> ! {
     loop {}
@@ -10,6 +12,19 @@ fn panic(_info: &core::panic::PanicInfo) -> ! {
 use core::ptr;
 use core::ffi::{c_char, c_int};
 
+// External binary trace functions (see trace.h)
+extern "C" {
+    fn trace_emit(event: u32, phase: u32, a0: u64, a1: u64, a2: u64);
+}
+
+// Trace event ids and phases (must match trace.h)
+const TRACE_FS_READ: u32 = 6;
+const TRACE_FS_WRITE: u32 = 7;
+const TRACE_FS_CREATE: u32 = 8;
+const TRACE_FS_DELETE: u32 = 9;
+const TRACE_BEGIN: u32 = b'B' as u32;
+const TRACE_END: u32 = b'E' as u32;
+
 // File system constants - match C definitions
 pub const MAX_FILES: usize = 16;
 pub const MAX_FILENAME_LENGTH: usize = 32;
@@ -414,7 +429,10 @@ pub extern "C" fn fs_create_file(name: *const c_char, file_type: c_int) -> bool
             } else {
                 FileType::Directory
             };
-            fs.create_file(name, ft)
+            trace_emit(TRACE_FS_CREATE, TRACE_BEGIN, 0, 0, 0);
+            let created = fs.create_file(name, ft);
+            trace_emit(TRACE_FS_CREATE, TRACE_END, created as u64, 0, 0);
+            created
         } else {
             false
         }
@@ -425,7 +443,10 @@ pub extern "C" fn fs_create_file(name: *const c_char, file_type: c_int) -> bool
 pub extern "C" fn fs_delete_file(name: *const c_char) -> bool {
     unsafe {
         if let Some(ref fs) = FS_STATE {
-            fs.delete_file(name)
+            trace_emit(TRACE_FS_DELETE, TRACE_BEGIN, 0, 0, 0);
+            let deleted = fs.delete_file(name);
+            trace_emit(TRACE_FS_DELETE, TRACE_END, deleted as u64, 0, 0);
+            deleted
         } else {
             false
         }
@@ -447,7 +468,10 @@ pub extern "C" fn fs_find_file(name: *const c_char) -> *mut File {
 pub extern "C" fn fs_write_file(name: *const c_char, data: *const u8, size: usize) -> bool {
     unsafe {
         if let Some(ref fs) = FS_STATE {
-            fs.write_file(name, data, size)
+            trace_emit(TRACE_FS_WRITE, TRACE_BEGIN, size as u64, 0, 0);
+            let written = fs.write_file(name, data, size);
+            trace_emit(TRACE_FS_WRITE, TRACE_END, size as u64, written as u64, 0);
+            written
         } else {
             false
         }
@@ -458,7 +482,11 @@ pub extern "C" fn fs_write_file(name: *const c_char, data: *const u8, size: usiz
 pub extern "C" fn fs_read_file(name: *const c_char, buffer: *mut u8, size: *mut usize) -> bool {
     unsafe {
         if let Some(ref fs) = FS_STATE {
-            fs.read_file(name, buffer, size)
+            trace_emit(TRACE_FS_READ, TRACE_BEGIN, 0, 0, 0);
+            let read = fs.read_file(name, buffer, size);
+            let bytes = if read && !size.is_null() { *size as u64 } else { 0 };
+            trace_emit(TRACE_FS_READ, TRACE_END, bytes, read as u64, 0);
+            read
         } else {
             false
         }
@@ -1,7 +1,9 @@
-#![no_std]
-#![no_main]
+// The "host" feature builds a std library for the benchmarks in host_bench
+#![cfg_attr(not(feature = "host"), no_std)]
+#![cfg_attr(not(feature = "host"), no_main)]
 
 // Panic handler for bare metal
+#[cfg(not(feature = "host"))]
 #[panic_handler]
 fn panic(_info: &core::panic::PanicInfo) -> ! {
     loop {}
@@ -9,6 +11,7 @@ fn panic(_info: &core::panic::PanicInfo) -> ! {
 
 use core::ptr;
 use core::ffi::c_void;
+use core::arch::x86_64::*;
 
 // GPU rendering context
 #[repr(C)]
@@ -18,6 +21,7 @@ pub struct GpuContext {
     height: u32,
     pitch: u32,
     gpu_available: bool,
+    stream_threshold: usize,  // Blits of at least this many bytes use non-temporal stores
 }
 
 static mut GPU_CONTEXT: Option<GpuContext> = None;
@@ -32,10 +36,143 @@ pub extern "C" fn gpu_init(framebuffer: *mut c_void, width: u32, height: u32, pi
             height,
             pitch,
             gpu_available: true,
+            stream_threshold: STREAM_DISABLED,
         });
+        
+        // Pick the flush strategy for this machine's framebuffer memory
+        if !framebuffer.is_null() {
+            let available = (height as usize) * (pitch as usize) * 2;
+            let threshold = calibrate_stream_threshold(framebuffer as *mut u32, available);
+            if let Some(ctx) = get_context() {
+                ctx.stream_threshold = threshold;
+            }
+        }
+    }
+}
+
+// Get the blit size (in bytes) from which non-temporal stores are used
+// Returns 0xFFFFFFFF when streaming stores never won during calibration
+#[no_mangle]
+pub extern "C" fn gpu_get_stream_threshold() -> u32 {
+    match get_context() {
+        Some(ctx) if ctx.stream_threshold != STREAM_DISABLED => ctx.stream_threshold as u32,
+        _ => 0xFFFFFFFF,
+    }
+}
+
+// Threshold value meaning "never stream"
+const STREAM_DISABLED: usize = usize::MAX;
+
+// Copy a row with non-temporal stores (MOVNTI for the unaligned head and tail,
+// MOVNTDQ for the aligned body) so framebuffer data doesn't pollute the cache.
+// The caller must issue an SFENCE once all rows are written.
+#[target_feature(enable = "sse2")]
+unsafe fn stream_row_sse2(dst: *mut u32, src: *const u32, width: usize) {
+    let mut i = 0;
+    
+    // Head: align the destination to 16 bytes
+    while i < width && (dst.add(i) as usize) & 15 != 0 {
+        _mm_stream_si32(dst.add(i) as *mut i32, *src.add(i) as i32);
+        i += 1;
+    }
+    
+    // Body: 16 pixels (one cache line) per iteration
+    while i + 16 <= width {
+        let s = src.add(i) as *const __m128i;
+        let d = dst.add(i) as *mut __m128i;
+        let a = _mm_loadu_si128(s);
+        let b = _mm_loadu_si128(s.add(1));
+        let c = _mm_loadu_si128(s.add(2));
+        let e = _mm_loadu_si128(s.add(3));
+        _mm_stream_si128(d, a);
+        _mm_stream_si128(d.add(1), b);
+        _mm_stream_si128(d.add(2), c);
+        _mm_stream_si128(d.add(3), e);
+        i += 16;
+    }
+    while i + 4 <= width {
+        _mm_stream_si128(dst.add(i) as *mut __m128i, _mm_loadu_si128(src.add(i) as *const __m128i));
+        i += 4;
+    }
+    
+    // Tail
+    while i < width {
+        _mm_stream_si32(dst.add(i) as *mut i32, *src.add(i) as i32);
+        i += 1;
     }
 }
 
+// Copy a block of rows, streaming when asked to.
+// Streamed rows still need an SFENCE from the caller.
+unsafe fn copy_rows(
+    dst: *mut u32,
+    dst_pitch: usize,
+    src: *const u32,
+    src_pitch: usize,
+    width: usize,
+    height: usize,
+    stream: bool,
+) {
+    if stream {
+        for y in 0..height {
+            stream_row_sse2(dst.add(y * dst_pitch), src.add(y * src_pitch), width);
+        }
+    } else {
+        for y in 0..height {
+            core::ptr::copy_nonoverlapping(src.add(y * src_pitch), dst.add(y * dst_pitch), width);
+        }
+    }
+}
+
+// Scratch buffer for the boot-time flush calibration (256 KiB)
+const CALIBRATION_MAX_BYTES: usize = 256 * 1024;
+static mut CALIBRATION_SCRATCH: [u32; CALIBRATION_MAX_BYTES / 4] = [0; CALIBRATION_MAX_BYTES / 4];
+
+// Time regular vs. streaming copies into the framebuffer for a range of sizes.
+// Each size copies the framebuffer's current contents back onto itself, so
+// nothing visible changes. Returns the smallest size from which streaming
+// wins for every larger size measured.
+unsafe fn calibrate_stream_threshold(framebuffer: *mut u32, available_bytes: usize) -> usize {
+    const SIZES: [usize; 5] = [4 * 1024, 16 * 1024, 32 * 1024, 64 * 1024, 256 * 1024];
+    const ROUNDS: usize = 3;
+    
+    let scratch = ptr::addr_of_mut!(CALIBRATION_SCRATCH) as *mut u32;
+    let mut threshold = STREAM_DISABLED;
+    
+    for &size in SIZES.iter() {
+        if size > available_bytes || size > CALIBRATION_MAX_BYTES {
+            break;
+        }
+        
+        let pixels = size / 4;
+        core::ptr::copy_nonoverlapping(framebuffer, scratch, pixels);
+        
+        let mut best_regular = u64::MAX;
+        let mut best_stream = u64::MAX;
+        for _ in 0..ROUNDS {
+            let start = _rdtsc();
+            copy_rows(framebuffer, pixels, scratch, pixels, pixels, 1, false);
+            let mid = _rdtsc();
+            copy_rows(framebuffer, pixels, scratch, pixels, pixels, 1, true);
+            _mm_sfence();
+            let end = _rdtsc();
+            best_regular = best_regular.min(mid - start);
+            best_stream = best_stream.min(end - mid);
+        }
+        
+        if best_stream < best_regular {
+            if threshold == STREAM_DISABLED {
+                threshold = size;
+            }
+        } else {
+            // Streaming has to keep winning at every larger size
+            threshold = STREAM_DISABLED;
+        }
+    }
+    
+    threshold
+}
+
 // Check if GPU is available
 #[no_mangle]
 pub extern "C" fn gpu_is_available() -> bool {
@@ -60,14 +197,62 @@ pub extern "C" fn gpu_blit(
             return;
         }
         
-        // Optimized row-by-row copy
-        for y in 0..height {
-            let dst_row = dst.add((y * dst_pitch) as usize);
-            let src_row = src.add((y * src_pitch) as usize);
-            
-            // Use copy_nonoverlapping for fast memory copy
-            core::ptr::copy_nonoverlapping(src_row, dst_row, width as usize);
+        // Large blits bypass the cache, small ones stay on the regular copy path
+        let bytes = (width as usize) * (height as usize) * 4;
+        let stream = match get_context() {
+            Some(ctx) => bytes >= ctx.stream_threshold,
+            None => false,
+        };
+        
+        copy_rows(
+            dst,
+            dst_pitch as usize,
+            src,
+            src_pitch as usize,
+            width as usize,
+            height as usize,
+            stream,
+        );
+        if stream {
+            _mm_sfence();
+        }
+    }
+}
+
+// Blit with non-temporal stores and no fence. For callers that pick the store
+// type once for a whole flush (see gpu_get_stream_threshold) and write it in
+// many small blits; they issue gpu_stream_fence() after the last one.
+#[no_mangle]
+pub extern "C" fn gpu_blit_stream(
+    dst: *mut u32,
+    dst_pitch: u32,
+    src: *const u32,
+    src_pitch: u32,
+    width: u32,
+    height: u32,
+) {
+    unsafe {
+        if dst.is_null() || src.is_null() {
+            return;
         }
+        
+        copy_rows(
+            dst,
+            dst_pitch as usize,
+            src,
+            src_pitch as usize,
+            width as usize,
+            height as usize,
+            true,
+        );
+    }
+}
+
+// Order all gpu_blit_stream() stores before anything that follows
+#[no_mangle]
+pub extern "C" fn gpu_stream_fence() {
+    unsafe {
+        _mm_sfence();
     }
 }
 
@@ -210,6 +395,841 @@ pub extern "C" fn gpu_clear(buffer: *mut u32, width: u32, height: u32, color: u3
     }
 }
 
+// Framebuffer pixel formats understood by the scanout conversion kernels.
+// The display server always composes in XRGB8888 and converts at flush time.
+pub const PIXEL_FORMAT_XRGB8888: u32 = 0;    // 32 bpp, R:16 G:8 B:0 (canonical)
+pub const PIXEL_FORMAT_XBGR8888: u32 = 1;    // 32 bpp, R:0 G:8 B:16 (BGRX firmware)
+pub const PIXEL_FORMAT_RGB888: u32 = 2;      // 24 bpp packed, R:16 G:8 B:0
+pub const PIXEL_FORMAT_BGR888: u32 = 3;      // 24 bpp packed, R:0 G:8 B:16
+pub const PIXEL_FORMAT_RGB565: u32 = 4;      // 16 bpp, R:11 G:5 B:0
+pub const PIXEL_FORMAT_XRGB2101010: u32 = 5; // 32 bpp, 10 bits per channel
+pub const PIXEL_FORMAT_GENERIC: u32 = 6;     // Anything else - per-pixel mask packing
+
+// Pixel format descriptor (must match C struct)
+#[repr(C)]
+#[derive(Copy, Clone)]
+pub struct GpuPixelFormat {
+    pub kind: u32,
+    pub bytes_per_pixel: u32,
+    pub red_size: u8,
+    pub red_shift: u8,
+    pub green_size: u8,
+    pub green_shift: u8,
+    pub blue_size: u8,
+    pub blue_shift: u8,
+}
+
+// Build a pixel format descriptor from the bpp and channel masks reported by Limine
+#[no_mangle]
+pub extern "C" fn gpu_describe_pixel_format(
+    bpp: u16,
+    red_size: u8,
+    red_shift: u8,
+    green_size: u8,
+    green_shift: u8,
+    blue_size: u8,
+    blue_shift: u8,
+) -> GpuPixelFormat {
+    let masks = (red_size, red_shift, green_size, green_shift, blue_size, blue_shift);
+    
+    let kind = match (bpp, masks) {
+        (32, (8, 16, 8, 8, 8, 0)) => PIXEL_FORMAT_XRGB8888,
+        (32, (8, 0, 8, 8, 8, 16)) => PIXEL_FORMAT_XBGR8888,
+        (24, (8, 16, 8, 8, 8, 0)) => PIXEL_FORMAT_RGB888,
+        (24, (8, 0, 8, 8, 8, 16)) => PIXEL_FORMAT_BGR888,
+        (16, (5, 11, 6, 5, 5, 0)) => PIXEL_FORMAT_RGB565,
+        (32, (10, 20, 10, 10, 10, 0)) => PIXEL_FORMAT_XRGB2101010,
+        _ => PIXEL_FORMAT_GENERIC,
+    };
+    
+    // Anything below 8 bits per pixel is not a direct-colour mode we can drive
+    let bytes_per_pixel = match bpp {
+        0..=8 => 4,
+        _ => ((bpp as u32) + 7) / 8,
+    };
+    
+    GpuPixelFormat {
+        kind,
+        bytes_per_pixel,
+        red_size,
+        red_shift,
+        green_size,
+        green_shift,
+        blue_size,
+        blue_shift,
+    }
+}
+
+// Scale an 8-bit channel to `size` bits and place it at `shift`
+#[inline(always)]
+fn pack_channel(value: u32, size: u8, shift: u8) -> u32 {
+    if size == 0 || shift >= 32 {
+        return 0;
+    }
+    let scaled = if size <= 8 {
+        value >> (8 - size)
+    } else {
+        // Replicate the high bits into the extra low bits (0xFF -> all ones)
+        let extra = (size - 8) as u32;
+        (value << extra) | (value >> (8 - extra.min(8)))
+    };
+    let mask = if size >= 32 { u32::MAX } else { (1u32 << size) - 1 };
+    (scaled & mask) << shift
+}
+
+// Convert one canonical XRGB8888 colour into the framebuffer's native pixel value
+#[no_mangle]
+pub extern "C" fn gpu_pack_pixel(color: u32, format: *const GpuPixelFormat) -> u32 {
+    if format.is_null() {
+        return color;
+    }
+    
+    let fmt = unsafe { &*format };
+    if fmt.kind == PIXEL_FORMAT_XRGB8888 {
+        return color;
+    }
+    
+    let r = (color >> 16) & 0xFF;
+    let g = (color >> 8) & 0xFF;
+    let b = color & 0xFF;
+    
+    pack_channel(r, fmt.red_size, fmt.red_shift)
+        | pack_channel(g, fmt.green_size, fmt.green_shift)
+        | pack_channel(b, fmt.blue_size, fmt.blue_shift)
+}
+
+// XRGB8888 -> RGB565, eight pixels per iteration
+#[target_feature(enable = "sse2")]
+unsafe fn convert_row_rgb565_sse2(dst: *mut u8, src: *const u32, width: usize) {
+    let dst = dst as *mut u16;
+    let mask_r = _mm_set1_epi32(0xF800);
+    let mask_g = _mm_set1_epi32(0x07E0);
+    let mask_b = _mm_set1_epi32(0x001F);
+    
+    let mut x = 0;
+    while x + 8 <= width {
+        let lo = _mm_loadu_si128(src.add(x) as *const __m128i);
+        let hi = _mm_loadu_si128(src.add(x + 4) as *const __m128i);
+        
+        let lo = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(_mm_srli_epi32(lo, 8), mask_r), _mm_and_si128(_mm_srli_epi32(lo, 5), mask_g)),
+            _mm_and_si128(_mm_srli_epi32(lo, 3), mask_b),
+        );
+        let hi = _mm_or_si128(
+            _mm_or_si128(_mm_and_si128(_mm_srli_epi32(hi, 8), mask_r), _mm_and_si128(_mm_srli_epi32(hi, 5), mask_g)),
+            _mm_and_si128(_mm_srli_epi32(hi, 3), mask_b),
+        );
+        
+        // Sign-extend the low 16 bits so the saturating pack keeps them intact
+        let lo = _mm_srai_epi32(_mm_slli_epi32(lo, 16), 16);
+        let hi = _mm_srai_epi32(_mm_slli_epi32(hi, 16), 16);
+        _mm_storeu_si128(dst.add(x) as *mut __m128i, _mm_packs_epi32(lo, hi));
+        x += 8;
+    }
+    
+    while x < width {
+        let p = *src.add(x);
+        *dst.add(x) = (((p >> 8) & 0xF800) | ((p >> 5) & 0x07E0) | ((p >> 3) & 0x001F)) as u16;
+        x += 1;
+    }
+}
+
+// XRGB8888 -> XBGR8888 (swap red and blue), four pixels per iteration
+#[target_feature(enable = "sse2")]
+unsafe fn convert_row_xbgr8888_sse2(dst: *mut u8, src: *const u32, width: usize) {
+    let dst = dst as *mut u32;
+    let mask_g = _mm_set1_epi32(0x0000FF00);
+    let mask_lo = _mm_set1_epi32(0x000000FF);
+    
+    let mut x = 0;
+    while x + 4 <= width {
+        let p = _mm_loadu_si128(src.add(x) as *const __m128i);
+        let g = _mm_and_si128(p, mask_g);
+        let r = _mm_and_si128(_mm_srli_epi32(p, 16), mask_lo);
+        let b = _mm_slli_epi32(_mm_and_si128(p, mask_lo), 16);
+        _mm_storeu_si128(dst.add(x) as *mut __m128i, _mm_or_si128(_mm_or_si128(r, g), b));
+        x += 4;
+    }
+    
+    while x < width {
+        let p = *src.add(x);
+        *dst.add(x) = (p & 0x0000FF00) | ((p >> 16) & 0xFF) | ((p & 0xFF) << 16);
+        x += 1;
+    }
+}
+
+// XRGB8888 -> XRGB2101010, four pixels per iteration
+#[target_feature(enable = "sse2")]
+unsafe fn convert_row_xrgb2101010_sse2(dst: *mut u8, src: *const u32, width: usize) {
+    let dst = dst as *mut u32;
+    let mask_lo = _mm_set1_epi32(0xFF);
+    
+    let mut x = 0;
+    while x + 4 <= width {
+        let p = _mm_loadu_si128(src.add(x) as *const __m128i);
+        
+        let r = _mm_and_si128(_mm_srli_epi32(p, 16), mask_lo);
+        let g = _mm_and_si128(_mm_srli_epi32(p, 8), mask_lo);
+        let b = _mm_and_si128(p, mask_lo);
+        
+        // Widen each channel from 8 to 10 bits: (c << 2) | (c >> 6)
+        let r = _mm_or_si128(_mm_slli_epi32(r, 2), _mm_srli_epi32(r, 6));
+        let g = _mm_or_si128(_mm_slli_epi32(g, 2), _mm_srli_epi32(g, 6));
+        let b = _mm_or_si128(_mm_slli_epi32(b, 2), _mm_srli_epi32(b, 6));
+        
+        let v = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(r, 20), _mm_slli_epi32(g, 10)), b);
+        _mm_storeu_si128(dst.add(x) as *mut __m128i, v);
+        x += 4;
+    }
+    
+    while x < width {
+        let p = *src.add(x);
+        let widen = |c: u32| (c << 2) | (c >> 6);
+        *dst.add(x) = (widen((p >> 16) & 0xFF) << 20) | (widen((p >> 8) & 0xFF) << 10) | widen(p & 0xFF);
+        x += 1;
+    }
+}
+
+// XRGB8888 -> packed 24 bpp. Four pixels are packed into three 32-bit stores,
+// which avoids the unaligned byte-at-a-time writes that dominate 24 bpp scanout.
+unsafe fn convert_row_24bpp(dst: *mut u8, src: *const u32, width: usize, swap_rb: bool) {
+    let fix = |p: u32| -> u32 {
+        if swap_rb {
+            (p & 0x0000FF00) | ((p >> 16) & 0xFF) | ((p & 0xFF) << 16)
+        } else {
+            p & 0x00FFFFFF
+        }
+    };
+    
+    let mut x = 0;
+    while x + 4 <= width {
+        let p0 = fix(*src.add(x));
+        let p1 = fix(*src.add(x + 1));
+        let p2 = fix(*src.add(x + 2));
+        let p3 = fix(*src.add(x + 3));
+        
+        let out = dst.add(x * 3) as *mut u32;
+        ptr::write_unaligned(out, p0 | (p1 << 24));
+        ptr::write_unaligned(out.add(1), (p1 >> 8) | (p2 << 16));
+        ptr::write_unaligned(out.add(2), (p2 >> 16) | (p3 << 8));
+        x += 4;
+    }
+    
+    while x < width {
+        let p = fix(*src.add(x));
+        let out = dst.add(x * 3);
+        *out = p as u8;
+        *out.add(1) = (p >> 8) as u8;
+        *out.add(2) = (p >> 16) as u8;
+        x += 1;
+    }
+}
+
+// Fallback for unusual channel layouts: pack each pixel through the masks
+unsafe fn convert_row_generic(dst: *mut u8, src: *const u32, width: usize, fmt: &GpuPixelFormat) {
+    let bpp = fmt.bytes_per_pixel as usize;
+    for x in 0..width {
+        let value = gpu_pack_pixel(*src.add(x), fmt);
+        let out = dst.add(x * bpp);
+        match bpp {
+            2 => ptr::write_unaligned(out as *mut u16, value as u16),
+            4 => ptr::write_unaligned(out as *mut u32, value),
+            _ => {
+                for i in 0..bpp.min(4) {
+                    *out.add(i) = (value >> (i * 8)) as u8;
+                }
+            }
+        }
+    }
+}
+
+// Convert one row of canonical pixels into the framebuffer format
+unsafe fn convert_row(dst: *mut u8, src: *const u32, width: usize, fmt: &GpuPixelFormat) {
+    match fmt.kind {
+        PIXEL_FORMAT_XRGB8888 => ptr::copy_nonoverlapping(src, dst as *mut u32, width),
+        PIXEL_FORMAT_XBGR8888 => convert_row_xbgr8888_sse2(dst, src, width),
+        PIXEL_FORMAT_RGB888 => convert_row_24bpp(dst, src, width, false),
+        PIXEL_FORMAT_BGR888 => convert_row_24bpp(dst, src, width, true),
+        PIXEL_FORMAT_RGB565 => convert_row_rgb565_sse2(dst, src, width),
+        PIXEL_FORMAT_XRGB2101010 => convert_row_xrgb2101010_sse2(dst, src, width),
+        _ => convert_row_generic(dst, src, width, fmt),
+    }
+}
+
+// Blit canonical XRGB8888 pixels into a framebuffer of any supported format.
+// dst_pitch is in bytes (as reported by Limine), src_pitch is in pixels.
+#[no_mangle]
+pub extern "C" fn gpu_convert_blit(
+    dst: *mut u8,
+    dst_pitch: u32,
+    src: *const u32,
+    src_pitch: u32,
+    width: u32,
+    height: u32,
+    format: *const GpuPixelFormat,
+) {
+    unsafe {
+        if dst.is_null() || src.is_null() || format.is_null() {
+            return;
+        }
+        
+        let fmt = &*format;
+        for y in 0..height as usize {
+            let dst_row = dst.add(y * dst_pitch as usize);
+            let src_row = src.add(y * src_pitch as usize);
+            convert_row(dst_row, src_row, width as usize, fmt);
+        }
+    }
+}
+
+// Pixel doubling: each source pixel becomes two adjacent destination pixels
+#[target_feature(enable = "sse2")]
+unsafe fn scale_row_2x_sse2(dst: *mut u32, src: *const u32, width: usize) {
+    let mut i = 0;
+    while i + 4 <= width {
+        let v = _mm_loadu_si128(src.add(i) as *const __m128i);
+        _mm_storeu_si128(dst.add(i * 2) as *mut __m128i, _mm_unpacklo_epi32(v, v));
+        _mm_storeu_si128(dst.add(i * 2 + 4) as *mut __m128i, _mm_unpackhi_epi32(v, v));
+        i += 4;
+    }
+    while i < width {
+        let p = *src.add(i);
+        *dst.add(i * 2) = p;
+        *dst.add(i * 2 + 1) = p;
+        i += 1;
+    }
+}
+
+// Pixel quadrupling: broadcast each source pixel to a full vector
+#[target_feature(enable = "sse2")]
+unsafe fn scale_row_4x_sse2(dst: *mut u32, src: *const u32, width: usize) {
+    let mut i = 0;
+    while i + 4 <= width {
+        let v = _mm_loadu_si128(src.add(i) as *const __m128i);
+        let d = dst.add(i * 4) as *mut __m128i;
+        _mm_storeu_si128(d, _mm_shuffle_epi32(v, 0x00));
+        _mm_storeu_si128(d.add(1), _mm_shuffle_epi32(v, 0x55));
+        _mm_storeu_si128(d.add(2), _mm_shuffle_epi32(v, 0xAA));
+        _mm_storeu_si128(d.add(3), _mm_shuffle_epi32(v, 0xFF));
+        i += 4;
+    }
+    while i < width {
+        let p = *src.add(i);
+        for k in 0..4 {
+            *dst.add(i * 4 + k) = p;
+        }
+        i += 1;
+    }
+}
+
+// Horizontally upscale a row by an integer factor (HiDPI output).
+// dst must hold width * scale pixels. Vertical scaling is done by the caller
+// writing the expanded row scale times.
+#[no_mangle]
+pub extern "C" fn gpu_scale_row(dst: *mut u32, src: *const u32, width: u32, scale: u32) {
+    unsafe {
+        if dst.is_null() || src.is_null() || scale == 0 {
+            return;
+        }
+        
+        let width = width as usize;
+        match scale {
+            1 => core::ptr::copy_nonoverlapping(src, dst, width),
+            2 => scale_row_2x_sse2(dst, src, width),
+            4 => scale_row_4x_sse2(dst, src, width),
+            _ => {
+                let scale = scale as usize;
+                for i in 0..width {
+                    let p = *src.add(i);
+                    for k in 0..scale {
+                        *dst.add(i * scale + k) = p;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Box-filter downscaling (window thumbnails)
+//
+// Every destination pixel is the average of a factor x factor block of source
+// pixels. For each block row the source rows are first summed per column into
+// 16-bit channels, then groups of factor columns are added and divided by the
+// block area with a fixed-point multiply.
+
+const MAX_DOWNSCALE_WIDTH: usize = 4096;
+const MAX_DOWNSCALE_FACTOR: u32 = 16; // 16 * 16 * 255 still fits in 16 bits
+static mut DOWNSCALE_SUMS: [u16; MAX_DOWNSCALE_WIDTH * 4] = [0; MAX_DOWNSCALE_WIDTH * 4];
+
+// Add one source row to the per-column channel sums (four u16 per pixel)
+#[target_feature(enable = "sse2")]
+unsafe fn accumulate_row_sse2(sums: *mut u16, src: *const u32, width: usize) {
+    let zero = _mm_setzero_si128();
+    let mut i = 0;
+    while i + 4 <= width {
+        let v = _mm_loadu_si128(src.add(i) as *const __m128i);
+        let lo = sums.add(i * 4) as *mut __m128i;
+        let hi = sums.add(i * 4 + 8) as *mut __m128i;
+        _mm_storeu_si128(lo, _mm_add_epi16(_mm_loadu_si128(lo), _mm_unpacklo_epi8(v, zero)));
+        _mm_storeu_si128(hi, _mm_add_epi16(_mm_loadu_si128(hi), _mm_unpackhi_epi8(v, zero)));
+        i += 4;
+    }
+    while i < width {
+        let p = *src.add(i);
+        for c in 0..4 {
+            *sums.add(i * 4 + c) += ((p >> (c * 8)) & 0xFF) as u16;
+        }
+        i += 1;
+    }
+}
+
+// Add factor adjacent column sums per destination pixel and divide by the block area
+#[target_feature(enable = "sse2")]
+unsafe fn resolve_row_sse2(dst: *mut u32, sums: *const u16, dst_width: usize, factor: usize) {
+    let zero = _mm_setzero_si128();
+    // 1 / area in 0.16 fixed point, rounded up; the error stays below one step for areas up to 256
+    let area = (factor * factor) as u32;
+    let recip = _mm_set1_epi16(((65536 + area - 1) / area) as u16 as i16);
+    for x in 0..dst_width {
+        let block = sums.add(x * factor * 4);
+        let mut acc = zero;
+        for k in 0..factor {
+            acc = _mm_add_epi16(acc, _mm_loadl_epi64(block.add(k * 4) as *const __m128i));
+        }
+        let avg = _mm_mulhi_epu16(acc, recip);
+        *dst.add(x) = _mm_cvtsi128_si32(_mm_packus_epi16(avg, zero)) as u32;
+    }
+}
+
+// Downscale by an integer factor (1-16). dst receives (src_width / factor) x
+// (src_height / factor) pixels; leftover source columns and rows are ignored.
+// Pitches are in pixels.
+#[no_mangle]
+pub extern "C" fn gpu_downscale_box(
+    dst: *mut u32,
+    dst_pitch: u32,
+    src: *const u32,
+    src_width: u32,
+    src_height: u32,
+    src_pitch: u32,
+    factor: u32,
+) -> bool {
+    unsafe {
+        if dst.is_null() || src.is_null() || factor == 0 || factor > MAX_DOWNSCALE_FACTOR ||
+           src_width as usize > MAX_DOWNSCALE_WIDTH {
+            return false;
+        }
+        
+        let factor = factor as usize;
+        let dst_width = src_width as usize / factor;
+        let dst_height = src_height as usize / factor;
+        let used_width = dst_width * factor;
+        let sums = ptr::addr_of_mut!(DOWNSCALE_SUMS) as *mut u16;
+        
+        for y in 0..dst_height {
+            let dst_row = dst.add(y * dst_pitch as usize);
+            let src_block = src.add(y * factor * src_pitch as usize);
+            if factor == 1 {
+                core::ptr::copy_nonoverlapping(src_block, dst_row, dst_width);
+                continue;
+            }
+            
+            core::ptr::write_bytes(sums, 0, used_width * 4);
+            for k in 0..factor {
+                accumulate_row_sse2(sums, src_block.add(k * src_pitch as usize), used_width);
+            }
+            resolve_row_sse2(dst_row, sums, dst_width, factor);
+        }
+        true
+    }
+}
+
+// Text rendering
+//
+// Bitmap fonts are registered once and expanded lazily into a glyph atlas:
+// one byte mask (0x00/0xFF) per output pixel, per font and scale. Colour is
+// applied when the mask is blitted, so a single atlas serves every colour.
+// Glyph rows are then written with SSE2 masked stores instead of per-bit
+// tests. Short strings are additionally laid out into a cached mask strip so
+// a label that is redrawn every frame costs one blit.
+
+const MAX_FONTS: usize = 8;
+const MAX_TEXT_SCALE: usize = 4;
+const GLYPH_ATLAS_BYTES: usize = 2 * 1024 * 1024;
+const ATLAS_NONE: usize = usize::MAX;
+
+// Draw text over an opaque background instead of blending into the target
+pub const GPU_TEXT_OPAQUE: u32 = 1;
+
+#[derive(Clone, Copy)]
+struct Font {
+    glyphs: *const u8,
+    first_char: u32,
+    glyph_count: u32,
+    width: u32,
+    height: u32,
+    bytes_per_row: u32,
+    atlas: [usize; MAX_TEXT_SCALE],  // Atlas offset per scale - 1
+}
+
+static mut FONTS: [Option<Font>; MAX_FONTS] = [const { None }; MAX_FONTS];
+static mut GLYPH_ATLAS: [u8; GLYPH_ATLAS_BYTES] = [0; GLYPH_ATLAS_BYTES];
+static mut GLYPH_ATLAS_USED: usize = 0;
+
+// Destination for text drawing (must match C definition)
+#[repr(C)]
+pub struct GpuTextTarget {
+    pub buffer: *mut u32,
+    pub pitch: u32,        // In pixels
+    pub clip_x: i32,
+    pub clip_y: i32,
+    pub clip_width: u32,
+    pub clip_height: u32,
+}
+
+// Register a bitmap font. Each glyph is height rows of bytes_per_row bytes,
+// most significant bit leftmost. Returns the font id, or -1 if the font
+// table is full or the description is invalid.
+#[no_mangle]
+pub extern "C" fn gpu_font_register(
+    glyphs: *const u8,
+    first_char: u32,
+    glyph_count: u32,
+    width: u32,
+    height: u32,
+    bytes_per_row: u32,
+) -> i32 {
+    unsafe {
+        if glyphs.is_null() || glyph_count == 0 || width == 0 || height == 0
+            || bytes_per_row * 8 < width {
+            return -1;
+        }
+        
+        let fonts = &mut *ptr::addr_of_mut!(FONTS);
+        for (id, slot) in fonts.iter_mut().enumerate() {
+            if slot.is_none() {
+                *slot = Some(Font {
+                    glyphs,
+                    first_char,
+                    glyph_count,
+                    width,
+                    height,
+                    bytes_per_row,
+                    atlas: [ATLAS_NONE; MAX_TEXT_SCALE],
+                });
+                return id as i32;
+            }
+        }
+        -1
+    }
+}
+
+// Width and height of one character cell of a font at scale 1
+#[no_mangle]
+pub extern "C" fn gpu_font_get_size(font: i32, width: *mut u32, height: *mut u32) -> bool {
+    match get_font(font) {
+        Some(f) => {
+            unsafe {
+                if !width.is_null() {
+                    *width = f.width;
+                }
+                if !height.is_null() {
+                    *height = f.height;
+                }
+            }
+            true
+        }
+        None => false,
+    }
+}
+
+// Expand a font's glyph masks for a scale ahead of first use.
+// Returns false if the font is unknown or the atlas is full.
+#[no_mangle]
+pub extern "C" fn gpu_font_prepare(font: i32, scale: u32) -> bool {
+    if scale == 0 || scale as usize > MAX_TEXT_SCALE {
+        return false;
+    }
+    match get_font(font) {
+        Some(f) => unsafe { font_atlas(f, scale as usize).is_some() },
+        None => false,
+    }
+}
+
+fn get_font(font: i32) -> Option<&'static mut Font> {
+    if font < 0 || font as usize >= MAX_FONTS {
+        return None;
+    }
+    unsafe {
+        (*ptr::addr_of_mut!(FONTS))[font as usize].as_mut()
+    }
+}
+
+// Return the atlas offset of a font at the given scale, expanding it on
+// first use. None if the atlas is out of space.
+unsafe fn font_atlas(font: &mut Font, scale: usize) -> Option<usize> {
+    if font.atlas[scale - 1] != ATLAS_NONE {
+        return Some(font.atlas[scale - 1]);
+    }
+    
+    let glyph_w = (font.width as usize) * scale;
+    let glyph_h = (font.height as usize) * scale;
+    let glyph_bytes = glyph_w * glyph_h;
+    let total = glyph_bytes * font.glyph_count as usize;
+    let offset = GLYPH_ATLAS_USED;
+    if offset + total > GLYPH_ATLAS_BYTES {
+        return None;
+    }
+    
+    let atlas = (ptr::addr_of_mut!(GLYPH_ATLAS) as *mut u8).add(offset);
+    let bpr = font.bytes_per_row as usize;
+    for g in 0..font.glyph_count as usize {
+        let bits = font.glyphs.add(g * bpr * font.height as usize);
+        let mask = atlas.add(g * glyph_bytes);
+        for row in 0..font.height as usize {
+            let out = mask.add(row * scale * glyph_w);
+            for col in 0..font.width as usize {
+                let byte = *bits.add(row * bpr + col / 8);
+                let value = if byte & (0x80 >> (col % 8)) != 0 { 0xFF } else { 0x00 };
+                for k in 0..scale {
+                    *out.add(col * scale + k) = value;
+                }
+            }
+            // Vertical expansion: repeat the finished row
+            for k in 1..scale {
+                ptr::copy_nonoverlapping(out, out.add(k * glyph_w), glyph_w);
+            }
+        }
+    }
+    
+    GLYPH_ATLAS_USED = offset + total;
+    font.atlas[scale - 1] = offset;
+    Some(offset)
+}
+
+// Write color where the mask is set. Opaque spans write background elsewhere
+// and never read the destination (important for uncached framebuffer memory);
+// transparent spans blend with it and skip fully clear groups of four.
+#[target_feature(enable = "sse2")]
+unsafe fn masked_span_sse2(dst: *mut u32, mask: *const u8, width: usize, color: u32, background: u32, opaque: bool) {
+    let fg = _mm_set1_epi32(color as i32);
+    let bg = _mm_set1_epi32(background as i32);
+    let mut i = 0;
+    while i + 4 <= width {
+        let bits = ptr::read_unaligned(mask.add(i) as *const u32);
+        if opaque || bits != 0 {
+            let m8 = _mm_cvtsi32_si128(bits as i32);
+            let m16 = _mm_unpacklo_epi8(m8, m8);
+            let m = _mm_unpacklo_epi16(m16, m16);
+            let d = dst.add(i) as *mut __m128i;
+            let under = if opaque { bg } else { _mm_loadu_si128(d) };
+            _mm_storeu_si128(d, _mm_or_si128(_mm_and_si128(m, fg), _mm_andnot_si128(m, under)));
+        }
+        i += 4;
+    }
+    while i < width {
+        if *mask.add(i) != 0 {
+            *dst.add(i) = color;
+        } else if opaque {
+            *dst.add(i) = background;
+        }
+        i += 1;
+    }
+}
+
+// Blit a width x height mask image to (x, y) on the target, clipped
+unsafe fn blit_mask(
+    target: &GpuTextTarget,
+    x: i32,
+    y: i32,
+    mask: *const u8,
+    mask_pitch: usize,
+    width: u32,
+    height: u32,
+    color: u32,
+    background: u32,
+    opaque: bool,
+) {
+    let x0 = x.max(target.clip_x);
+    let y0 = y.max(target.clip_y);
+    let x1 = (x + width as i32).min(target.clip_x + target.clip_width as i32);
+    let y1 = (y + height as i32).min(target.clip_y + target.clip_height as i32);
+    if x0 >= x1 || y0 >= y1 {
+        return;
+    }
+    
+    let span = (x1 - x0) as usize;
+    for py in y0..y1 {
+        let src = mask.add((py - y) as usize * mask_pitch + (x0 - x) as usize);
+        let dst = target.buffer.add(py as usize * target.pitch as usize + x0 as usize);
+        masked_span_sse2(dst, src, span, color, background, opaque);
+    }
+}
+
+// String layout cache: rendered mask strips of recently drawn short strings,
+// keyed on the text, font and scale and evicted least recently used
+const LAYOUT_CACHE_SLOTS: usize = 32;
+const LAYOUT_MAX_TEXT: usize = 64;
+const LAYOUT_STRIP_BYTES: usize = 16 * 1024;
+
+#[derive(Clone, Copy)]
+struct LayoutEntry {
+    text: [u8; LAYOUT_MAX_TEXT],
+    len: usize,
+    font: i32,
+    scale: usize,
+    width: u32,
+    last_use: u32,
+}
+
+static mut LAYOUT_CACHE: [Option<LayoutEntry>; LAYOUT_CACHE_SLOTS] = [const { None }; LAYOUT_CACHE_SLOTS];
+static mut LAYOUT_STRIPS: [u8; LAYOUT_CACHE_SLOTS * LAYOUT_STRIP_BYTES] = [0; LAYOUT_CACHE_SLOTS * LAYOUT_STRIP_BYTES];
+static mut LAYOUT_CLOCK: u32 = 0;
+
+// Find or build the cached strip for a string; returns (slot, strip width).
+// None when the string is too large to cache.
+unsafe fn layout_lookup(font_id: i32, font: &Font, atlas: *const u8, scale: usize,
+                        text: *const u8, glyphs: usize, len: usize) -> Option<(usize, u32)> {
+    let glyph_w = font.width as usize * scale;
+    let glyph_h = font.height as usize * scale;
+    let strip_w = glyph_w * glyphs;
+    if len > LAYOUT_MAX_TEXT || strip_w * glyph_h > LAYOUT_STRIP_BYTES {
+        return None;
+    }
+    
+    let text = core::slice::from_raw_parts(text, len);
+    let cache = &mut *ptr::addr_of_mut!(LAYOUT_CACHE);
+    LAYOUT_CLOCK = LAYOUT_CLOCK.wrapping_add(1);
+    
+    let mut victim = 0;
+    let mut victim_age = 0u32;
+    for (slot, entry) in cache.iter_mut().enumerate() {
+        match entry {
+            Some(e) => {
+                if e.font == font_id && e.scale == scale && e.len == len && &e.text[..len] == text {
+                    e.last_use = LAYOUT_CLOCK;
+                    return Some((slot, e.width));
+                }
+                let age = LAYOUT_CLOCK.wrapping_sub(e.last_use);
+                if age > victim_age {
+                    victim = slot;
+                    victim_age = age;
+                }
+            }
+            None => {
+                // Prefer free slots over evicting anything
+                victim = slot;
+                victim_age = u32::MAX;
+            }
+        }
+    }
+    
+    // Miss: lay the glyph masks out side by side in the victim's strip
+    let strip = (ptr::addr_of_mut!(LAYOUT_STRIPS) as *mut u8).add(victim * LAYOUT_STRIP_BYTES);
+    let glyph_bytes = glyph_w * glyph_h;
+    let mut pos = 0;
+    for &ch in text.iter() {
+        let index = (ch as u32).wrapping_sub(font.first_char);
+        if index >= font.glyph_count {
+            continue;
+        }
+        let src = atlas.add(index as usize * glyph_bytes);
+        for row in 0..glyph_h {
+            ptr::copy_nonoverlapping(src.add(row * glyph_w), strip.add(row * strip_w + pos * glyph_w), glyph_w);
+        }
+        pos += 1;
+    }
+    
+    let mut entry = LayoutEntry {
+        text: [0; LAYOUT_MAX_TEXT],
+        len,
+        font: font_id,
+        scale,
+        width: strip_w as u32,
+        last_use: LAYOUT_CLOCK,
+    };
+    entry.text[..len].copy_from_slice(text);
+    cache[victim] = Some(entry);
+    Some((victim, strip_w as u32))
+}
+
+// Draw len bytes of text with its top-left corner at (x, y), clipped to the
+// target's clip rectangle. Characters the font does not cover are skipped.
+// Returns the horizontal advance in pixels.
+#[no_mangle]
+pub extern "C" fn gpu_draw_text(
+    target: *const GpuTextTarget,
+    x: i32,
+    y: i32,
+    text: *const u8,
+    len: u32,
+    font: i32,
+    scale: u32,
+    color: u32,
+    background: u32,
+    flags: u32,
+) -> u32 {
+    unsafe {
+        if target.is_null() || (*target).buffer.is_null() || text.is_null()
+            || scale == 0 || scale as usize > MAX_TEXT_SCALE {
+            return 0;
+        }
+        
+        let target = &*target;
+        let font_ref = match get_font(font) {
+            Some(f) => f,
+            None => return 0,
+        };
+        let scale = scale as usize;
+        let atlas = match font_atlas(font_ref, scale) {
+            Some(offset) => (ptr::addr_of!(GLYPH_ATLAS) as *const u8).add(offset),
+            None => return 0,
+        };
+        let font_ref = &*font_ref;
+        
+        let len = len as usize;
+        let mut glyphs = 0;
+        for i in 0..len {
+            if (*text.add(i) as u32).wrapping_sub(font_ref.first_char) < font_ref.glyph_count {
+                glyphs += 1;
+            }
+        }
+        
+        let glyph_w = font_ref.width * scale as u32;
+        let glyph_h = font_ref.height * scale as u32;
+        let advance = glyphs as u32 * glyph_w;
+        if glyphs == 0
+            || y >= target.clip_y + target.clip_height as i32 || y + glyph_h as i32 <= target.clip_y
+            || x >= target.clip_x + target.clip_width as i32 || x + advance as i32 <= target.clip_x {
+            return advance;
+        }
+        
+        let opaque = (flags & GPU_TEXT_OPAQUE) != 0;
+        
+        // Whole strings go through the layout cache as a single blit
+        if glyphs > 1 {
+            if let Some((slot, strip_w)) = layout_lookup(font, font_ref, atlas, scale, text, glyphs, len) {
+                let strip = (ptr::addr_of!(LAYOUT_STRIPS) as *const u8).add(slot * LAYOUT_STRIP_BYTES);
+                blit_mask(target, x, y, strip, strip_w as usize, strip_w, glyph_h, color, background, opaque);
+                return advance;
+            }
+        }
+        
+        let glyph_bytes = (glyph_w * glyph_h) as usize;
+        let mut pen = x;
+        for i in 0..len {
+            let index = (*text.add(i) as u32).wrapping_sub(font_ref.first_char);
+            if index >= font_ref.glyph_count {
+                continue;
+            }
+            blit_mask(target, pen, y, atlas.add(index as usize * glyph_bytes), glyph_w as usize,
+                      glyph_w, glyph_h, color, background, opaque);
+            pen += glyph_w as i32;
+        }
+        advance
+    }
+}
+
 // Get GPU context (for internal use)
 fn get_context() -> Option<&'static mut GpuContext> {
     unsafe {
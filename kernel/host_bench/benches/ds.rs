@@ -0,0 +1,64 @@
+// Display server composition: small damage, a dragged window, full frames,
+// and a fullscreen surface scanned out directly
+
+use host_bench::ds_rust::{ds_create_surface, ds_get_surface_buffer, ds_mark_dirty, ds_render,
+                          ds_set_surface_position, ds_set_surface_size, ds_update_cursor_position};
+use host_bench::{init_display, Bencher};
+
+const WIDTH: u32 = 1280;
+const HEIGHT: u32 = 800;
+
+fn main() {
+    let bencher = Bencher::from_args();
+    let _display = init_display(WIDTH, HEIGHT);
+
+    // A desktop of overlapping windows
+    let mut surfaces = Vec::new();
+    for i in 0..8 {
+        let surface = ds_create_surface(40 + i * 90, 30 + i * 50, 480, 320, i);
+        let buffer = ds_get_surface_buffer(surface);
+        if !buffer.is_null() {
+            unsafe {
+                std::slice::from_raw_parts_mut(buffer, 480 * 320).fill(0x00404040 + i as u32 * 0x101010);
+            }
+        }
+        surfaces.push(surface);
+    }
+    ds_mark_dirty(0, 0, WIDTH, HEIGHT);
+    ds_render();
+
+    // ds_render adds the cursor to the damage box: keep it inside the damaged area,
+    // so only 64x64 is presented. Surfaces overlapping the damage are still
+    // composited whole, so no throughput figure.
+    ds_update_cursor_position(610, 410);
+    ds_render();
+    bencher.bench("ds_render/dirty_64x64", 0, || {
+        ds_mark_dirty(600, 400, 64, 64);
+        ds_render();
+    });
+
+    // Window drag: old and new positions are damaged every frame
+    let dragged = surfaces[3];
+    let mut x = 100;
+    bencher.bench("ds_render/drag_480x320", 0, || {
+        x = if x >= 700 { 100 } else { x + 4 };
+        ds_set_surface_position(dragged, x, 200);
+        ds_render();
+    });
+
+    bencher.bench("ds_render/full_frame", WIDTH as u64 * HEIGHT as u64 * 4, || {
+        ds_mark_dirty(0, 0, WIDTH, HEIGHT);
+        ds_render();
+    });
+    // Screen-sized surfaces live in the scanout buffer (pool slots stop at 800x600)
+    let fullscreen = ds_create_surface(0, 0, 64, 64, 100);
+    assert!(ds_set_surface_size(fullscreen, WIDTH, HEIGHT), "no scanout buffer for {}x{}", WIDTH, HEIGHT);
+    let buffer = ds_get_surface_buffer(fullscreen);
+    unsafe {
+        std::slice::from_raw_parts_mut(buffer, (WIDTH * HEIGHT) as usize).fill(0x00203040);
+    }
+    bencher.bench("ds_render/scanout_full_frame", WIDTH as u64 * HEIGHT as u64 * 4, || {
+        ds_mark_dirty(0, 0, WIDTH, HEIGHT);
+        ds_render();
+    });
+}
@@ -0,0 +1,34 @@
+// Filesystem lookups and file I/O on a full table
+
+use host_bench::fs_rust::{fs_create_file, fs_file_exists, fs_init, fs_read_file, fs_write_file,
+                          MAX_FILES, MAX_FILE_SIZE};
+use host_bench::{consume, Bencher};
+
+fn main() {
+    let bencher = Bencher::from_args();
+    fs_init();
+
+    let names: Vec<String> = (0..MAX_FILES - 1).map(|i| format!("bench_{:02}.txt\0", i)).collect();
+    let data = vec![b'x'; MAX_FILE_SIZE];
+    for name in &names {
+        fs_create_file(name.as_ptr() as *const _, 0);
+        fs_write_file(name.as_ptr() as *const _, data.as_ptr(), data.len());
+    }
+
+    let last = names.last().unwrap().as_ptr() as *const _;
+    bencher.bench("fs_lookup/hit_last", 0, || {
+        consume(fs_file_exists(last));
+    });
+    bencher.bench("fs_lookup/miss", 0, || {
+        consume(fs_file_exists(b"missing.txt\0".as_ptr() as *const _));
+    });
+
+    let mut buffer = vec![0u8; MAX_FILE_SIZE];
+    bencher.bench("fs_read_file/1k", MAX_FILE_SIZE as u64, || {
+        let mut size = buffer.len();
+        consume(fs_read_file(last, buffer.as_mut_ptr(), &mut size));
+    });
+    bencher.bench("fs_write_file/1k", MAX_FILE_SIZE as u64, || {
+        consume(fs_write_file(last, data.as_ptr(), data.len()));
+    });
+}
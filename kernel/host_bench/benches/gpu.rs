@@ -0,0 +1,27 @@
+// gpu_rust pixel paths: blit, fill and alpha blend
+
+use host_bench::gpu_rust::{gpu_alpha_blend, gpu_blit, gpu_fill_rect};
+use host_bench::{init_display, Bencher};
+
+fn main() {
+    let bencher = Bencher::from_args();
+    let _display = init_display(1920, 1080);
+
+    // Window-sized, then full-HD (large blits take the streaming-store path)
+    for &(width, height) in &[(256u32, 256u32), (1920, 1080)] {
+        let pixels = (width * height) as usize;
+        let src: Vec<u32> = (0..pixels as u32).map(|i| 0x00204080u32.wrapping_add(i)).collect();
+        let mut dst = vec![0u32; pixels];
+        let bytes = pixels as u64 * 4;
+
+        bencher.bench(&format!("gpu_blit/{}x{}", width, height), bytes * 2, || {
+            gpu_blit(dst.as_mut_ptr(), width, src.as_ptr(), width, width, height);
+        });
+        bencher.bench(&format!("gpu_fill_rect/{}x{}", width, height), bytes, || {
+            gpu_fill_rect(dst.as_mut_ptr(), width, 0, 0, width, height, 0x00336699);
+        });
+        bencher.bench(&format!("gpu_alpha_blend/{}x{}", width, height), bytes * 2, || {
+            gpu_alpha_blend(dst.as_mut_ptr(), src.as_ptr(), width, height, 128);
+        });
+    }
+}
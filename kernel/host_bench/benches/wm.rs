@@ -0,0 +1,33 @@
+// Window manager hit-testing over a stack of windows
+
+use host_bench::wm_rust::{wm_create_window, wm_init, wm_window_at, LimineFramebuffer};
+use host_bench::{consume, init_display, Bencher};
+
+const WIDTH: u32 = 1280;
+const HEIGHT: u32 = 800;
+
+fn main() {
+    let bencher = Bencher::from_args();
+    let mut display = init_display(WIDTH, HEIGHT);
+    // Same C struct on both sides of the FFI
+    wm_init(&mut display.descriptor as *mut _ as *mut LimineFramebuffer);
+
+    for i in 0..16 {
+        let title = format!("Window {}\0", i);
+        wm_create_window(title.as_ptr() as *const _, (i % 4) * 300 + 10, (i / 4) * 190 + 10,
+                         320, 200, 0);
+    }
+
+    // Walk the pointer across the screen on a coarse grid
+    let mut point = 0u32;
+    bencher.bench("wm_window_at/16_windows", 0, || {
+        point = point.wrapping_add(7919);
+        let x = (point % WIDTH) as i32;
+        let y = ((point / WIDTH) % HEIGHT) as i32;
+        consume(wm_window_at(x, y));
+    });
+
+    bencher.bench("wm_window_at/empty_area", 0, || {
+        consume(wm_window_at(WIDTH as i32 - 1, HEIGHT as i32 - 1));
+    });
+}
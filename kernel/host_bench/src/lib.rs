@@ -0,0 +1,170 @@
+// Host-side benchmark harness for the kernel crates
+//
+// The crates are linked as std rlibs ("host" feature); the C kernel functions
+// they call are stubbed below. Static pools stay as they are: every benchmark
+// binary is single threaded and initializes the crate state once.
+//
+// Each benchmark is warmed up, then timed in SAMPLES batches sized to take at
+// least SAMPLE_TARGET each; the report gives min/median/p99 time per iteration
+// and throughput when a byte count is given. Arguments other than cargo's
+// "--bench" filter benchmarks by substring: cargo bench --bench gpu -- blit
+
+use std::ffi::c_char;
+use std::hint::black_box;
+use std::time::{Duration, Instant};
+
+// Re-exported so the benchmarks (and the linker) see every crate
+pub use ds_rust;
+pub use fs_rust;
+pub use gpu_rust;
+pub use wm_rust;
+
+const WARMUP: Duration = Duration::from_millis(200);
+const SAMPLE_TARGET: Duration = Duration::from_millis(5);
+const SAMPLES: usize = 60;
+
+pub struct Bencher {
+    filters: Vec<String>,
+}
+
+impl Bencher {
+    pub fn from_args() -> Bencher {
+        let filters = std::env::args()
+            .skip(1)
+            .filter(|arg| !arg.starts_with("--"))
+            .collect();
+        Bencher { filters }
+    }
+
+    fn selected(&self, name: &str) -> bool {
+        self.filters.is_empty() || self.filters.iter().any(|f| name.contains(f.as_str()))
+    }
+
+    // Time `routine`; `bytes` is the amount of data one iteration touches
+    // (0 = no throughput column)
+    pub fn bench<F: FnMut()>(&self, name: &str, bytes: u64, mut routine: F) {
+        if !self.selected(name) {
+            return;
+        }
+
+        // Warm up and estimate the per-iteration cost
+        let start = Instant::now();
+        let mut iterations: u64 = 0;
+        while start.elapsed() < WARMUP {
+            routine();
+            iterations += 1;
+        }
+        let per_iteration = start.elapsed().as_nanos() as f64 / iterations as f64;
+        let batch = ((SAMPLE_TARGET.as_nanos() as f64 / per_iteration) as u64).max(1);
+
+        let mut samples: Vec<f64> = (0..SAMPLES)
+            .map(|_| {
+                let start = Instant::now();
+                for _ in 0..batch {
+                    routine();
+                }
+                start.elapsed().as_nanos() as f64 / batch as f64
+            })
+            .collect();
+        samples.sort_by(|a, b| a.partial_cmp(b).unwrap());
+
+        let min = samples[0];
+        let median = samples[SAMPLES / 2];
+        let p99 = samples[(SAMPLES * 99) / 100];
+        print!("{:<32} min {:>10}  median {:>10}  p99 {:>10}",
+               name, format_time(min), format_time(median), format_time(p99));
+        if bytes > 0 {
+            print!("  {:>8.2} GiB/s", bytes as f64 / median / 1.073741824);
+        }
+        println!();
+    }
+}
+
+fn format_time(ns: f64) -> String {
+    if ns < 1_000.0 {
+        format!("{:.1} ns", ns)
+    } else if ns < 1_000_000.0 {
+        format!("{:.2} us", ns / 1_000.0)
+    } else {
+        format!("{:.2} ms", ns / 1_000_000.0)
+    }
+}
+
+// Keep results alive without letting the optimizer see through them
+pub fn consume<T>(value: T) -> T {
+    black_box(value)
+}
+
+// Kernel C functions the crates call, as no-ops for the host
+#[no_mangle]
+pub extern "C" fn trace_emit(_event: u32, _phase: u32, _a0: u64, _a1: u64, _a2: u64) {}
+
+#[no_mangle]
+pub extern "C" fn perf_scope(_name: *const c_char) -> u32 {
+    u32::MAX
+}
+
+#[no_mangle]
+pub extern "C" fn perf_begin(_scope: u32) {}
+
+#[no_mangle]
+pub extern "C" fn perf_end(_scope: u32) {}
+
+#[no_mangle]
+pub extern "C" fn logger_write_port(_port: u32, _data: *const u8, _length: u32) {}
+
+#[no_mangle]
+pub extern "C" fn tsc_to_us(_cycles: u64) -> u64 {
+    0
+}
+
+#[no_mangle]
+pub extern "C" fn input_pop(_event: *mut wm_rust::InputEvent) -> bool {
+    false
+}
+
+#[no_mangle]
+pub extern "C" fn keyboard_deliver(_c: c_char) {}
+
+// A heap-backed stand-in for the Limine framebuffer (XRGB8888)
+pub struct HostFramebuffer {
+    pixels: Vec<u32>,
+    pub descriptor: ds_rust::LimineFramebuffer,
+}
+
+impl HostFramebuffer {
+    pub fn new(width: u32, height: u32) -> Box<HostFramebuffer> {
+        let mut framebuffer = Box::new(HostFramebuffer {
+            pixels: vec![0; width as usize * height as usize],
+            descriptor: ds_rust::LimineFramebuffer {
+                address: std::ptr::null_mut(),
+                width: width as u64,
+                height: height as u64,
+                pitch: width as u64 * 4,
+                bpp: 32,
+                memory_model: 1,
+                red_mask_size: 8,
+                red_mask_shift: 16,
+                green_mask_size: 8,
+                green_mask_shift: 8,
+                blue_mask_size: 8,
+                blue_mask_shift: 0,
+                unused: [0; 7],
+                edid_size: 0,
+                edid: std::ptr::null_mut(),
+                mode_count: 0,
+                modes: std::ptr::null_mut(),
+            },
+        });
+        framebuffer.descriptor.address = framebuffer.pixels.as_mut_ptr();
+        framebuffer
+    }
+}
+
+// Bring up gpu_rust and the display server on a host framebuffer, as kmain does
+pub fn init_display(width: u32, height: u32) -> Box<HostFramebuffer> {
+    let mut framebuffer = HostFramebuffer::new(width, height);
+    gpu_rust::gpu_init(framebuffer.pixels.as_mut_ptr() as *mut _, width, height, width);
+    ds_rust::ds_init(&mut framebuffer.descriptor);
+    framebuffer
+}
@@ -1,4 +1,5 @@
 #include "audio.h"
+#include "tsc.h"
 #include <stdint.h>
 #include <stddef.h>
 
@@ -14,6 +15,14 @@
 // PIT frequency (1.193182 MHz)
 #define PIT_FREQUENCY   1193182
 
+// Notes queued for asynchronous playback
+#define AUDIO_ASYNC_NOTES 16
+
+static audio_note_t async_notes[AUDIO_ASYNC_NOTES];
+static size_t async_count = 0;
+static size_t async_index = 0;
+static uint64_t async_note_end = 0;  // TSC deadline of the playing note
+
 // Port I/O functions
 static inline void outb(uint16_t port, uint8_t value) {
     __asm__ volatile ("outb %0, %1" : : "a"(value), "Nd"(port));
@@ -38,17 +47,6 @@ void audio_init(void) {
     // PC Speaker is ready to use - no special initialization needed
     // Just make sure it's initially off
     audio_stop();
-    
-    // Test if PC Speaker is working with a very brief test tone
-    // This helps verify hardware is accessible
-    uint8_t port_value = inb(KB_CONTROLLER_PORT);
-    outb(KB_CONTROLLER_PORT, port_value | 0x03);  // Enable speaker
-    
-    // Very brief test (just a few milliseconds)
-    for (volatile int i = 0; i < 10000; i++);
-    
-    // Disable speaker
-    audio_stop();
 }
 
 void audio_beep(uint16_t frequency, uint32_t duration_ms) {
@@ -123,41 +121,104 @@ void audio_play_melody(const audio_note_t *notes, size_t count) {
     }
 }
 
-void audio_play_event(audio_event_type_t event_type) {
+// Notes of a predefined audio event; returns the note count
+static size_t audio_event_melody(audio_event_type_t event_type, audio_note_t *notes) {
+    static const audio_note_t system_beep[] = {
+        {1000, 200}  // Standard system beep: 1000 Hz for 200ms
+    };
+    static const audio_note_t error_beep[] = {
+        {500, 500}   // Error beep: 500 Hz for 500ms
+    };
+    static const audio_note_t startup[] = {
+        {523, 200},  // C5
+        {659, 200},  // E5
+        {784, 200},  // G5
+        {1047, 400}  // C6
+    };
+    static const audio_note_t shutdown[] = {
+        {1047, 200}, // C6
+        {784, 200},  // G5
+        {659, 200},  // E5
+        {523, 400}   // C5
+    };
+    
+    const audio_note_t *melody = NULL;
+    size_t count = 0;
     switch (event_type) {
         case AUDIO_SYSTEM_BEEP:
-            // Standard system beep: 1000 Hz for 200ms
-            audio_beep(1000, 200);
+            melody = system_beep;
+            count = sizeof(system_beep) / sizeof(system_beep[0]);
             break;
-            
         case AUDIO_ERROR_BEEP:
-            // Error beep: 500 Hz for 500ms
-            audio_beep(500, 500);
+            melody = error_beep;
+            count = sizeof(error_beep) / sizeof(error_beep[0]);
             break;
-            
-        case AUDIO_STARTUP_SOUND: {
-            // Simple startup melody
-            audio_note_t startup[] = {
-                {523, 200},  // C5
-                {659, 200},  // E5
-                {784, 200},  // G5
-                {1047, 400}  // C6
-            };
-            audio_play_melody(startup, sizeof(startup) / sizeof(startup[0]));
+        case AUDIO_STARTUP_SOUND:
+            melody = startup;
+            count = sizeof(startup) / sizeof(startup[0]);
             break;
-        }
-        
-        case AUDIO_SHUTDOWN_SOUND: {
-            // Simple shutdown melody
-            audio_note_t shutdown[] = {
-                {1047, 200}, // C6
-                {784, 200},  // G5
-                {659, 200},  // E5
-                {523, 400}   // C5
-            };
-            audio_play_melody(shutdown, sizeof(shutdown) / sizeof(shutdown[0]));
+        case AUDIO_SHUTDOWN_SOUND:
+            melody = shutdown;
+            count = sizeof(shutdown) / sizeof(shutdown[0]);
             break;
-        }
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        notes[i] = melody[i];
+    }
+    return count;
+}
+
+void audio_play_event(audio_event_type_t event_type) {
+    audio_note_t notes[AUDIO_ASYNC_NOTES];
+    size_t count = audio_event_melody(event_type, notes);
+    audio_play_melody(notes, count);
+}
+
+// Start the next queued note, or go quiet when the queue is done
+static void audio_async_next(void) {
+    if (async_index >= async_count) {
+        audio_stop();
+        async_note_end = 0;
+        return;
+    }
+    
+    const audio_note_t *note = &async_notes[async_index++];
+    if (note->frequency == 0) {
+        audio_stop();
+    } else {
+        audio_beep(note->frequency, 0);
+    }
+    async_note_end = tsc_read() + tsc_get_hz() / 1000 * note->duration_ms;
+}
+
+void audio_play_melody_async(const audio_note_t *notes, size_t count) {
+    // Without a calibrated TSC there is no clock to pace the notes against
+    if (tsc_get_hz() == 0) {
+        audio_play_melody(notes, count);
+        return;
+    }
+    
+    if (count > AUDIO_ASYNC_NOTES) {
+        count = AUDIO_ASYNC_NOTES;
+    }
+    for (size_t i = 0; i < count; i++) {
+        async_notes[i] = notes[i];
+    }
+    async_count = count;
+    async_index = 0;
+    audio_async_next();
+}
+
+void audio_play_event_async(audio_event_type_t event_type) {
+    audio_note_t notes[AUDIO_ASYNC_NOTES];
+    size_t count = audio_event_melody(event_type, notes);
+    audio_play_melody_async(notes, count);
+}
+
+void audio_poll(void) {
+    if (async_note_end != 0 && tsc_read() >= async_note_end) {
+        audio_async_next();
     }
 }
 
@@ -57,6 +57,13 @@ typedef enum {
 // Play predefined audio events
 void audio_play_event(audio_event_type_t event_type);
 
+// Asynchronous playback: returns at once, audio_poll() (called from the idle
+// loop) moves on to the next note when the current one is due to end.
+// Starting a new melody replaces the one playing.
+void audio_play_melody_async(const audio_note_t *notes, size_t count);
+void audio_play_event_async(audio_event_type_t event_type);
+void audio_poll(void);
+
 // Debug function
 void audio_debug_test(void);     // Direct hardware test
 
@@ -0,0 +1,276 @@
+#include "bench.h"
+#include "tsc.h"
+#include "logger.h"
+#include "string.h"
+#include "gpu_rust.h"
+#include "display_server_rust.h"
+#include "fs/filesystem.h"
+#include "process.h"
+#include "virtio_console.h"
+#include <stddef.h>
+
+// Memory functions (defined in main.c)
+void *memcpy(void *restrict dest, const void *restrict src, size_t n);
+void *memset(void *s, int c, size_t n);
+
+// Scratch surfaces shared by the built-in benchmarks
+#define BENCH_SURFACE_SIZE 256
+#define BENCH_FS_BYTES     MAX_FILE_SIZE
+#define BENCH_FS_FILE      "bench.tmp"
+
+static bench_t benches[BENCH_MAX];
+static uint32_t bench_total = 0;
+static bool bench_initialized = false;
+static uint64_t timer_overhead = 0;
+
+static uint32_t bench_src[BENCH_SURFACE_SIZE * BENCH_SURFACE_SIZE];
+static uint32_t bench_dst[BENCH_SURFACE_SIZE * BENCH_SURFACE_SIZE];
+static uint8_t bench_fs_buffer[BENCH_FS_BYTES];
+
+// TSC reads that don't let the timed code drift across them (no rdtscp,
+// which the default QEMU CPU model lacks)
+static inline uint64_t bench_tsc_begin(void) {
+    uint32_t low, high;
+    __asm__ volatile ("lfence\n\trdtsc" : "=a"(low), "=d"(high) : : "memory");
+    return ((uint64_t)high << 32) | low;
+}
+
+static inline uint64_t bench_tsc_end(void) {
+    uint32_t low, high;
+    __asm__ volatile ("lfence\n\trdtsc\n\tlfence" : "=a"(low), "=d"(high) : : "memory");
+    return ((uint64_t)high << 32) | low;
+}
+
+bool bench_register(const char *name, bool (*setup)(void), void (*run)(void), void (*teardown)(void)) {
+    if (bench_total >= BENCH_MAX || !name || !run) {
+        return false;
+    }
+    benches[bench_total].name = name;
+    benches[bench_total].setup = setup;
+    benches[bench_total].run = run;
+    benches[bench_total].teardown = teardown;
+    bench_total++;
+    return true;
+}
+
+uint32_t bench_count(void) {
+    return bench_total;
+}
+
+const bench_t *bench_get(uint32_t index) {
+    return index < bench_total ? &benches[index] : NULL;
+}
+
+// Memory benchmarks
+static void bench_memcpy_64(void) { memcpy(bench_dst, bench_src, 64); }
+static void bench_memcpy_4k(void) { memcpy(bench_dst, bench_src, 4096); }
+static void bench_memcpy_64k(void) { memcpy(bench_dst, bench_src, 65536); }
+static void bench_memset_64(void) { memset(bench_dst, 0x5a, 64); }
+static void bench_memset_4k(void) { memset(bench_dst, 0x5a, 4096); }
+static void bench_memset_64k(void) { memset(bench_dst, 0x5a, 65536); }
+
+// Pixel benchmarks on 256x256 XRGB8888 surfaces
+static bool bench_pixels_setup(void) {
+    for (uint32_t i = 0; i < BENCH_SURFACE_SIZE * BENCH_SURFACE_SIZE; i++) {
+        bench_src[i] = 0x00204080 + i;
+    }
+    return true;
+}
+
+static void bench_gpu_blit(void) {
+    gpu_blit(bench_dst, BENCH_SURFACE_SIZE, bench_src, BENCH_SURFACE_SIZE,
+             BENCH_SURFACE_SIZE, BENCH_SURFACE_SIZE);
+}
+
+static void bench_gpu_fill_rect(void) {
+    gpu_fill_rect(bench_dst, BENCH_SURFACE_SIZE, 0, 0, BENCH_SURFACE_SIZE, BENCH_SURFACE_SIZE, 0x00336699);
+}
+
+static void bench_gpu_alpha_blend(void) {
+    gpu_alpha_blend(bench_dst, bench_src, BENCH_SURFACE_SIZE, BENCH_SURFACE_SIZE, 128);
+}
+
+static void bench_text(void) {
+    static const char text[] = "The quick brown fox jumps over the lazy dog";
+    gpu_text_target_t target = {
+        bench_dst, BENCH_SURFACE_SIZE, 0, 0, BENCH_SURFACE_SIZE, BENCH_SURFACE_SIZE
+    };
+    for (int32_t y = 0; y < 64; y += 16) {
+        gpu_draw_text(&target, 0, y, text, sizeof(text) - 1, 0, 1,
+                      0x00FFFFFF, 0x00000000, GPU_TEXT_OPAQUE);
+    }
+}
+
+// Full compositor pass: everything damaged, composed and presented
+static void bench_ds_render(void) {
+    uint32_t width = 0, height = 0;
+    ds_get_screen_size(&width, &height);
+    ds_mark_dirty(0, 0, width, height);
+    ds_render();
+}
+
+// Filesystem benchmarks on a scratch file
+static bool bench_fs_setup(void) {
+    fs_delete_file(BENCH_FS_FILE);
+    memset(bench_fs_buffer, 'b', sizeof(bench_fs_buffer));
+    return fs_create_file(BENCH_FS_FILE, FILE_TYPE_REGULAR) &&
+           fs_write_file(BENCH_FS_FILE, bench_fs_buffer, sizeof(bench_fs_buffer));
+}
+
+static void bench_fs_teardown(void) {
+    fs_delete_file(BENCH_FS_FILE);
+}
+
+static bool bench_fs_empty_setup(void) {
+    fs_delete_file(BENCH_FS_FILE);
+    return true;
+}
+
+static void bench_fs_create_delete(void) {
+    fs_create_file(BENCH_FS_FILE, FILE_TYPE_REGULAR);
+    fs_delete_file(BENCH_FS_FILE);
+}
+
+static void bench_fs_write(void) {
+    fs_write_file(BENCH_FS_FILE, bench_fs_buffer, sizeof(bench_fs_buffer));
+}
+
+static void bench_fs_read(void) {
+    size_t size = sizeof(bench_fs_buffer);
+    fs_read_file(BENCH_FS_FILE, bench_fs_buffer, &size);
+}
+
+// System call dispatch (SYS_WRITE with no string has no side effects)
+static void bench_syscall(void) {
+    syscall_handler(SYS_WRITE, 0, 0, 0);
+}
+
+void bench_init(void) {
+    if (bench_initialized) {
+        return;
+    }
+    bench_initialized = true;
+    
+    bench_register("memcpy_64", NULL, bench_memcpy_64, NULL);
+    bench_register("memcpy_4k", NULL, bench_memcpy_4k, NULL);
+    bench_register("memcpy_64k", NULL, bench_memcpy_64k, NULL);
+    bench_register("memset_64", NULL, bench_memset_64, NULL);
+    bench_register("memset_4k", NULL, bench_memset_4k, NULL);
+    bench_register("memset_64k", NULL, bench_memset_64k, NULL);
+    bench_register("gpu_blit", bench_pixels_setup, bench_gpu_blit, NULL);
+    bench_register("gpu_fill_rect", bench_pixels_setup, bench_gpu_fill_rect, NULL);
+    bench_register("gpu_alpha_blend", bench_pixels_setup, bench_gpu_alpha_blend, NULL);
+    bench_register("text", NULL, bench_text, NULL);
+    bench_register("ds_render", NULL, bench_ds_render, NULL);
+    bench_register("fs_create_delete", bench_fs_empty_setup, bench_fs_create_delete, NULL);
+    bench_register("fs_write_1k", bench_fs_setup, bench_fs_write, bench_fs_teardown);
+    bench_register("fs_read_1k", bench_fs_setup, bench_fs_read, bench_fs_teardown);
+    bench_register("syscall", NULL, bench_syscall, NULL);
+}
+
+static void sort_samples(uint64_t *samples, uint32_t count) {
+    for (uint32_t i = 1; i < count; i++) {
+        uint64_t value = samples[i];
+        uint32_t j = i;
+        while (j > 0 && samples[j - 1] > value) {
+            samples[j] = samples[j - 1];
+            j--;
+        }
+        samples[j] = value;
+    }
+}
+
+// Smallest cost of an empty timed region
+static uint64_t measure_timer_overhead(void) {
+    uint64_t best = ~0ULL;
+    for (int i = 0; i < 64; i++) {
+        uint64_t start = bench_tsc_begin();
+        uint64_t end = bench_tsc_end();
+        if (end - start < best) {
+            best = end - start;
+        }
+    }
+    return best;
+}
+
+static uint64_t cycles_to_ns(uint64_t cycles) {
+    uint64_t hz = tsc_get_hz();
+    if (hz == 0) {
+        return 0;
+    }
+    // Split to avoid overflowing cycles * 1e9
+    return cycles / hz * 1000000000ULL + cycles % hz * 1000000000ULL / hz;
+}
+
+// " key=value" field of the BENCH line
+static void append_field(char *line, size_t *pos, size_t size, const char *key, uint64_t value) {
+    str_append(line, pos, size, " ");
+    str_append(line, pos, size, key);
+    str_append(line, pos, size, "=");
+    str_append_u64(line, pos, size, value, 10);
+}
+
+static void bench_emit(const bench_t *bench, const bench_result_t *result) {
+    char line[256];
+    size_t pos = 0;
+    str_append(line, &pos, sizeof(line), "BENCH name=");
+    str_append(line, &pos, sizeof(line), bench->name);
+    append_field(line, &pos, sizeof(line), "samples", result->samples);
+    append_field(line, &pos, sizeof(line), "rejected", result->rejected);
+    append_field(line, &pos, sizeof(line), "min_cycles", result->min);
+    append_field(line, &pos, sizeof(line), "median_cycles", result->median);
+    append_field(line, &pos, sizeof(line), "p99_cycles", result->p99);
+    append_field(line, &pos, sizeof(line), "min_ns", result->min_ns);
+    append_field(line, &pos, sizeof(line), "median_ns", result->median_ns);
+    append_field(line, &pos, sizeof(line), "p99_ns", result->p99_ns);
+    append_field(line, &pos, sizeof(line), "tsc_hz", tsc_get_hz());
+    str_append(line, &pos, sizeof(line), "\n");
+    logger_write_port(VIRTIO_CONSOLE_PORT_LOG, (const uint8_t *)line, (uint32_t)pos);
+}
+
+bool bench_run(const bench_t *bench, bench_result_t *result) {
+    static uint64_t samples[BENCH_SAMPLES];
+    
+    if (bench->setup && !bench->setup()) {
+        return false;
+    }
+    if (timer_overhead == 0) {
+        timer_overhead = measure_timer_overhead();
+    }
+    
+    for (int i = 0; i < BENCH_WARMUP; i++) {
+        bench->run();
+    }
+    for (int i = 0; i < BENCH_SAMPLES; i++) {
+        uint64_t start = bench_tsc_begin();
+        bench->run();
+        uint64_t cycles = bench_tsc_end() - start;
+        samples[i] = cycles > timer_overhead ? cycles - timer_overhead : 0;
+    }
+    
+    if (bench->teardown) {
+        bench->teardown();
+    }
+    
+    // Reject slow outliers above the upper Tukey fence
+    sort_samples(samples, BENCH_SAMPLES);
+    uint64_t q1 = samples[BENCH_SAMPLES / 4];
+    uint64_t q3 = samples[BENCH_SAMPLES * 3 / 4];
+    uint64_t fence = q3 + 3 * (q3 - q1);
+    uint32_t kept = BENCH_SAMPLES;
+    while (kept > 1 && samples[kept - 1] > fence) {
+        kept--;
+    }
+    
+    result->samples = kept;
+    result->rejected = BENCH_SAMPLES - kept;
+    result->min = samples[0];
+    result->median = samples[kept / 2];
+    result->p99 = samples[(kept * 99) / 100];
+    result->min_ns = cycles_to_ns(result->min);
+    result->median_ns = cycles_to_ns(result->median);
+    result->p99_ns = cycles_to_ns(result->p99);
+    
+    bench_emit(bench, result);
+    return true;
+}
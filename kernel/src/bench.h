@@ -0,0 +1,50 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Microbenchmark registry
+//
+// A benchmark is a run() callback timed one call at a time with fenced TSC
+// reads, after BENCH_WARMUP untimed calls. Samples above the upper Tukey fence
+// (Q3 + 3 * IQR: interrupts, SMIs, host preemption) are rejected before the
+// min/median/p99 are taken. Timer overhead is measured once and subtracted.
+// Results also go out as one "BENCH ..." key=value line on the log port
+// (virtio console or serial) for CI trend tracking.
+
+#define BENCH_MAX       32
+#define BENCH_WARMUP    16
+#define BENCH_SAMPLES   201
+
+typedef struct {
+    const char *name;
+    bool (*setup)(void);     // Optional, false skips the benchmark
+    void (*run)(void);       // One timed iteration
+    void (*teardown)(void);  // Optional
+} bench_t;
+
+typedef struct {
+    uint32_t samples;   // Samples kept after outlier rejection
+    uint32_t rejected;
+    uint64_t min;       // TSC cycles
+    uint64_t median;
+    uint64_t p99;
+    uint64_t min_ns;    // 0 if the TSC isn't calibrated
+    uint64_t median_ns;
+    uint64_t p99_ns;
+} bench_result_t;
+
+// Add a benchmark. name must stay valid (a literal).
+bool bench_register(const char *name, bool (*setup)(void), void (*run)(void), void (*teardown)(void));
+
+// Register the built-in suite (once)
+void bench_init(void);
+
+uint32_t bench_count(void);
+const bench_t *bench_get(uint32_t index);
+
+// Time a benchmark and emit its BENCH line. Returns false if setup failed.
+bool bench_run(const bench_t *bench, bench_result_t *result);
+
+#endif // BENCH_H
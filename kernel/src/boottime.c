@@ -0,0 +1,134 @@
+#include "boottime.h"
+#include "tsc.h"
+#include "logger.h"
+#include "string.h"
+#include "virtio_console.h"
+#include <stddef.h>
+
+static boot_stage_t stages[BOOT_MAX_STAGES];
+static uint32_t stage_count = 0;
+static uint64_t entry_tsc = 0;
+static uint64_t last_mark = 0;
+static uint64_t desktop_tsc = 0;
+static bool timeline_logged = false;
+
+typedef struct {
+    const char *name;
+    void (*init)(void);
+} boot_deferred_t;
+
+static boot_deferred_t deferred[BOOT_MAX_DEFERRED];
+static uint32_t deferred_count = 0;
+static uint32_t deferred_next = 0;
+
+void boot_timeline_start(void) {
+    entry_tsc = tsc_read();
+    last_mark = entry_tsc;
+}
+
+void boot_stage(const char *name) {
+    uint64_t now = tsc_read();
+    if (stage_count < BOOT_MAX_STAGES) {
+        stages[stage_count].name = name;
+        stages[stage_count].start = last_mark;
+        stages[stage_count].end = now;
+        stage_count++;
+    }
+    last_mark = now;
+}
+
+bool boot_defer(const char *name, void (*init)(void)) {
+    if (deferred_count >= BOOT_MAX_DEFERRED) {
+        return false;
+    }
+    deferred[deferred_count].name = name;
+    deferred[deferred_count].init = init;
+    deferred_count++;
+    return true;
+}
+
+uint32_t boot_stage_count(void) {
+    return stage_count;
+}
+
+const boot_stage_t *boot_get_stage(uint32_t index) {
+    return index < stage_count ? &stages[index] : NULL;
+}
+
+// Microseconds as "m.uuu" milliseconds, right-aligned in width columns
+static void append_ms(char *line, size_t *pos, size_t size, uint64_t us, int width) {
+    char text[32];
+    size_t length = 0;
+    str_append_u64(text, &length, sizeof(text), us / 1000, 10);
+    str_append(text, &length, sizeof(text), us % 1000 < 100 ? (us % 1000 < 10 ? ".00" : ".0") : ".");
+    str_append_u64(text, &length, sizeof(text), us % 1000, 10);
+    
+    for (int pad = (int)length; pad < width; pad++) {
+        str_append(line, pos, size, " ");
+    }
+    str_append(line, pos, size, text);
+}
+
+void boot_timeline_print(void (*print)(const char *line)) {
+    char line[128];
+    size_t pos = 0;
+    
+    if (tsc_get_hz() == 0) {
+        print("Boot timeline: TSC not calibrated\n");
+        return;
+    }
+    
+    str_append(line, &pos, sizeof(line), "Boot timeline (ms from kernel entry; firmware + bootloader took ");
+    append_ms(line, &pos, sizeof(line), tsc_to_us(entry_tsc), 0);
+    str_append(line, &pos, sizeof(line), " ms):\n");
+    print(line);
+    
+    for (uint32_t i = 0; i < stage_count; i++) {
+        pos = 0;
+        str_append(line, &pos, sizeof(line), "  ");
+        append_ms(line, &pos, sizeof(line), tsc_to_us(stages[i].start - entry_tsc), 10);
+        str_append(line, &pos, sizeof(line), "  +");
+        append_ms(line, &pos, sizeof(line), tsc_to_us(stages[i].end - stages[i].start), 10);
+        str_append(line, &pos, sizeof(line), "  ");
+        str_append(line, &pos, sizeof(line), stages[i].name);
+        if (desktop_tsc != 0 && stages[i].start >= desktop_tsc) {
+            str_append(line, &pos, sizeof(line), " (deferred)");
+        }
+        str_append(line, &pos, sizeof(line), "\n");
+        print(line);
+    }
+    
+    if (desktop_tsc != 0) {
+        pos = 0;
+        str_append(line, &pos, sizeof(line), "  Desktop ready at ");
+        append_ms(line, &pos, sizeof(line), tsc_to_us(desktop_tsc - entry_tsc), 0);
+        str_append(line, &pos, sizeof(line), " ms\n");
+        print(line);
+    }
+}
+
+static void boot_print_log(const char *line) {
+    logger_write_port(VIRTIO_CONSOLE_PORT_LOG, (const uint8_t *)line, (uint32_t)strlen(line));
+}
+
+void boot_timeline_finish(void) {
+    desktop_tsc = tsc_read();
+    last_mark = desktop_tsc;
+}
+
+void boot_poll(void) {
+    if (timeline_logged || desktop_tsc == 0) {
+        return;
+    }
+    
+    if (deferred_next < deferred_count) {
+        boot_deferred_t *stage = &deferred[deferred_next++];
+        last_mark = tsc_read();
+        stage->init();
+        boot_stage(stage->name);
+        return;
+    }
+    
+    timeline_logged = true;
+    boot_timeline_print(boot_print_log);
+}
@@ -0,0 +1,51 @@
+#ifndef BOOTTIME_H
+#define BOOTTIME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Boot timeline
+//
+// kmain marks the TSC at entry and after every initialization stage. Stages
+// are recorded as raw TSC values (the first ones run before tsc_calibrate())
+// and converted when printed. The TSC value at entry is also the time spent
+// in firmware and the bootloader, since the TSC counts from CPU reset.
+//
+// Stages the desktop doesn't need are deferred: boot_defer() queues them and
+// the idle loop runs one per boot_poll() call once the desktop is up, in the
+// order they were queued (so a deferred stage may depend on earlier ones).
+// The timeline goes to the log port when the last one has run.
+
+#define BOOT_MAX_STAGES   32
+#define BOOT_MAX_DEFERRED 8
+
+typedef struct {
+    const char *name;
+    uint64_t start;  // TSC
+    uint64_t end;
+} boot_stage_t;
+
+// First thing in kmain
+void boot_timeline_start(void);
+
+// Close the stage that ran since the previous mark. name must stay valid.
+void boot_stage(const char *name);
+
+// Run init after the desktop is up. name must stay valid.
+bool boot_defer(const char *name, void (*init)(void));
+
+// Mark the desktop as up. Deferred stages only start from the idle loop, after
+// the first frames; the timeline is logged once they are done.
+void boot_timeline_finish(void);
+
+// Run the next deferred init stage, or log the timeline when none are left.
+// Called from the idle loop.
+void boot_poll(void);
+
+uint32_t boot_stage_count(void);
+const boot_stage_t *boot_get_stage(uint32_t index);
+
+// Write the timeline one line at a time
+void boot_timeline_print(void (*print)(const char *line));
+
+#endif // BOOTTIME_H
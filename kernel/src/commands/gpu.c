@@ -5,6 +5,9 @@
 #include "../shell.h"
 #include "../pci.h"
 #include "../mouse.h"
+#include "../string.h"
+#include "../display_server_rust.h"
+#include "../tsc.h"
 #include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
@@ -15,20 +18,11 @@ typedef struct {
     float angle_y;
     float angle_z;
     uint32_t frame_count;
-    bool animating;                       // True if animation is running
-    uint64_t animation_start_time;        // Start time in CPU cycles (for continuous rotation)
-    uint64_t animation_duration_cycles;   // Not used for continuous animation (kept for compatibility)
-    bool animation_complete;              // Not used for continuous animation (kept for compatibility)
-    uint64_t last_frame_time;            // Time of last frame for frame rate control
-    uint64_t target_frame_interval;      // Target time between frames (~30 FPS)
+    uint64_t elapsed_us;                  // Animation time accumulated from frame deltas
 } gpu_3d_state_t;
 
-// Get current CPU timestamp counter (RDTSC)
-static uint64_t get_cpu_timestamp(void) {
-    uint32_t low, high;
-    __asm__ volatile ("rdtsc" : "=a" (low), "=d" (high));
-    return ((uint64_t)high << 32) | low;
-}
+// One full rotation of the cube
+#define CUBE_ROTATION_US 2000000ULL
 
 // Simple delay function for animation
 static void delay_animation(uint32_t iterations) {
@@ -122,9 +116,11 @@ static void draw_3d_line(window_t *win, point3d_t p1, point3d_t p2,
     project_3d(&p1, &x1, &y1, center_x, center_y, scale);
     project_3d(&p2, &x2, &y2, center_x, center_y, scale);
     
-    // Clamp to window bounds
-    if (x1 < 0 || x1 >= (int)win->width || y1 < 20 || y1 >= (int)win->height) return;
-    if (x2 < 0 || x2 >= (int)win->width || y2 < 20 || y2 >= (int)win->height) return;
+    // Clamp to content area bounds
+    uint32_t content_w = 0, content_h = 0;
+    wm_get_content_size(win, &content_w, &content_h);
+    if (x1 < 0 || x1 >= (int)content_w || y1 < 0 || y1 >= (int)content_h) return;
+    if (x2 < 0 || x2 >= (int)content_w || y2 < 0 || y2 >= (int)content_h) return;
     
     // Bresenham's line algorithm
     int dx = (x2 > x1) ? (x2 - x1) : (x1 - x2);
@@ -137,7 +133,7 @@ static void draw_3d_line(window_t *win, point3d_t p1, point3d_t p2,
     
     while (1) {
         // Draw pixel if within bounds
-        if (x >= 0 && x < (int)win->width && y >= 20 && y < (int)win->height) {
+        if (x >= 0 && x < (int)content_w && y >= 0 && y < (int)content_h) {
             wm_draw_pixel_to_window(win, x, y, color);
         }
         
@@ -195,6 +191,25 @@ static void draw_3d_cube(window_t *win, gpu_3d_state_t *state,
     draw_3d_line(win, vertices[3], vertices[7], center_x, center_y, scale, color);
 }
 
+// Animation step for the 3D window: advance the rotation by the frame delta.
+// The window manager calls this once per frame and redraws the window after it.
+static bool step_3d_animation(window_t *win, void *user_data, uint64_t now_us, uint64_t delta_us) {
+    (void)win;
+    (void)now_us;
+    gpu_3d_state_t *state = (gpu_3d_state_t *)user_data;
+    
+    state->elapsed_us += delta_us;
+    
+    // Continuous rotation (wraps around every CUBE_ROTATION_US)
+    float rotation_factor = (float)(state->elapsed_us % CUBE_ROTATION_US) / (float)CUBE_ROTATION_US;
+    state->angle_x = rotation_factor * 6.28f;  // Full rotation (2π)
+    state->angle_y = rotation_factor * 3.14f;  // Half rotation (π)
+    state->angle_z = rotation_factor * 4.71f;  // 3/4 rotation (3π/2)
+    state->frame_count++;
+    
+    return true; // Runs until the window is closed
+}
+
 // Draw callback for 3D animation window
 static void draw_3d_animation(window_t *win) {
     if (!win || !win->user_data) {
@@ -202,59 +217,21 @@ static void draw_3d_animation(window_t *win) {
     }
     
     gpu_3d_state_t *state = (gpu_3d_state_t *)win->user_data;
-    uint64_t current_time = get_cpu_timestamp();
-    
-    // Update rotation angles for continuous animation
-    if (state->animating) {
-        // Frame rate control: only update angles if enough time has passed
-        uint64_t time_since_last_frame = current_time - state->last_frame_time;
-        
-        if (time_since_last_frame >= state->target_frame_interval) {
-            // Calculate elapsed time since animation started
-            uint64_t elapsed_cycles = current_time - state->animation_start_time;
-            
-            // Use a fixed rotation speed (cycles per full rotation)
-            // For smooth animation: ~2 seconds per full rotation at ~1 GHz = 2 billion cycles
-            uint64_t cycles_per_rotation = 2000000000ULL; // 2 seconds per rotation at ~1 GHz
-            
-            // Calculate continuous rotation angles (wraps around automatically)
-            float rotation_factor = (float)(elapsed_cycles % cycles_per_rotation) / (float)cycles_per_rotation;
-            
-            // Update angles for continuous rotation
-            state->angle_x = rotation_factor * 6.28f;  // Full rotation (2π)
-            state->angle_y = rotation_factor * 3.14f;  // Half rotation (π)
-            state->angle_z = rotation_factor * 4.71f;  // 3/4 rotation (3π/2)
-            
-            // Keep angles in [0, 2π) range
-            while (state->angle_x >= 6.28f) state->angle_x -= 6.28f;
-            while (state->angle_y >= 6.28f) state->angle_y -= 6.28f;
-            while (state->angle_z >= 6.28f) state->angle_z -= 6.28f;
-            
-            state->last_frame_time = current_time;
-            state->frame_count++;
-        }
-    }
     
     // Clear window content area (below title bar)
     wm_clear_window(win, 0x000000);
     
-    // Calculate center and scale
-    int center_x = win->width / 2;
-    int center_y = (win->height / 2) + 10; // Offset for title bar
+    // Calculate center and scale (content area coordinates)
+    uint32_t content_w = 0, content_h = 0;
+    wm_get_content_size(win, &content_w, &content_h);
+    int center_x = content_w / 2;
+    int center_y = content_h / 2;
     float cube_size = 1.0f;
     float scale = 200.0f;
     
     // Draw the 3D cube
     draw_3d_cube(win, state, center_x, center_y, cube_size, scale);
     
-    // Auto-invalidate for next frame to keep animation running continuously
-    // This makes the animation independent and continuous
-    if (state->animating) {
-        // Always invalidate to keep animation running
-        // The window manager will redraw this window on next update cycle
-        wm_invalidate_window(win);
-    }
-    
     // Draw info text
     wm_draw_text_to_window(win, "3D Cube Animation", 10, 25, 0xffffff);
     
@@ -279,8 +256,8 @@ static void draw_3d_animation(window_t *win) {
     
     // Draw animation status (always running continuously)
     uint32_t status_color = 0xffff00; // Yellow for running
-    wm_draw_text_to_window(win, frame_str, 10, win->height - 50, status_color);
-    wm_draw_text_to_window(win, "Animation: RUNNING", 10, win->height - 30, 0xffff00);
+    wm_draw_text_to_window(win, frame_str, 10, content_h - 50, status_color);
+    wm_draw_text_to_window(win, "Animation: RUNNING", 10, content_h - 30, 0xffff00);
 }
 
 // GPU test command - demonstrates GPU rendering capabilities
@@ -298,6 +275,30 @@ void cmd_gpu_test(const char *args) {
         terminal_print("NOT AVAILABLE (Using CPU fallback)\n");
     }
     
+    // Show the flush strategy picked by the boot-time calibration
+    uint32_t stream_threshold = gpu_get_stream_threshold();
+    terminal_print("Flush mode: ");
+    if (stream_threshold == 0xFFFFFFFF) {
+        terminal_print("regular stores\n");
+    } else {
+        char threshold_str[16];
+        int k = 0;
+        uint32_t kib = stream_threshold / 1024;
+        char rev[16];
+        int r = 0;
+        do {
+            rev[r++] = '0' + (kib % 10);
+            kib /= 10;
+        } while (kib > 0);
+        while (r > 0) {
+            threshold_str[k++] = rev[--r];
+        }
+        threshold_str[k] = '\0';
+        terminal_print("non-temporal stores for blits >= ");
+        terminal_print(threshold_str);
+        terminal_print(" KiB\n");
+    }
+    
     // Check PCI devices
     terminal_print("\nPCI Device Scan:\n");
     int device_count = pci_get_device_count();
@@ -369,32 +370,32 @@ void cmd_gpu_test(const char *args) {
     terminal_print("Drawing GPU test pattern...\n");
     
     // Draw colored rectangles (these will use GPU acceleration if available)
-    wm_draw_filled_rect_to_window(test_window, 20, 40, 100, 60, 0xff0000);  // Red
-    wm_draw_filled_rect_to_window(test_window, 140, 40, 100, 60, 0x00ff00);  // Green
-    wm_draw_filled_rect_to_window(test_window, 260, 40, 100, 60, 0x0000ff); // Blue
+    wm_draw_filled_rect_to_window(test_window, 20, 20, 100, 60, 0xff0000);  // Red
+    wm_draw_filled_rect_to_window(test_window, 140, 20, 100, 60, 0x00ff00);  // Green
+    wm_draw_filled_rect_to_window(test_window, 260, 20, 100, 60, 0x0000ff); // Blue
     
-    wm_draw_filled_rect_to_window(test_window, 20, 120, 100, 60, 0xffff00);  // Yellow
-    wm_draw_filled_rect_to_window(test_window, 140, 120, 100, 60, 0xff00ff); // Magenta
-    wm_draw_filled_rect_to_window(test_window, 260, 120, 100, 60, 0x00ffff);  // Cyan
+    wm_draw_filled_rect_to_window(test_window, 20, 100, 100, 60, 0xffff00);  // Yellow
+    wm_draw_filled_rect_to_window(test_window, 140, 100, 100, 60, 0xff00ff); // Magenta
+    wm_draw_filled_rect_to_window(test_window, 260, 100, 100, 60, 0x00ffff);  // Cyan
     
     // Draw borders
-    wm_draw_rect_to_window(test_window, 20, 40, 100, 60, 0xffffff);
-    wm_draw_rect_to_window(test_window, 140, 40, 100, 60, 0xffffff);
-    wm_draw_rect_to_window(test_window, 260, 40, 100, 60, 0xffffff);
-    wm_draw_rect_to_window(test_window, 20, 120, 100, 60, 0xffffff);
-    wm_draw_rect_to_window(test_window, 140, 120, 100, 60, 0xffffff);
-    wm_draw_rect_to_window(test_window, 260, 120, 100, 60, 0xffffff);
+    wm_draw_rect_to_window(test_window, 20, 20, 100, 60, 0xffffff);
+    wm_draw_rect_to_window(test_window, 140, 20, 100, 60, 0xffffff);
+    wm_draw_rect_to_window(test_window, 260, 20, 100, 60, 0xffffff);
+    wm_draw_rect_to_window(test_window, 20, 100, 100, 60, 0xffffff);
+    wm_draw_rect_to_window(test_window, 140, 100, 100, 60, 0xffffff);
+    wm_draw_rect_to_window(test_window, 260, 100, 100, 60, 0xffffff);
     
     // Draw text information
     if (gpu_available) {
-        wm_draw_text_to_window(test_window, "GPU: ENABLED", 20, 200, 0x00ff00);
-        wm_draw_text_to_window(test_window, "Hardware acceleration active", 20, 220, 0xffffff);
+        wm_draw_text_to_window(test_window, "GPU: ENABLED", 20, 180, 0x00ff00);
+        wm_draw_text_to_window(test_window, "Hardware acceleration active", 20, 200, 0xffffff);
     } else {
-        wm_draw_text_to_window(test_window, "GPU: DISABLED", 20, 200, 0xff0000);
-        wm_draw_text_to_window(test_window, "Using CPU rendering", 20, 220, 0xffffff);
+        wm_draw_text_to_window(test_window, "GPU: DISABLED", 20, 180, 0xff0000);
+        wm_draw_text_to_window(test_window, "Using CPU rendering", 20, 200, 0xffffff);
     }
     
-    wm_draw_text_to_window(test_window, "Test Pattern", 20, 20, 0xffffff);
+    wm_draw_text_to_window(test_window, "Test Pattern", 20, 0, 0xffffff);
     
     // Draw a gradient pattern to test GPU performance
     terminal_print("Drawing gradient pattern (GPU stress test)...\n");
@@ -404,7 +405,7 @@ void cmd_gpu_test(const char *args) {
             uint32_t g = (y * 255) / 50;
             uint32_t b = 128;
             uint32_t color = (r << 16) | (g << 8) | b;
-            wm_draw_pixel_to_window(test_window, 20 + x, 190 + y, color);
+            wm_draw_pixel_to_window(test_window, 20 + x, 170 + y, color);
         }
     }
     
@@ -418,38 +419,18 @@ void cmd_gpu_test(const char *args) {
                                              WINDOW_MOVABLE | WINDOW_CLOSABLE);
     
     if (anim_window) {
-        // Get initial timestamp for continuous animation
-        uint64_t start_time = get_cpu_timestamp();
-        
-        // Target frame rate: ~30 FPS
-        // At ~1 GHz: 1 second = 1 billion cycles, so 30 FPS = ~33 million cycles per frame
-        uint64_t target_frame_interval = 33000000ULL; // ~30 FPS at ~1 GHz
-        
-        // Allocate animation state
-        static gpu_3d_state_t anim_state = {
-            .angle_x = 0.0f,
-            .angle_y = 0.0f,
-            .angle_z = 0.0f,
-            .frame_count = 0,
-            .animating = true,
-            .animation_start_time = 0,
-            .animation_duration_cycles = 0, // Not used for continuous animation
-            .animation_complete = false,     // Not used for continuous animation
-            .last_frame_time = 0,
-            .target_frame_interval = 0
-        };
-        
-        // Initialize continuous animation
-        anim_state.animation_start_time = start_time;
-        anim_state.last_frame_time = start_time;
-        anim_state.target_frame_interval = target_frame_interval;
+        // Animation state (restarted each time the test runs)
+        static gpu_3d_state_t anim_state;
+        anim_state = (gpu_3d_state_t){0};
         
         // Set draw callback and user data
         anim_window->draw_callback = draw_3d_animation;
         anim_window->user_data = &anim_state;
         
-        // Initial draw - animation will continue independently and continuously
-        wm_invalidate_window(anim_window);
+        // The window manager steps the animation once per frame until the window closes
+        if (wm_animate(anim_window, step_3d_animation, &anim_state) == 0) {
+            terminal_print("Warning: animation table full, cube will not rotate\n");
+        }
         wm_update();
         
         terminal_print("3D animation started! It will run continuously and independently.\n");
@@ -468,10 +449,89 @@ void cmd_gpu_test(const char *args) {
     terminal_print("Close the windows to finish the test.\n");
 }
 
+// Frame capture command - streams presented frames over the serial port
+void cmd_capture(const char *args) {
+    if (!args || *args == '\0') {
+        terminal_print("Usage: capture <hash|rle|off> [offscreen]\n");
+        return;
+    }
+    
+    if (strcmp(args, "off") == 0) {
+        ds_capture_stop();
+        terminal_print("Frame capture stopped\n");
+        return;
+    }
+    
+    uint32_t mode = DS_CAPTURE_OFF;
+    bool offscreen = false;
+    if (strncmp(args, "hash", 4) == 0) {
+        mode = DS_CAPTURE_HASH;
+        args += 4;
+    } else if (strncmp(args, "rle", 3) == 0) {
+        mode = DS_CAPTURE_RLE;
+        args += 3;
+    } else {
+        terminal_print("Unknown capture mode. Use hash, rle or off\n");
+        return;
+    }
+    
+    while (*args == ' ') args++;
+    if (strcmp(args, "offscreen") == 0) {
+        offscreen = true;
+    }
+    
+    // fps stats need the TSC frequency
+    uint64_t tsc_hz = tsc_get_hz();
+    if (tsc_hz == 0) {
+        tsc_hz = tsc_calibrate();
+    }
+    
+    ds_capture_start(mode, offscreen, tsc_hz);
+    terminal_print("Frame capture started on serial port");
+    if (offscreen) {
+        terminal_print(" (offscreen, display frozen until 'capture off')");
+    }
+    terminal_print("\n");
+}
+
+// Display scale command - shows or sets the compositor's integer HiDPI factor
+void cmd_scale(const char *args) {
+    char num_str[16];
+    
+    if (args && *args >= '1' && *args <= '4' && args[1] == '\0') {
+        ds_set_scale((uint32_t)(*args - '0'));
+    } else if (args && *args != '\0') {
+        terminal_print("Usage: scale [1-4]\n");
+        return;
+    }
+    
+    uint32_t width = 0, height = 0;
+    ds_get_screen_size(&width, &height);
+    
+    terminal_print("Display scale: ");
+    int_to_string((int)ds_get_scale(), num_str);
+    terminal_print(num_str);
+    terminal_print("x (logical screen ");
+    int_to_string((int)width, num_str);
+    terminal_print(num_str);
+    terminal_print("x");
+    int_to_string((int)height, num_str);
+    terminal_print(num_str);
+    terminal_print(")\n");
+}
+
 // Register GPU commands
 void register_gpu_commands(void) {
     register_command("gpu-test", cmd_gpu_test, 
                      "Test GPU rendering capabilities", 
                      "gpu-test", 
                      "Graphics");
+    register_command("capture", cmd_capture,
+                     "Capture rendered frames over serial",
+                     "capture <hash|rle|off> [offscreen]",
+                     "Graphics");
+    register_command("scale", cmd_scale,
+                     "Show or set the display scale factor",
+                     "scale [1-4]",
+                     "Graphics");
 }
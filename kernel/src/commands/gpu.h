@@ -4,6 +4,12 @@
 // GPU test command functions
 void cmd_gpu_test(const char *args);
 
+// Frame capture command (hash/RLE frames over serial)
+void cmd_capture(const char *args);
+
+// Display scale command (integer HiDPI factor)
+void cmd_scale(const char *args);
+
 // Register GPU commands
 void register_gpu_commands(void);
 
@@ -0,0 +1,227 @@
+#include "perf.h"
+#include "system.h"
+#include "../terminal.h"
+#include "../string.h"
+#include "../profiler.h"
+#include "../pmu.h"
+#include "../bench.h"
+#include "../boottime.h"
+#include <stdint.h>
+#include <stddef.h>
+
+// Profile command - samples kernel stacks and writes flamegraph input
+void cmd_profile(const char *args) {
+    char num_str[16];
+    
+    if (args && strcmp(args, "stop") == 0) {
+        if (!profile_running()) {
+            terminal_print("No profile running\n");
+            return;
+        }
+        profile_stop();
+        return;
+    }
+    
+    uint32_t seconds = 0;
+    while (args && *args >= '0' && *args <= '9' && seconds <= 60) {
+        seconds = seconds * 10 + (uint32_t)(*args - '0');
+        args++;
+    }
+    if (!args || *args != '\0' || seconds < 1 || seconds > 60) {
+        terminal_print("Usage: profile <seconds 1-60> | profile stop\n");
+        return;
+    }
+    
+    if (!profile_start(seconds)) {
+        terminal_print("A profile is already running ('profile stop' ends it)\n");
+        return;
+    }
+    
+    terminal_print("Profiling for ");
+    int_to_string((int)seconds, num_str);
+    terminal_print(num_str);
+    terminal_print("s at ");
+    int_to_string(PROFILE_HZ, num_str);
+    terminal_print(num_str);
+    terminal_print(" Hz; folded stacks go to the profile port or serial\n");
+}
+
+// Print an unsigned 64-bit value
+static void print_u64(uint64_t value) {
+    char text[24];
+    size_t length = 0;
+    str_append_u64(text, &length, sizeof(text), value, 10);
+    terminal_print(text);
+}
+
+// Print an unsigned 64-bit value right-aligned in width columns
+static void print_u64_padded(uint64_t value, int width) {
+    char text[24];
+    size_t length = 0;
+    str_append_u64(text, &length, sizeof(text), value, 10);
+    for (int pad = (int)length; pad < width; pad++) {
+        terminal_print(" ");
+    }
+    terminal_print(text);
+}
+
+// Print numerator / denominator with two decimals
+static void print_ratio(uint64_t numerator, uint64_t denominator) {
+    if (denominator == 0) {
+        terminal_print("-");
+        return;
+    }
+    uint64_t hundredths = numerator * 100 / denominator;
+    print_u64(hundredths / 100);
+    terminal_print(".");
+    if (hundredths % 100 < 10) {
+        terminal_print("0");
+    }
+    print_u64(hundredths % 100);
+}
+
+// Perfstat command - per-scope hardware counter aggregates
+void cmd_perfstat(const char *args) {
+    if (args && strcmp(args, "reset") == 0) {
+        perf_reset();
+        terminal_print("Performance counters reset\n");
+        return;
+    } else if (args && *args != '\0') {
+        terminal_print("Usage: perfstat [reset]\n");
+        return;
+    }
+    
+    terminal_print("PMU events:");
+    bool any = false;
+    for (int event = 0; event < PMU_EVENT_COUNT; event++) {
+        if (pmu_event_available((pmu_event_t)event)) {
+            terminal_print(" ");
+            terminal_print(pmu_event_name((pmu_event_t)event));
+            any = true;
+        }
+    }
+    terminal_print(any ? "\n" : " none (TSC time only)\n");
+    
+    if (perf_scope_count() == 0) {
+        terminal_print("No scopes recorded yet\n");
+        return;
+    }
+    
+    for (uint32_t scope = 0; scope < perf_scope_count(); scope++) {
+        const perf_scope_stats_t *stats = perf_scope_stats(scope);
+        terminal_print(stats->name);
+        terminal_print(": ");
+        print_u64(stats->calls);
+        terminal_print(" calls, ");
+        print_u64(stats->calls ? stats->tsc / stats->calls : 0);
+        terminal_print(" TSC ticks/call");
+        if (pmu_event_available(PMU_CYCLES)) {
+            terminal_print(", ");
+            print_u64(stats->calls ? stats->counts[PMU_CYCLES] / stats->calls : 0);
+            terminal_print(" cycles/call");
+        }
+        terminal_print("\n");
+        
+        // IPC and misses per thousand instructions
+        uint64_t instructions = stats->counts[PMU_INSTRUCTIONS];
+        if (!pmu_event_available(PMU_INSTRUCTIONS) || instructions == 0) {
+            continue;
+        }
+        terminal_print("  IPC ");
+        print_ratio(instructions, stats->counts[PMU_CYCLES]);
+        static const struct {
+            pmu_event_t event;
+            const char *label;
+        } misses[] = {
+            { PMU_LLC_MISSES, "  LLC " },
+            { PMU_BRANCH_MISSES, "  branch " },
+            { PMU_DTLB_MISSES, "  dTLB " },
+        };
+        for (size_t i = 0; i < sizeof(misses) / sizeof(misses[0]); i++) {
+            if (pmu_event_available(misses[i].event)) {
+                terminal_print(misses[i].label);
+                print_ratio(stats->counts[misses[i].event] * 1000, instructions);
+                terminal_print(" MPKI");
+            }
+        }
+        terminal_print("\n");
+    }
+}
+
+// Bench command - runs registered microbenchmarks (all, or those whose name
+// starts with the argument)
+void cmd_bench(const char *args) {
+    bench_init();
+    
+    if (args && strcmp(args, "list") == 0) {
+        terminal_print("Benchmarks:\n");
+        for (uint32_t i = 0; i < bench_count(); i++) {
+            terminal_print("  ");
+            terminal_print(bench_get(i)->name);
+            terminal_print("\n");
+        }
+        return;
+    }
+    
+    size_t prefix_length = args ? strlen(args) : 0;
+    uint32_t ran = 0;
+    terminal_print("benchmark              min cyc   med cyc   p99 cyc    med ns\n");
+    for (uint32_t i = 0; i < bench_count(); i++) {
+        const bench_t *bench = bench_get(i);
+        if (prefix_length > 0 && strncmp(bench->name, args, prefix_length) != 0) {
+            continue;
+        }
+        
+        bench_result_t result;
+        terminal_print(bench->name);
+        for (size_t pad = strlen(bench->name); pad < 20; pad++) {
+            terminal_print(" ");
+        }
+        if (!bench_run(bench, &result)) {
+            terminal_print("setup failed\n");
+            continue;
+        }
+        
+        print_u64_padded(result.min, 10);
+        print_u64_padded(result.median, 10);
+        print_u64_padded(result.p99, 10);
+        print_u64_padded(result.median_ns, 10);
+        if (result.rejected > 0) {
+            terminal_print("  (");
+            print_u64(result.rejected);
+            terminal_print(" outliers)");
+        }
+        terminal_print("\n");
+        ran++;
+    }
+    
+    if (ran == 0) {
+        terminal_print("No benchmark matches (see 'bench list')\n");
+    }
+}
+
+// Boottime command - time spent in each kmain initialization stage
+void cmd_boottime(const char *args) {
+    (void)args; // Unused parameter
+    boot_timeline_print(terminal_print);
+}
+
+// Register performance commands
+void register_perf_commands(void) {
+    register_command("profile", cmd_profile,
+                     "Sample kernel stacks for a flamegraph",
+                     "profile <seconds 1-60> | profile stop",
+                     "Performance");
+    register_command("perfstat", cmd_perfstat,
+                     "Show hardware counter stats per scope",
+                     "perfstat [reset]",
+                     "Performance");
+    register_command("bench", cmd_bench,
+                     "Run kernel microbenchmarks",
+                     "bench [list|<name prefix>]",
+                     "Performance");
+    register_command("boottime", cmd_boottime,
+                     "Show the boot timeline",
+                     "boottime",
+                     "Performance");
+}
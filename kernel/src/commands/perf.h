@@ -0,0 +1,19 @@
+#ifndef PERF_COMMANDS_H
+#define PERF_COMMANDS_H
+
+// Sampling profiler command
+void cmd_profile(const char *args);
+
+// Hardware counter scope statistics
+void cmd_perfstat(const char *args);
+
+// Microbenchmark suite
+void cmd_bench(const char *args);
+
+// Boot timeline
+void cmd_boottime(const char *args);
+
+// Register performance commands
+void register_perf_commands(void);
+
+#endif // PERF_COMMANDS_H
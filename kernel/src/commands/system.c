@@ -2,6 +2,7 @@
 #include "../terminal.h"
 #include "../string.h"
 #include "../audio.h"
+#include "../logger.h"
 #include "math.h"
 #include <stddef.h>
 
@@ -117,6 +118,64 @@ void cmd_cmdcount(const char *args) {
     }
 }
 
+void cmd_font(const char *args) {
+    if (args == NULL || strlen(args) == 0) {
+        terminal_print("Loaded fonts (* = current):\n");
+        list_available_fonts();
+        terminal_print("Usage: font <name>\n");
+        return;
+    }
+    
+    if (!set_current_font(args)) {
+        terminal_print("Unknown font: ");
+        terminal_print(args);
+        terminal_print("\n");
+        return;
+    }
+    terminal_print("Font set to ");
+    terminal_print(args);
+    terminal_print("\n");
+}
+
+void cmd_fontinfo(const char *args) {
+    (void)args; // Unused parameter
+    const font_info_t *font = terminal_get_font();
+    if (font == NULL) {
+        terminal_print("No font loaded\n");
+        return;
+    }
+    
+    char num[16];
+    terminal_print("Font: ");
+    terminal_print(font->name);
+    terminal_print("\nGlyph size: ");
+    int_to_string(font->width, num);
+    terminal_print(num);
+    terminal_print("x");
+    int_to_string(font->height, num);
+    terminal_print(num);
+    terminal_print("\nCharacters: ");
+    int_to_string(font->first_char, num);
+    terminal_print(num);
+    terminal_print("-");
+    int_to_string(font->first_char + font->glyph_count - 1, num);
+    terminal_print(num);
+    terminal_print("\n");
+    
+    // Sample of the upper half of Latin-1 when the font covers it
+    if (font->first_char + font->glyph_count > 0xA0) {
+        char sample[49];
+        for (int row = 0; row < 2; row++) {
+            for (int i = 0; i < 48; i++) {
+                sample[i] = (char)(0xA0 + row * 48 + i);
+            }
+            sample[48] = '\0';
+            terminal_print(sample);
+            terminal_print("\n");
+        }
+    }
+}
+
 void cmd_exit(const char *args) {
     (void)args; // Unused parameter
     terminal_print("Shutting down DEA OS...\n");
@@ -127,6 +186,9 @@ void cmd_exit(const char *args) {
     terminal_print("Thank you for using DEA OS!\n");
     terminal_print("System halted. You can now power off safely.\n");
     
+    // Write out the deferred log records and queued serial bytes
+    logger_drain();
+    
     // Disable interrupts and halt the system
     __asm__ volatile (
         "cli\n\t"          // Clear interrupt flag
@@ -141,6 +203,12 @@ void cmd_exit(const char *args) {
 
 
 
+void cmd_logtest(const char *args) {
+    (void)args; // Unused parameter
+    terminal_print("Logger record formatting: ");
+    terminal_print(logger_self_test() ? "OK\n" : "FAILED\n");
+}
+
 // Register all system commands
 void register_system_commands(void) {
     register_command("help", cmd_help, "Show available commands", "help [command]", "System");
@@ -151,6 +219,9 @@ void register_system_commands(void) {
     register_command("exit", cmd_exit, "Exit and halt the system", "exit", "System");
     register_command("version", cmd_version, "Show detailed version info", "version", "Info");
     register_command("cmdcount", cmd_cmdcount, "Show command registry status", "cmdcount", "System");
+    register_command("font", cmd_font, "List fonts or switch the terminal font", "font [name]", "System");
+    register_command("fontinfo", cmd_fontinfo, "Show the current font and a Latin-1 sample", "fontinfo", "System");
+    register_command("logtest", cmd_logtest, "Test logger record formatting limits", "logtest", "System");
     
     // Register math commands
     register_math_commands();
@@ -35,6 +35,7 @@ void cmd_cmdcount(const char *args);
 void cmd_font(const char *args);
 void cmd_fontinfo(const char *args);
 void cmd_exit(const char *args);
+void cmd_logtest(const char *args);
 void command_fpu_test(const char *args);
 
 #endif // COMMANDS_SYSTEM_H 
\ No newline at end of file
@@ -4,6 +4,7 @@
 #include "../shell.h"
 #include "../terminal.h"
 #include "../mouse.h"
+#include "../input.h"
 #include <stddef.h>
 
 // Example: Create a simple window with text
@@ -13,11 +14,11 @@ void create_simple_window_example(void) {
     
     if (win) {
         wm_clear_window(win, 0x2d2d2d); // Dark gray background
-        wm_draw_text_to_window(win, "Hello from Rust WM!", 10, 30, 0xffffff);
-        wm_draw_text_to_window(win, "This window was created", 10, 50, 0x00ff00);
-        wm_draw_text_to_window(win, "using the Rust window manager!", 10, 70, 0x00ff00);
-        wm_draw_text_to_window(win, "You can drag this window", 10, 90, 0xffff00);
-        wm_draw_text_to_window(win, "by clicking the title bar.", 10, 110, 0xffff00);
+        wm_draw_text_to_window(win, "Hello from Rust WM!", 10, 10, 0xffffff);
+        wm_draw_text_to_window(win, "This window was created", 10, 30, 0x00ff00);
+        wm_draw_text_to_window(win, "using the Rust window manager!", 10, 50, 0x00ff00);
+        wm_draw_text_to_window(win, "You can drag this window", 10, 70, 0xffff00);
+        wm_draw_text_to_window(win, "by clicking the title bar.", 10, 90, 0xffff00);
         wm_invalidate_window(win); // Force redraw
     }
 }
@@ -31,20 +32,20 @@ void create_colored_rectangles_example(void) {
         wm_clear_window(win, 0x1a1a1a);
         
         // Draw colored rectangles
-        wm_draw_filled_rect_to_window(win, 10, 30, 50, 30, 0xff0000);  // Red
-        wm_draw_filled_rect_to_window(win, 70, 30, 50, 30, 0x00ff00);  // Green
-        wm_draw_filled_rect_to_window(win, 130, 30, 50, 30, 0x0000ff); // Blue
+        wm_draw_filled_rect_to_window(win, 10, 10, 50, 30, 0xff0000);  // Red
+        wm_draw_filled_rect_to_window(win, 70, 10, 50, 30, 0x00ff00);  // Green
+        wm_draw_filled_rect_to_window(win, 130, 10, 50, 30, 0x0000ff); // Blue
         
-        wm_draw_filled_rect_to_window(win, 10, 70, 50, 30, 0xffff00);  // Yellow
-        wm_draw_filled_rect_to_window(win, 70, 70, 50, 30, 0xff00ff);  // Magenta
-        wm_draw_filled_rect_to_window(win, 130, 70, 50, 30, 0x00ffff); // Cyan
+        wm_draw_filled_rect_to_window(win, 10, 50, 50, 30, 0xffff00);  // Yellow
+        wm_draw_filled_rect_to_window(win, 70, 50, 50, 30, 0xff00ff);  // Magenta
+        wm_draw_filled_rect_to_window(win, 130, 50, 50, 30, 0x00ffff); // Cyan
         
         // Draw borders around rectangles
-        wm_draw_rect_to_window(win, 10, 30, 50, 30, 0xffffff);
-        wm_draw_rect_to_window(win, 70, 30, 50, 30, 0xffffff);
-        wm_draw_rect_to_window(win, 130, 30, 50, 30, 0xffffff);
+        wm_draw_rect_to_window(win, 10, 10, 50, 30, 0xffffff);
+        wm_draw_rect_to_window(win, 70, 10, 50, 30, 0xffffff);
+        wm_draw_rect_to_window(win, 130, 10, 50, 30, 0xffffff);
         
-        wm_draw_text_to_window(win, "Color Palette", 10, 110, 0xffffff);
+        wm_draw_text_to_window(win, "Color Palette", 10, 90, 0xffffff);
     }
 }
 
@@ -60,11 +61,11 @@ void create_pattern_example(void) {
         for (int y = 0; y < 8; y++) {
             for (int x = 0; x < 8; x++) {
                 uint32_t color = ((x + y) % 2 == 0) ? 0xffffff : 0x000000;
-                wm_draw_filled_rect_to_window(win, 10 + x * 20, 30 + y * 15, 20, 15, color);
+                wm_draw_filled_rect_to_window(win, 10 + x * 20, 10 + y * 15, 20, 15, color);
             }
         }
         
-        wm_draw_text_to_window(win, "Checkerboard", 10, 150, 0xffffff);
+        wm_draw_text_to_window(win, "Checkerboard", 10, 130, 0xffffff);
     }
 }
 
@@ -80,20 +81,20 @@ void create_multiple_windows_example(void) {
     
     if (win1) {
         wm_clear_window(win1, 0x2d2d2d);
-        wm_draw_text_to_window(win1, "First Window", 10, 30, 0xffffff);
-        wm_draw_text_to_window(win1, "Position: (50, 50)", 10, 50, 0xaaaaaa);
+        wm_draw_text_to_window(win1, "First Window", 10, 10, 0xffffff);
+        wm_draw_text_to_window(win1, "Position: (50, 50)", 10, 30, 0xaaaaaa);
     }
     
     if (win2) {
         wm_clear_window(win2, 0x2d4d2d);
-        wm_draw_text_to_window(win2, "Second Window", 10, 30, 0xffffff);
-        wm_draw_text_to_window(win2, "Position: (300, 100)", 10, 50, 0xaaaaaa);
+        wm_draw_text_to_window(win2, "Second Window", 10, 10, 0xffffff);
+        wm_draw_text_to_window(win2, "Position: (300, 100)", 10, 30, 0xaaaaaa);
     }
     
     if (win3) {
         wm_clear_window(win3, 0x2d2d4d);
-        wm_draw_text_to_window(win3, "Third Window", 10, 30, 0xffffff);
-        wm_draw_text_to_window(win3, "Position: (150, 250)", 10, 50, 0xaaaaaa);
+        wm_draw_text_to_window(win3, "Third Window", 10, 10, 0xffffff);
+        wm_draw_text_to_window(win3, "Position: (150, 250)", 10, 30, 0xaaaaaa);
     }
 }
 
@@ -105,13 +106,13 @@ void create_info_window_example(void) {
     if (win) {
         wm_clear_window(win, 0x1e1e1e);
         
-        wm_draw_text_to_window(win, "Window Manager Info", 10, 30, 0x4a90e2);
-        wm_draw_text_to_window(win, "Built with Rust", 10, 50, 0xffffff);
-        wm_draw_text_to_window(win, "Features:", 10, 70, 0xffff00);
-        wm_draw_text_to_window(win, "- Window creation", 10, 90, 0xaaaaaa);
-        wm_draw_text_to_window(win, "- Mouse dragging", 10, 110, 0xaaaaaa);
-        wm_draw_text_to_window(win, "- Text rendering", 10, 130, 0xaaaaaa);
-        wm_draw_text_to_window(win, "- Rectangle drawing", 10, 150, 0xaaaaaa);
+        wm_draw_text_to_window(win, "Window Manager Info", 10, 10, 0x4a90e2);
+        wm_draw_text_to_window(win, "Built with Rust", 10, 30, 0xffffff);
+        wm_draw_text_to_window(win, "Features:", 10, 50, 0xffff00);
+        wm_draw_text_to_window(win, "- Window creation", 10, 70, 0xaaaaaa);
+        wm_draw_text_to_window(win, "- Mouse dragging", 10, 90, 0xaaaaaa);
+        wm_draw_text_to_window(win, "- Text rendering", 10, 110, 0xaaaaaa);
+        wm_draw_text_to_window(win, "- Rectangle drawing", 10, 130, 0xaaaaaa);
     }
 }
 
@@ -204,6 +205,24 @@ static void cmd_wmdebug(const char *args) {
     terminal_print(mouse->left_button ? "PRESSED" : "RELEASED");
     terminal_print("\n");
     
+    // Input queue: how much motion was coalesced before the WM drained it
+    input_stats_t stats;
+    input_get_stats(&stats);
+    char stat_str[32];
+    terminal_print("Input events: ");
+    int_to_string((int)stats.queued, stat_str);
+    terminal_print(stat_str);
+    terminal_print(" queued, ");
+    int_to_string((int)stats.coalesced, stat_str);
+    terminal_print(stat_str);
+    terminal_print(" coalesced, ");
+    int_to_string((int)stats.dropped, stat_str);
+    terminal_print(stat_str);
+    terminal_print(" dropped, max depth ");
+    int_to_string((int)stats.max_depth, stat_str);
+    terminal_print(stat_str);
+    terminal_print("\n");
+    
     // Show window positions
     for (int i = 0; i < window_count && i < 10; i++) {
         int x, y, w, h;
@@ -22,10 +22,46 @@ surface_t* ds_create_surface(int x, int y, uint32_t width, uint32_t height, int
 void ds_destroy_surface(surface_t *surface);
 void ds_set_surface_position(surface_t *surface, int x, int y);
 void ds_set_surface_z_order(surface_t *surface, int z_order);
-void ds_set_surface_size(surface_t *surface, uint32_t width, uint32_t height);
+// Returns false (size unchanged) if the size fits neither a pool slot (800x600)
+// nor the single screen-sized scanout buffer
+bool ds_set_surface_size(surface_t *surface, uint32_t width, uint32_t height);
+// Largest width * height ds_set_surface_size currently accepts for the surface
+uint32_t ds_get_surface_capacity(surface_t *surface);
+// Hidden surfaces keep their buffer contents but are not composited
+void ds_set_surface_visible(surface_t *surface, bool visible);
 uint32_t* ds_get_surface_buffer(surface_t *surface);
 void ds_mark_dirty(int x, int y, uint32_t width, uint32_t height);
 void ds_update_cursor_position(int x, int y);
 void ds_render(void);
+// True when damage is waiting for the next ds_render()
+bool ds_has_damage(void);
+
+// Outline rectangle drawn above all surfaces (interactive resize preview)
+void ds_set_outline(int x, int y, uint32_t width, uint32_t height);
+void ds_clear_outline(void);
+
+// Call after writing the framebuffer directly (terminal output): the next flush
+// stops skipping dirty scanline segments whose hashes match what it last wrote
+void ds_invalidate_scanline_hashes(void);
+
+// Integer HiDPI scale factor (1-4). Surfaces, windows and the cursor use logical
+// pixels (framebuffer size / scale); the compositor upscales when flushing.
+void ds_set_scale(uint32_t scale);
+uint32_t ds_get_scale(void);
+
+// Logical screen size in pixels
+void ds_get_screen_size(uint32_t *width, uint32_t *height);
+
+// Frame capture modes for headless regression and performance tests
+#define DS_CAPTURE_OFF  0
+#define DS_CAPTURE_HASH 1  // "FRAME <n> hash=... bytes=... cycles=..." line per presented frame
+#define DS_CAPTURE_RLE  2  // Same line followed by the frame as [count, r, g, b] runs, 0-count terminated
+
+// Start capturing frames over serial. With offscreen set, frames are only rendered
+// into the backbuffer and VRAM is never written. tsc_hz (0 if unknown) enables fps stats.
+void ds_capture_start(uint32_t mode, bool offscreen, uint64_t tsc_hz);
+
+// Stop capturing and print a final "CAPSTATS" summary line
+void ds_capture_stop(void);
 
 #endif // DISPLAY_SERVER_RUST_H
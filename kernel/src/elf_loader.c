@@ -1,5 +1,6 @@
 #include "elf_loader.h"
 #include "string.h"
+#include "trace.h"
 
 // Forward declarations for memory functions (defined in main.c)
 void *memcpy(void *restrict dest, const void *restrict src, size_t n);
@@ -20,6 +21,7 @@ static void* program_malloc(size_t size) {
     
     void *ptr = &program_memory[program_memory_offset];
     program_memory_offset += size;
+    trace_emit(TRACE_ALLOC, TRACE_INSTANT, size, (uint64_t)ptr, 0);
     return ptr;
 }
 
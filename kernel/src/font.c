@@ -1,9 +1,20 @@
 #include "font.h"
+#include "string.h"
+#include "gpu_rust.h"
+#include <limine.h>
+
+// Defined in main.c
+void *memcpy(void *restrict dest, const void *restrict src, size_t n);
+void *memset(void *s, int c, size_t n);
 
 // Simple 8x8 bitmap font for basic characters
 const uint8_t font_8x8[][8] = {
     [' '] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
     ['!'] = {0x18, 0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x00},
+    ['.'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00},
+    [','] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x30, 0x00},
+    ['"'] = {0x66, 0x66, 0x24, 0x00, 0x00, 0x00, 0x00, 0x00},
+    ['\''] = {0x18, 0x18, 0x30, 0x00, 0x00, 0x00, 0x00, 0x00},
     ['A'] = {0x3C, 0x66, 0x66, 0x7E, 0x66, 0x66, 0x66, 0x00},
     ['B'] = {0x7C, 0x66, 0x66, 0x7C, 0x66, 0x66, 0x7C, 0x00},
     ['C'] = {0x3C, 0x66, 0x60, 0x60, 0x60, 0x66, 0x3C, 0x00},
@@ -33,7 +44,7 @@ const uint8_t font_8x8[][8] = {
     ['a'] = {0x00, 0x00, 0x3C, 0x06, 0x3E, 0x66, 0x3E, 0x00},
     ['b'] = {0x60, 0x60, 0x7C, 0x66, 0x66, 0x66, 0x7C, 0x00},
     ['c'] = {0x00, 0x00, 0x3C, 0x60, 0x60, 0x60, 0x3C, 0x00},
-    ['d'] = {0x06, 0x06, 0x06, 0x3E, 0x66, 0x66, 0x3E, 0x00},
+    ['d'] = {0x06, 0x06, 0x3E, 0x66, 0x66, 0x66, 0x3E, 0x00},
     ['e'] = {0x00, 0x00, 0x3C, 0x66, 0x7E, 0x60, 0x3C, 0x00},
     ['f'] = {0x1C, 0x36, 0x30, 0x7C, 0x30, 0x30, 0x30, 0x00},
     ['g'] = {0x00, 0x00, 0x3E, 0x66, 0x66, 0x3E, 0x06, 0x7C},
@@ -69,30 +80,256 @@ const uint8_t font_8x8[][8] = {
     [':'] = {0x00, 0x00, 0x18, 0x00, 0x00, 0x18, 0x00, 0x00},
     ['>'] = {0x00, 0x30, 0x0C, 0x03, 0x0C, 0x30, 0x00, 0x00},
     ['?'] = {0x3C, 0x66, 0x06, 0x0C, 0x18, 0x00, 0x18, 0x00},
-    ['/'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['\\'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['|'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['{'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['}'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['_'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['-'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['='] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['+'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['*'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['#'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['%'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['&'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['('] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    [')'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['['] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    [']'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['`'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['~'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['@'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['$'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['^'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    [';'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
-    ['<'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    ['/'] = {0x00, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x00, 0x00},
+    ['\\'] = {0x00, 0x60, 0x30, 0x18, 0x0C, 0x06, 0x00, 0x00},
+    ['|'] = {0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00},
+    ['{'] = {0x0E, 0x18, 0x18, 0x70, 0x18, 0x18, 0x0E, 0x00},
+    ['}'] = {0x70, 0x18, 0x18, 0x0E, 0x18, 0x18, 0x70, 0x00},
+    ['_'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x7E},
+    ['-'] = {0x00, 0x00, 0x00, 0x7E, 0x00, 0x00, 0x00, 0x00},
+    ['='] = {0x00, 0x00, 0x7E, 0x00, 0x7E, 0x00, 0x00, 0x00},
+    ['+'] = {0x00, 0x18, 0x18, 0x7E, 0x18, 0x18, 0x00, 0x00},
+    ['*'] = {0x00, 0x66, 0x3C, 0xFF, 0x3C, 0x66, 0x00, 0x00},
+    ['#'] = {0x6C, 0x6C, 0xFE, 0x6C, 0xFE, 0x6C, 0x6C, 0x00},
+    ['%'] = {0x00, 0x46, 0x66, 0x30, 0x18, 0xCC, 0xC4, 0x00},
+    ['&'] = {0x38, 0x6C, 0x38, 0x76, 0xDC, 0xCC, 0x76, 0x00},
+    ['('] = {0x0C, 0x18, 0x30, 0x30, 0x30, 0x18, 0x0C, 0x00},
+    [')'] = {0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x18, 0x30, 0x00},
+    ['['] = {0x3C, 0x30, 0x30, 0x30, 0x30, 0x30, 0x3C, 0x00},
+    [']'] = {0x3C, 0x0C, 0x0C, 0x0C, 0x0C, 0x0C, 0x3C, 0x00},
+    ['`'] = {0x30, 0x18, 0x0C, 0x00, 0x00, 0x00, 0x00, 0x00},
+    ['~'] = {0x76, 0xDC, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+    ['@'] = {0x3C, 0x66, 0x6E, 0x6E, 0x60, 0x62, 0x3C, 0x00},
+    ['$'] = {0x18, 0x3E, 0x60, 0x3C, 0x06, 0x7C, 0x18, 0x00},
+    ['^'] = {0x18, 0x3C, 0x66, 0x00, 0x00, 0x00, 0x00, 0x00},
+    [';'] = {0x00, 0x00, 0x18, 0x00, 0x00, 0x18, 0x30, 0x00},
+    ['<'] = {0x00, 0x0C, 0x30, 0xC0, 0x30, 0x0C, 0x00, 0x00},
     ['\n'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
     ['\r'] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
-}; 
\ No newline at end of file
+};
+
+// PSF2 fonts are passed to the kernel as Limine modules (see fonts/)
+__attribute__((used, section(".limine_requests")))
+static volatile struct limine_module_request module_request = {
+    .id = LIMINE_MODULE_REQUEST,
+    .revision = 0
+};
+
+#define PSF2_MAGIC 0x864ab572
+#define PSF2_HAS_UNICODE_TABLE 0x01
+#define PSF2_SEPARATOR 0xFF
+#define PSF2_START_SEQUENCE 0xFE
+
+// PC Screen Font version 2 header
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t header_size;
+    uint32_t flags;
+    uint32_t glyph_count;
+    uint32_t bytes_per_glyph;
+    uint32_t height;
+    uint32_t width;
+} __attribute__((packed)) psf2_header_t;
+
+#define LATIN1_GLYPH_BYTES (FONT_MAX_GLYPH_HEIGHT * (FONT_MAX_GLYPH_WIDTH / 8))
+
+static font_info_t fonts[MAX_LOADED_FONTS];
+static size_t loaded_font_count = 0;
+
+// Latin-1 glyph bitmaps repacked from the PSF2 files, built once at load time
+static uint8_t latin1_glyphs[MAX_LOADED_FONTS][LATIN1_GLYPH_COUNT * LATIN1_GLYPH_BYTES];
+
+static font_info_t *font_add(const char *name, const uint8_t *glyphs, uint8_t first_char, uint16_t glyph_count,
+                             uint8_t width, uint8_t height, uint8_t bytes_per_row) {
+    if (loaded_font_count >= MAX_LOADED_FONTS) {
+        return NULL;
+    }
+    
+    int32_t id = gpu_font_register(glyphs, first_char, glyph_count, width, height, bytes_per_row);
+    if (id < 0) {
+        return NULL;
+    }
+    
+    font_info_t *font = &fonts[loaded_font_count++];
+    strncpy(font->name, name, sizeof(font->name) - 1);
+    font->name[sizeof(font->name) - 1] = '\0';
+    font->id = id;
+    font->width = width;
+    font->height = height;
+    font->bytes_per_row = bytes_per_row;
+    font->first_char = first_char;
+    font->glyph_count = glyph_count;
+    font->glyphs = glyphs;
+    
+    // Expand the glyph masks for the scales the terminal and WM draw at now,
+    // rather than on the first string
+    gpu_font_prepare(id, 1);
+    if (height <= 16) {
+        gpu_font_prepare(id, 2);
+    }
+    return font;
+}
+
+// Decode one UTF-8 code point, advancing *p. Returns 0xFFFFFFFF on a bad sequence.
+static uint32_t utf8_decode(const uint8_t **p, const uint8_t *end) {
+    const uint8_t *s = *p;
+    uint32_t cp;
+    int extra;
+    
+    if (s[0] < 0x80) {
+        cp = s[0];
+        extra = 0;
+    } else if ((s[0] & 0xE0) == 0xC0) {
+        cp = s[0] & 0x1F;
+        extra = 1;
+    } else if ((s[0] & 0xF0) == 0xE0) {
+        cp = s[0] & 0x0F;
+        extra = 2;
+    } else if ((s[0] & 0xF8) == 0xF0) {
+        cp = s[0] & 0x07;
+        extra = 3;
+    } else {
+        *p = s + 1;
+        return 0xFFFFFFFF;
+    }
+    
+    if (s + 1 + extra > end) {
+        *p = end;
+        return 0xFFFFFFFF;
+    }
+    for (int i = 1; i <= extra; i++) {
+        cp = (cp << 6) | (s[i] & 0x3F);
+    }
+    *p = s + 1 + extra;
+    return cp;
+}
+
+const font_info_t *font_load_psf2(const char *name, const void *data, size_t size) {
+    const psf2_header_t *header = (const psf2_header_t *)data;
+    if (data == NULL || size < sizeof(psf2_header_t) || header->magic != PSF2_MAGIC) {
+        return NULL;
+    }
+    
+    uint32_t bytes_per_row = (header->width + 7) / 8;
+    if (header->width == 0 || header->width > FONT_MAX_GLYPH_WIDTH ||
+        header->height == 0 || header->height > FONT_MAX_GLYPH_HEIGHT ||
+        header->bytes_per_glyph != header->height * bytes_per_row ||
+        header->header_size > size ||
+        (size - header->header_size) / header->bytes_per_glyph < header->glyph_count) {
+        return NULL;
+    }
+    
+    const uint8_t *bitmaps = (const uint8_t *)data + header->header_size;
+    const uint8_t *table = bitmaps + (size_t)header->glyph_count * header->bytes_per_glyph;
+    const uint8_t *end = (const uint8_t *)data + size;
+    
+    // Map each Latin-1 code point to a glyph index. Without a Unicode table
+    // the glyphs are in code point order.
+    int32_t glyph_for[256];
+    for (int i = 0; i < 256; i++) {
+        glyph_for[i] = (header->flags & PSF2_HAS_UNICODE_TABLE) == 0 && (uint32_t)i < header->glyph_count ? i : -1;
+    }
+    
+    if (header->flags & PSF2_HAS_UNICODE_TABLE) {
+        const uint8_t *p = table;
+        for (uint32_t glyph = 0; glyph < header->glyph_count && p < end; glyph++) {
+            bool in_sequence = false;
+            while (p < end && *p != PSF2_SEPARATOR) {
+                if (*p == PSF2_START_SEQUENCE) {
+                    // Combining sequences cannot be single Latin-1 characters
+                    in_sequence = true;
+                    p++;
+                    continue;
+                }
+                uint32_t cp = utf8_decode(&p, end);
+                if (!in_sequence && cp < 256 && glyph_for[cp] < 0) {
+                    glyph_for[cp] = (int32_t)glyph;
+                }
+            }
+            p++;
+        }
+    }
+    
+    // Repack the covered characters into one contiguous table so the text
+    // engine indexes glyphs directly by character code
+    if (loaded_font_count >= MAX_LOADED_FONTS) {
+        return NULL;
+    }
+    uint8_t *packed = latin1_glyphs[loaded_font_count];
+    memset(packed, 0, LATIN1_GLYPH_COUNT * header->bytes_per_glyph);
+    for (int c = LATIN1_FIRST_CHAR; c < 256; c++) {
+        if (glyph_for[c] >= 0) {
+            memcpy(packed + (size_t)(c - LATIN1_FIRST_CHAR) * header->bytes_per_glyph,
+                   bitmaps + (size_t)glyph_for[c] * header->bytes_per_glyph,
+                   header->bytes_per_glyph);
+        }
+    }
+    
+    return font_add(name, packed, LATIN1_FIRST_CHAR, LATIN1_GLYPH_COUNT,
+                    (uint8_t)header->width, (uint8_t)header->height, (uint8_t)bytes_per_row);
+}
+
+// Font name from a module path: the file name without its extension
+static void font_name_from_path(const char *path, char *name, size_t name_size) {
+    const char *base = path;
+    for (const char *p = path; *p; p++) {
+        if (*p == '/') {
+            base = p + 1;
+        }
+    }
+    
+    size_t i = 0;
+    while (base[i] && base[i] != '.' && i + 1 < name_size) {
+        name[i] = base[i];
+        i++;
+    }
+    name[i] = '\0';
+}
+
+void font_init(void) {
+    if (loaded_font_count > 0) {
+        return;
+    }
+    
+    // The built-in font is always font 0, the system font
+    font_add("builtin", font_8x8[FONT_FIRST_CHAR], FONT_FIRST_CHAR, FONT_GLYPH_COUNT,
+             FONT_WIDTH, FONT_HEIGHT, 1);
+    
+    struct limine_module_response *response = module_request.response;
+    if (response == NULL) {
+        return;
+    }
+    
+    for (uint64_t i = 0; i < response->module_count; i++) {
+        struct limine_file *module = response->modules[i];
+        char name[32];
+        font_name_from_path(module->path, name, sizeof(name));
+        // Modules that are not PSF2 fonts are ignored here
+        font_load_psf2(name, module->address, module->size);
+    }
+}
+
+size_t font_count(void) {
+    return loaded_font_count;
+}
+
+const font_info_t *font_get(size_t index) {
+    return index < loaded_font_count ? &fonts[index] : NULL;
+}
+
+const font_info_t *font_find(const char *name) {
+    for (size_t i = 0; i < loaded_font_count; i++) {
+        if (strcmp(fonts[i].name, name) == 0) {
+            return &fonts[i];
+        }
+    }
+    return NULL;
+}
+
+const uint8_t *font_glyph(const font_info_t *font, unsigned char c) {
+    if (c < font->first_char || c >= font->first_char + font->glyph_count) {
+        return NULL;
+    }
+    return font->glyphs + (size_t)(c - font->first_char) * font->height * font->bytes_per_row;
+}
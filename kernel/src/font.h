@@ -2,12 +2,51 @@
 #define FONT_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
 
 // Font dimensions
 #define FONT_WIDTH 8
 #define FONT_HEIGHT 8
 
+// Printable ASCII range covered by font_8x8 (registered as the system font)
+#define FONT_FIRST_CHAR 32
+#define FONT_GLYPH_COUNT 95
+
 // External declaration of the 8x8 bitmap font
 extern const uint8_t font_8x8[][8];
 
-#endif // FONT_H 
\ No newline at end of file
+// Fonts loaded from PSF2 boot modules are remapped to Latin-1
+#define MAX_LOADED_FONTS 8
+#define FONT_MAX_GLYPH_WIDTH 32
+#define FONT_MAX_GLYPH_HEIGHT 32
+#define LATIN1_FIRST_CHAR 32
+#define LATIN1_GLYPH_COUNT 224  // 0x20-0xFF
+
+// A font registered with the text engine
+typedef struct {
+    char name[32];
+    int32_t id;              // Text engine font id
+    uint8_t width;
+    uint8_t height;
+    uint8_t bytes_per_row;
+    uint8_t first_char;
+    uint16_t glyph_count;
+    const uint8_t *glyphs;   // Packed bitmaps, one per character from first_char
+} font_info_t;
+
+// Register the built-in font and load any PSF2 fonts passed as boot modules
+void font_init(void);
+
+// Parse a PSF2 font and register it under name. Returns NULL on failure.
+const font_info_t *font_load_psf2(const char *name, const void *data, size_t size);
+
+// Registered fonts; index 0 is the built-in 8x8 font
+size_t font_count(void);
+const font_info_t *font_get(size_t index);
+const font_info_t *font_find(const char *name);
+
+// Bitmap of a character, or NULL if the font does not cover it
+const uint8_t *font_glyph(const font_info_t *font, unsigned char c);
+
+#endif // FONT_H
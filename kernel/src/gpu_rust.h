@@ -11,12 +11,51 @@ typedef struct {
     uint32_t data[16];
 } gpu_command_t;
 
+// Framebuffer pixel formats (must match Rust definitions)
+#define PIXEL_FORMAT_XRGB8888    0  // 32 bpp, R:16 G:8 B:0 (canonical)
+#define PIXEL_FORMAT_XBGR8888    1  // 32 bpp, R:0 G:8 B:16
+#define PIXEL_FORMAT_RGB888      2  // 24 bpp packed, R:16 G:8 B:0
+#define PIXEL_FORMAT_BGR888      3  // 24 bpp packed, R:0 G:8 B:16
+#define PIXEL_FORMAT_RGB565      4  // 16 bpp, R:11 G:5 B:0
+#define PIXEL_FORMAT_XRGB2101010 5  // 32 bpp, 10 bits per channel
+#define PIXEL_FORMAT_GENERIC     6  // Any other layout, packed through the masks
+
+// Pixel format descriptor (must match Rust definition)
+typedef struct {
+    uint32_t kind;
+    uint32_t bytes_per_pixel;
+    uint8_t red_size;
+    uint8_t red_shift;
+    uint8_t green_size;
+    uint8_t green_shift;
+    uint8_t blue_size;
+    uint8_t blue_shift;
+} gpu_pixel_format_t;
+
+// Text drawing flags
+#define GPU_TEXT_OPAQUE 1  // Fill unset glyph pixels with the background colour
+
+// Text destination: a 32-bit buffer and the rectangle text is clipped to
+// (must match Rust definition)
+typedef struct {
+    uint32_t *buffer;
+    uint32_t pitch;        // In pixels
+    int32_t clip_x;
+    int32_t clip_y;
+    uint32_t clip_width;
+    uint32_t clip_height;
+} gpu_text_target_t;
+
 // Initialize GPU rendering context
 void gpu_init(void *framebuffer, uint32_t width, uint32_t height, uint32_t pitch);
 
 // Check if GPU is available
 bool gpu_is_available(void);
 
+// Blit size in bytes from which non-temporal stores are used (chosen at boot)
+// Returns 0xFFFFFFFF when streaming stores are disabled
+uint32_t gpu_get_stream_threshold(void);
+
 // GPU-accelerated blitting
 void gpu_blit(
     uint32_t *dst,
@@ -27,6 +66,20 @@ void gpu_blit(
     uint32_t height
 );
 
+// Blit with non-temporal stores and no fence; for flushes that decide once
+// from their total size. Call gpu_stream_fence() after the last one.
+void gpu_blit_stream(
+    uint32_t *dst,
+    uint32_t dst_pitch,
+    const uint32_t *src,
+    uint32_t src_pitch,
+    uint32_t width,
+    uint32_t height
+);
+
+// Order all gpu_blit_stream() stores before anything that follows
+void gpu_stream_fence(void);
+
 // GPU-accelerated fill rectangle
 void gpu_fill_rect(
     uint32_t *buffer,
@@ -73,6 +126,72 @@ bool gpu_render_to_framebuffer(
     int32_t dst_y
 );
 
+// Describe a framebuffer pixel format from its bpp and channel masks
+gpu_pixel_format_t gpu_describe_pixel_format(
+    uint16_t bpp,
+    uint8_t red_size,
+    uint8_t red_shift,
+    uint8_t green_size,
+    uint8_t green_shift,
+    uint8_t blue_size,
+    uint8_t blue_shift
+);
+
+// Convert an XRGB8888 colour into the native pixel value of a format
+uint32_t gpu_pack_pixel(uint32_t color, const gpu_pixel_format_t *format);
+
+// Horizontally upscale a row by an integer factor (dst holds width * scale pixels)
+void gpu_scale_row(uint32_t *dst, const uint32_t *src, uint32_t width, uint32_t scale);
+
+// Box-filter downscale by an integer factor (1-16): dst gets (src_width / factor) x
+// (src_height / factor) pixels. Pitches in pixels. Returns false on bad arguments.
+bool gpu_downscale_box(uint32_t *dst, uint32_t dst_pitch, const uint32_t *src,
+                       uint32_t src_width, uint32_t src_height, uint32_t src_pitch, uint32_t factor);
+
+// Blit XRGB8888 pixels into a framebuffer of any supported format
+// (dst_pitch in bytes, src_pitch in pixels)
+void gpu_convert_blit(
+    uint8_t *dst,
+    uint32_t dst_pitch,
+    const uint32_t *src,
+    uint32_t src_pitch,
+    uint32_t width,
+    uint32_t height,
+    const gpu_pixel_format_t *format
+);
+
+// Register a bitmap font (height rows of bytes_per_row bytes per glyph, MSB
+// leftmost). Returns the font id, or -1 on failure. Font 0 is the system font.
+int32_t gpu_font_register(
+    const uint8_t *glyphs,
+    uint32_t first_char,
+    uint32_t glyph_count,
+    uint32_t width,
+    uint32_t height,
+    uint32_t bytes_per_row
+);
+
+// Expand a font's glyph masks for a scale now instead of on first use
+bool gpu_font_prepare(int32_t font, uint32_t scale);
+
+// Character cell size of a font at scale 1
+bool gpu_font_get_size(int32_t font, uint32_t *width, uint32_t *height);
+
+// Draw len bytes of text at (x, y) from cached glyph masks; colours are native
+// pixel values. Returns the horizontal advance in pixels.
+uint32_t gpu_draw_text(
+    const gpu_text_target_t *target,
+    int32_t x,
+    int32_t y,
+    const char *text,
+    uint32_t len,
+    int32_t font,
+    uint32_t scale,
+    uint32_t color,
+    uint32_t background,
+    uint32_t flags
+);
+
 // GPU command queue
 bool gpu_submit_command(const gpu_command_t *cmd);
 void gpu_process_commands(void);
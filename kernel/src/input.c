@@ -0,0 +1,129 @@
+#include "input.h"
+#include "keyboard.h"
+#include "mouse.h"
+#include "tsc.h"
+#include "window_manager_rust.h"
+
+// PS/2 controller
+#define PS2_DATA_PORT            0x60
+#define PS2_STATUS_PORT          0x64
+#define PS2_STATUS_OUTPUT_FULL   0x01
+#define PS2_STATUS_AUXILIARY     0x20
+
+// Bytes read per input_poll() call, so a chattering device can't stall the caller
+#define INPUT_POLL_BUDGET 64
+
+// Frames when the TSC is not calibrated: every N polls with nothing pending
+#define INPUT_IDLE_FRAME_POLLS 1000
+
+// Single-producer/single-consumer ring (everything runs on one CPU, polled)
+static input_event_t queue[INPUT_QUEUE_SIZE];
+static uint32_t queue_head = 0;  // Next event to pop
+static uint32_t queue_tail = 0;  // Next free slot
+static uint32_t keys_pending = 0;
+
+static input_stats_t stats = {0};
+
+static uint64_t last_frame_tsc = 0;
+static uint32_t idle_polls = 0;
+
+bool input_push(input_event_t *event) {
+    event->timestamp = tsc_read();
+    
+    // Motion coalescing: if the newest queued event is an unconsumed motion
+    // with the same buttons, move it instead of queueing another one
+    if (event->type == INPUT_EVENT_MOTION && queue_tail != queue_head) {
+        input_event_t *last = &queue[(queue_tail - 1) & (INPUT_QUEUE_SIZE - 1)];
+        if (last->type == INPUT_EVENT_MOTION && last->buttons == event->buttons) {
+            last->x = event->x;
+            last->y = event->y;
+            last->timestamp = event->timestamp;
+            stats.coalesced++;
+            return true;
+        }
+    }
+    
+    if (queue_tail - queue_head >= INPUT_QUEUE_SIZE) {
+        stats.dropped++;
+        return false;
+    }
+    
+    queue[queue_tail & (INPUT_QUEUE_SIZE - 1)] = *event;
+    queue_tail++;
+    if (event->type == INPUT_EVENT_KEY) {
+        keys_pending++;
+    }
+    
+    stats.queued++;
+    if (queue_tail - queue_head > stats.max_depth) {
+        stats.max_depth = queue_tail - queue_head;
+    }
+    return true;
+}
+
+bool input_pop(input_event_t *event) {
+    if (queue_head == queue_tail) {
+        return false;
+    }
+    *event = queue[queue_head & (INPUT_QUEUE_SIZE - 1)];
+    queue_head++;
+    if (event->type == INPUT_EVENT_KEY) {
+        keys_pending--;
+    }
+    return true;
+}
+
+uint32_t input_pending(void) {
+    return queue_tail - queue_head;
+}
+
+bool input_key_pending(void) {
+    return keys_pending > 0;
+}
+
+void input_poll(void) {
+    for (int i = 0; i < INPUT_POLL_BUDGET; i++) {
+        uint8_t status = inb(PS2_STATUS_PORT);
+        if (!(status & PS2_STATUS_OUTPUT_FULL)) {
+            break;
+        }
+        
+        if (status & PS2_STATUS_AUXILIARY) {
+            // Mouse byte: the driver assembles packets and queues events
+            mouse_handle_interrupt();
+        } else {
+            keyboard_handle_scancode(inb(PS2_DATA_PORT));
+        }
+    }
+}
+
+bool input_frame_due(void) {
+    if (keys_pending > 0) {
+        last_frame_tsc = tsc_read();
+        return true;
+    }
+    
+    uint64_t hz = tsc_get_hz();
+    if (hz == 0) {
+        if (input_pending() > 0 || (++idle_polls >= INPUT_IDLE_FRAME_POLLS && wm_frame_pending())) {
+            idle_polls = 0;
+            return true;
+        }
+        return false;
+    }
+    
+    uint64_t now = tsc_read();
+    if (now - last_frame_tsc < hz / 1000000 * INPUT_FRAME_US) {
+        return false;
+    }
+    // Idle desktop: no frame until input arrives or an animation is running
+    if (input_pending() == 0 && !wm_frame_pending()) {
+        return false;
+    }
+    last_frame_tsc = now;
+    return true;
+}
+
+void input_get_stats(input_stats_t *out) {
+    *out = stats;
+}
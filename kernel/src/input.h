@@ -0,0 +1,58 @@
+#ifndef INPUT_H
+#define INPUT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Input event types
+#define INPUT_EVENT_KEY    1
+#define INPUT_EVENT_MOTION 2
+#define INPUT_EVENT_BUTTON 3
+#define INPUT_EVENT_WHEEL  4
+
+// Queue capacity (power of two)
+#define INPUT_QUEUE_SIZE 256
+
+// Minimum time between window manager frames when the TSC is calibrated
+#define INPUT_FRAME_US 16667
+
+// Input event (must match the Rust definition in wm_rust)
+typedef struct {
+    uint8_t type;        // INPUT_EVENT_*
+    uint8_t buttons;     // MOUSE_*_BUTTON state after this event
+    uint8_t key;         // ASCII character (KEY)
+    uint8_t scancode;    // Set 1 make code (KEY)
+    int32_t x;           // Pointer position in framebuffer pixels (MOTION, BUTTON)
+    int32_t y;
+    int32_t wheel;       // Wheel steps, positive = towards the user (WHEEL)
+    uint64_t timestamp;  // TSC when the event was queued
+} input_event_t;
+
+// Queue statistics
+typedef struct {
+    uint64_t queued;     // Events accepted
+    uint64_t coalesced;  // Motion events merged into a pending one
+    uint64_t dropped;    // Events lost to a full queue
+    uint32_t max_depth;  // Deepest the queue has been
+} input_stats_t;
+
+// Producers: device drivers queue events. Consecutive motion events are
+// merged while the consumer has not caught up.
+bool input_push(input_event_t *event);
+
+// Move everything the PS/2 controller has buffered into the queue
+void input_poll(void);
+
+// Consumer: the window manager drains the queue once per frame
+bool input_pop(input_event_t *event);
+uint32_t input_pending(void);
+bool input_key_pending(void);
+
+// True when a frame should run: a key is waiting, or INPUT_FRAME_US has
+// passed since the last frame and there are events or wm_frame_pending()
+// (polling-count paced if the TSC is uncalibrated)
+bool input_frame_due(void);
+
+void input_get_stats(input_stats_t *stats);
+
+#endif // INPUT_H
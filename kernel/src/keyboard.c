@@ -1,6 +1,11 @@
 #include "keyboard.h"
-#include "mouse.h"
 #include "window_manager_rust.h"
+#include "input.h"
+#include "logger.h"
+#include "trace.h"
+#include "profiler.h"
+#include "audio.h"
+#include "boottime.h"
 #include <stdbool.h>
 
 // PS/2 keyboard scancode to ASCII mapping (US layout)
@@ -12,10 +17,6 @@ static const char scancode_to_ascii[128] = {
     '*', 0, ' '
 };
 
-// PS/2 Status register bits
-#define PS2_STATUS_OUTPUT_FULL   0x01
-#define PS2_STATUS_AUXILIARY     0x20  // Bit 5: 1 = auxiliary device (mouse), 0 = keyboard
-
 // Port I/O functions
 uint8_t inb(uint16_t port) {
     uint8_t result;
@@ -27,51 +28,67 @@ void outb(uint16_t port, uint8_t data) {
     asm volatile("outb %0, %1" : : "a"(data), "Nd"(port));
 }
 
+// Characters handed back by the window manager after it drains the input
+// queue; read_key() consumes them
+#define KEY_BUFFER_SIZE 64
+static char key_buffer[KEY_BUFFER_SIZE];
+static uint32_t key_head = 0;
+static uint32_t key_tail = 0;
+
 // Initialize keyboard
 void keyboard_init(void) {
     // For now, we don't need special initialization
     // The PS/2 keyboard should be ready to use
 }
 
+// Translate a scancode from the PS/2 controller into a key event
+void keyboard_handle_scancode(uint8_t scancode) {
+    if (scancode >= 128) {
+        return; // Key release
+    }
+    
+    char c = scancode_to_ascii[scancode];
+    if (c == 0) {
+        return;
+    }
+    
+    input_event_t event = {0};
+    event.type = INPUT_EVENT_KEY;
+    event.key = (uint8_t)c;
+    event.scancode = scancode;
+    input_push(&event);
+}
+
+// Deliver a character to read_key() (called while the input queue is drained)
+void keyboard_deliver(char c) {
+    if (key_tail - key_head >= KEY_BUFFER_SIZE) {
+        return; // Nobody is reading, drop it
+    }
+    key_buffer[key_tail++ % KEY_BUFFER_SIZE] = c;
+}
+
 // Read keyboard input
 char read_key(void) {
-    static uint32_t update_counter = 0;
-    
     while (1) {
-        uint8_t status = inb(0x64);
-        if (status & PS2_STATUS_OUTPUT_FULL) {
-            // Check if this data is from the auxiliary device (mouse)
-            if (status & PS2_STATUS_AUXILIARY) {
-                // This is mouse data, handle it properly instead of discarding
-                mouse_handle_interrupt();
-                
-                // Always update window manager (handles cursor rendering)
-                mouse_state_t *mouse = mouse_get_state();
-                wm_handle_mouse(mouse->x, mouse->y, mouse->left_button);
-                wm_update();
-                
-                continue;   // Keep waiting for keyboard data
-            }
-            
-            // This is keyboard data
-            uint8_t scancode = inb(0x60);
-            if (scancode < 128) {
-                char c = scancode_to_ascii[scancode];
-                if (c != 0) {
-                    return c;
-                }
-            }
+        if (key_head != key_tail) {
+            return key_buffer[key_head++ % KEY_BUFFER_SIZE];
+        }
+        
+        // Gather device input; when a frame is due (or a key is waiting) the
+        // window manager drains the queue, handles pointer events once and
+        // delivers keys back here. This also keeps animating windows updating.
+        input_poll();
+        if (input_frame_due()) {
+            wm_update();
         } else {
-            // No input available - periodically update window manager
-            // This allows animating windows to update independently
-            update_counter++;
-            // Update more frequently to keep animations smooth (~60 FPS target)
-            // At high CPU speeds, 1000 iterations happens very quickly
-            if (update_counter >= 1000) {  // Update every ~1000 iterations for smoother animation
-                update_counter = 0;
-                extern void wm_update(void);
-                wm_update();
-            }
+            // Idle: format the log and trace records deferred so far, step
+            // the async sound and run any deferred init
+            wm_trace_flush();
+            logger_flush();
+            trace_flush();
+            profile_poll();
+            audio_poll();
+            boot_poll();
         }
     }
-} 
\ No newline at end of file
+}
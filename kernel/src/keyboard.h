@@ -6,6 +6,8 @@
 // Keyboard functions
 void keyboard_init(void);
 char read_key(void);
+void keyboard_handle_scancode(uint8_t scancode);
+void keyboard_deliver(char c);
 
 // Port I/O functions
 uint8_t inb(uint16_t port);
@@ -2,7 +2,15 @@
 #include "terminal.h"
 #include "string.h"
 #include "fs/filesystem.h"
+#include "tsc.h"
+#include "trace.h"
+#include "pmu.h"
+#include "virtio_console.h"
 #include <stdarg.h>
+#include <stddef.h>
+
+// Memory functions (defined in main.c)
+void *memset(void *s, int c, size_t n);
 
 // Log file path (using simple filename since filesystem doesn't support paths)
 #define LOG_FILE_PATH "system.log"
@@ -15,6 +23,19 @@
 #define SERIAL_LINE_CONTROL (SERIAL_PORT_BASE + 3)
 #define SERIAL_MODEM_CONTROL (SERIAL_PORT_BASE + 4)
 #define SERIAL_LINE_STATUS (SERIAL_PORT_BASE + 5)
+#define SERIAL_INTERRUPT_ID (SERIAL_PORT_BASE + 2)  // Read side of the FIFO control port
+
+#define SERIAL_LSR_THR_EMPTY 0x20
+#define SERIAL_LSR_TX_EMPTY  0x40  // Holding and shift registers both empty
+
+// Software transmit ring. serial_putchar() only queues; the UART is fed a
+// whole FIFO at a time whenever its holding register is empty.
+#define SERIAL_TX_RING_SIZE 16384  // Power of two
+
+static uint8_t serial_tx_ring[SERIAL_TX_RING_SIZE];
+static uint32_t serial_tx_head = 0;
+static uint32_t serial_tx_tail = 0;
+static uint32_t serial_fifo_depth = 1;  // Bytes the UART accepts once THRE is set
 
 // Port I/O functions
 static inline void outb(uint16_t port, uint8_t value) {
@@ -36,22 +57,56 @@ static void serial_init(void) {
     outb(SERIAL_LINE_CONTROL, 0x80); // Enable DLAB
     outb(SERIAL_DATA_PORT, 0x01);    // Low byte (115200 = 1)
     outb(SERIAL_DATA_PORT + 1, 0x00); // High byte
-    outb(SERIAL_LINE_CONTROL, 0x03);  // 8 bits, no parity, 1 stop bit
     
-    // Enable FIFO, clear buffers
-    outb(SERIAL_FIFO_CONTROL, 0xC7);
+    // Enable FIFO, clear buffers. Bit 5 asks a 16750 for its 64-byte FIFO
+    // and is only writable while DLAB is set.
+    outb(SERIAL_FIFO_CONTROL, 0xE7);
+    outb(SERIAL_LINE_CONTROL, 0x03);  // 8 bits, no parity, 1 stop bit
     
     // Enable DTR, RTS, and OUT2
     outb(SERIAL_MODEM_CONTROL, 0x0B);
+    
+    // IIR bits 7:6 report a working FIFO (16550A), bit 5 the 64-byte one
+    uint8_t iir = inb(SERIAL_INTERRUPT_ID);
+    if ((iir & 0xC0) != 0xC0) {
+        serial_fifo_depth = 1;   // 8250/16450, or the buggy 16550
+    } else if (iir & 0x20) {
+        serial_fifo_depth = 64;
+    } else {
+        serial_fifo_depth = 16;
+    }
 }
 
-// Write character to serial port
+// Move queued bytes into the UART. An empty holding register means the whole
+// FIFO is free, so up to serial_fifo_depth bytes go out without further polling.
+static void serial_tx_pump(void) {
+    if (serial_tx_tail == serial_tx_head) {
+        return;
+    }
+    if ((inb(SERIAL_LINE_STATUS) & SERIAL_LSR_THR_EMPTY) == 0) {
+        return;
+    }
+    
+    for (uint32_t i = 0; i < serial_fifo_depth && serial_tx_tail != serial_tx_head; i++) {
+        outb(SERIAL_DATA_PORT, serial_tx_ring[serial_tx_tail % SERIAL_TX_RING_SIZE]);
+        serial_tx_tail++;
+    }
+}
+
+// Queue a character for the serial port
 static void serial_putchar(char c) {
-    // Wait for transmit buffer to be empty
-    while ((inb(SERIAL_LINE_STATUS) & 0x20) == 0) {
-        // Busy wait
+    // Ring full: wait for the UART rather than lose output (or split a trace packet)
+    while (serial_tx_head - serial_tx_tail >= SERIAL_TX_RING_SIZE) {
+        serial_tx_pump();
+    }
+    serial_tx_ring[serial_tx_head % SERIAL_TX_RING_SIZE] = (uint8_t)c;
+    serial_tx_head++;
+    
+    // Keep the UART busy while a producer is running: top it up every 16 bytes
+    // queued, which costs one status read when it's still busy
+    if ((serial_tx_head % 16) == 0) {
+        serial_tx_pump();
     }
-    outb(SERIAL_DATA_PORT, c);
 }
 
 // Write string to serial port
@@ -164,285 +219,386 @@ static const char *get_level_string(log_level_t level) {
     }
 }
 
-void logger_log(log_level_t level, const char *module, const char *format, ...) {
-    // Check if we should log this message
-    if (level < current_log_level) {
-        return;
-    }
-    
-    // Build header
-    const char *level_str = get_level_string(level);
-    const char *module_str = module ? module : "UNKNOWN";
-    
-    // Output to terminal
-    terminal_print("[");
-    terminal_print(level_str);
-    terminal_print("] [");
-    terminal_print(module_str);
-    terminal_print("] ");
-    
-    // Output to serial port (for file logging)
-    serial_print("[");
-    serial_print(level_str);
-    serial_print("] [");
-    serial_print(module_str);
-    serial_print("] ");
-    
-    // Parse format string and arguments - output to both terminal and serial
-    va_list args;
-    va_start(args, format);
+// Log records
+//
+// logger_log() doesn't format or touch any device: it copies the format
+// pointer, the raw arguments and any %s strings into a record in the calling
+// CPU's ring and returns. logger_flush() later formats each record once and
+// writes the batch to serial, the terminal and system.log.
+//
+// Each ring has one producer (its CPU) and one consumer (the flusher), so
+// head and tail are plain atomics, no lock. Only the BSP runs kernel code
+// today (Limine parks the APs), so everything lands in ring 0.
+
+#define LOG_MAX_CPUS      8
+#define LOG_RING_SIZE     256   // Records per CPU (power of two)
+#define LOG_MAX_ARGS      6
+#define LOG_STRING_BYTES  96    // Room for copies of %s arguments
+#define LOG_LINE_SIZE     256
+#define LOG_FILE_MAX      1024  // system.log stops growing here
+
+typedef struct {
+    uint64_t tsc;
+    const char *module;
+    const char *format;                   // Must stay valid (string literal)
+    uint64_t args[LOG_MAX_ARGS];          // %s arguments hold an offset into strings
+    uint8_t level;
+    uint8_t arg_count;
+    uint16_t strings_used;
+    char strings[LOG_STRING_BYTES];
+} log_record_t;
+
+typedef struct {
+    uint32_t head;  // Written by the producing CPU
+    uint32_t tail;  // Written by the flusher
+    log_record_t records[LOG_RING_SIZE];
+} log_ring_t;
+
+static log_ring_t log_rings[LOG_MAX_CPUS];
+static bool log_flushing = false;
+static uint32_t log_dropped = 0;
+
+static inline uint32_t log_cpu_id(void) {
+    return 0;
+}
+
+// Capture the arguments a format consumes; strings are copied because the
+// caller's buffer may be gone by the time the record is flushed
+static void log_capture(log_record_t *rec, const char *format, va_list args) {
+    rec->arg_count = 0;
+    rec->strings_used = 0;
     
-    const char *p = format;
-    while (*p) {
-        if (*p == '%') {
-            p++;
-            switch (*p) {
-                case 's': {
-                    // String
-                    const char *str = va_arg(args, const char *);
-                    if (str) {
-                        terminal_print(str);
-                        serial_print(str);
-                    } else {
-                        terminal_print("(null)");
-                        serial_print("(null)");
-                    }
-                    break;
-                }
-                case 'd': {
-                    // Decimal integer
-                    int32_t val = va_arg(args, int32_t);
-                    char num_buf[32];
-                    if (val < 0) {
-                        terminal_print("-");
-                        serial_print("-");
-                        val = -val;
-                    }
-                    uint_to_string((uint64_t)val, num_buf, sizeof(num_buf));
-                    terminal_print(num_buf);
-                    serial_print(num_buf);
-                    break;
-                }
-                case 'u': {
-                    // Unsigned decimal
-                    uint32_t val = va_arg(args, uint32_t);
-                    char num_buf[32];
-                    uint_to_string(val, num_buf, sizeof(num_buf));
-                    terminal_print(num_buf);
-                    serial_print(num_buf);
-                    break;
-                }
-                case 'x': {
-                    // Hexadecimal (lowercase)
-                    uint32_t val = va_arg(args, uint32_t);
-                    char hex_buf[32];
-                    uint_to_hex_string(val, hex_buf, sizeof(hex_buf));
-                    terminal_print(hex_buf);
-                    serial_print(hex_buf);
-                    break;
+    for (const char *p = format; *p && rec->arg_count < LOG_MAX_ARGS; p++) {
+        if (*p != '%') {
+            continue;
+        }
+        p++;
+        
+        uint64_t value;
+        switch (*p) {
+            case 's': {
+                const char *str = va_arg(args, const char *);
+                if (!str) {
+                    str = "(null)";
                 }
-                case 'X': {
-                    // Hexadecimal (uppercase) - same as lowercase for now
-                    uint32_t val = va_arg(args, uint32_t);
-                    char hex_buf[32];
-                    uint_to_hex_string(val, hex_buf, sizeof(hex_buf));
-                    terminal_print(hex_buf);
-                    serial_print(hex_buf);
+                if (rec->strings_used >= LOG_STRING_BYTES) {
+                    // Full: the last byte is a terminator, share it as ""
+                    value = LOG_STRING_BYTES - 1;
                     break;
                 }
-                case 'p': {
-                    // Pointer
-                    void *ptr = va_arg(args, void *);
-                    char hex_buf[32];
-                    uint_to_hex_string((uint64_t)ptr, hex_buf, sizeof(hex_buf));
-                    terminal_print(hex_buf);
-                    serial_print(hex_buf);
-                    break;
+                value = rec->strings_used;
+                while (*str && rec->strings_used < LOG_STRING_BYTES - 1) {
+                    rec->strings[rec->strings_used++] = *str++;
                 }
-                case 'l': {
-                    // Check for 'ld' or 'lu' or 'lx'
+                rec->strings[rec->strings_used++] = '\0';
+                break;
+            }
+            case 'd':
+                value = (uint64_t)(int64_t)va_arg(args, int32_t);
+                break;
+            case 'u':
+            case 'x':
+            case 'X':
+                value = va_arg(args, uint32_t);
+                break;
+            case 'p':
+                value = (uint64_t)va_arg(args, void *);
+                break;
+            case 'l':
+                if (p[1] == 'd' || p[1] == 'u' || p[1] == 'x' || p[1] == 'X') {
                     p++;
-                    if (*p == 'd') {
-                        int64_t val = va_arg(args, int64_t);
-                        char num_buf[32];
-                        if (val < 0) {
-                            terminal_print("-");
-                            serial_print("-");
-                            val = -val;
-                        }
-                        uint_to_string((uint64_t)val, num_buf, sizeof(num_buf));
-                        terminal_print(num_buf);
-                        serial_print(num_buf);
-                    } else if (*p == 'u') {
-                        uint64_t val = va_arg(args, uint64_t);
-                        char num_buf[32];
-                        uint_to_string(val, num_buf, sizeof(num_buf));
-                        terminal_print(num_buf);
-                        serial_print(num_buf);
-                    } else if (*p == 'x' || *p == 'X') {
-                        uint64_t val = va_arg(args, uint64_t);
-                        char hex_buf[32];
-                        uint_to_hex_string(val, hex_buf, sizeof(hex_buf));
-                        terminal_print(hex_buf);
-                        serial_print(hex_buf);
-                    } else {
-                        // Unknown, just print the characters
-                        terminal_print("%l");
-                        serial_print("%l");
-                        p--;  // Back up to re-process
-                    }
-                    break;
-                }
-                case '%': {
-                    // Literal %
-                    terminal_print("%");
-                    serial_print("%");
+                    value = va_arg(args, uint64_t);
                     break;
                 }
-                default: {
-                    // Unknown format, print as-is
-                    terminal_print("%");
-                    serial_print("%");
-                    if (*p) {
-                        char c = *p;
-                        terminal_putchar(c);
-                        serial_putchar(c);
-                    }
-                    break;
+                continue;
+            case '\0':
+                return;
+            default:
+                continue;  // %% and unknown conversions take no argument
+        }
+        rec->args[rec->arg_count++] = value;
+    }
+}
+
+static void log_append(char *line, int *pos, const char *str) {
+    while (*str && *pos < LOG_LINE_SIZE - 2) {
+        line[(*pos)++] = *str++;
+    }
+}
+
+// Format a record as "[LEVEL] [MODULE] message\n"; returns the length
+static int log_format(const log_record_t *rec, char *line) {
+    int pos = 0;
+    char num_buf[32];
+    
+    log_append(line, &pos, "[");
+    log_append(line, &pos, get_level_string((log_level_t)rec->level));
+    log_append(line, &pos, "] [");
+    log_append(line, &pos, rec->module ? rec->module : "UNKNOWN");
+    log_append(line, &pos, "] ");
+    
+    uint32_t arg = 0;
+    for (const char *p = rec->format; *p && pos < LOG_LINE_SIZE - 2; p++) {
+        if (*p != '%') {
+            line[pos++] = *p;
+            continue;
+        }
+        p++;
+        if (*p == 'l' && (p[1] == 'd' || p[1] == 'u' || p[1] == 'x' || p[1] == 'X')) {
+            p++;
+        } else if (*p == 'l') {
+            log_append(line, &pos, "%l");
+            continue;
+        }
+        
+        bool takes_arg = *p == 's' || *p == 'd' || *p == 'u' || *p == 'x' || *p == 'X' || *p == 'p';
+        uint64_t value = 0;
+        if (takes_arg) {
+            if (arg >= rec->arg_count) {
+                break;  // More conversions than captured arguments
+            }
+            value = rec->args[arg++];
+        }
+        
+        switch (*p) {
+            case 's':
+                log_append(line, &pos, &rec->strings[value]);
+                break;
+            case 'd':
+                if ((int64_t)value < 0) {
+                    log_append(line, &pos, "-");
+                    value = (uint64_t)(-(int64_t)value);
                 }
+                uint_to_string(value, num_buf, sizeof(num_buf));
+                log_append(line, &pos, num_buf);
+                break;
+            case 'u':
+                uint_to_string(value, num_buf, sizeof(num_buf));
+                log_append(line, &pos, num_buf);
+                break;
+            case 'x':
+            case 'X':
+            case 'p':
+                uint_to_hex_string(value, num_buf, sizeof(num_buf));
+                log_append(line, &pos, num_buf);
+                break;
+            case '%':
+                log_append(line, &pos, "%");
+                break;
+            case '\0':
+                p--;
+                break;
+            default: {
+                char unknown[3] = { '%', *p, '\0' };
+                log_append(line, &pos, unknown);
+                break;
             }
-            p++;
-        } else {
-            terminal_putchar(*p);
-            serial_putchar(*p);
-            p++;
         }
     }
     
+    line[pos++] = '\n';
+    line[pos] = '\0';
+    return pos;
+}
+
+void logger_logv(log_level_t level, const char *module, const char *format, va_list args) {
+    // Check if we should log this message
+    if (level < current_log_level) {
+        return;
+    }
+    
+    log_ring_t *ring = &log_rings[log_cpu_id()];
+    uint32_t head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= LOG_RING_SIZE) {
+        // Full: drain synchronously rather than lose boot messages
+        // (a record logged while flushing is dropped instead)
+        if (log_flushing) {
+            log_dropped++;
+            return;
+        }
+        logger_flush();
+    }
+    
+    log_record_t *rec = &ring->records[head % LOG_RING_SIZE];
+    rec->tsc = tsc_read();
+    rec->module = module;
+    rec->format = format;
+    rec->level = (uint8_t)level;
+    log_capture(rec, format, args);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    
+    // Errors are rare and wanted right away
+    if (level >= LOG_ERROR) {
+        logger_flush();
+    }
+}
+
+void logger_log(log_level_t level, const char *module, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    logger_logv(level, module, format, args);
     va_end(args);
-    terminal_print("\n");
-    serial_print("\n");
-    
-    // Also write to log file (append mode) - in-memory filesystem
-    // Note: This is redundant since serial port already captures everything
-    // But keeping it for in-memory access via 'cat system.log'
-    if (log_file_initialized) {
-        // Build the log message by re-parsing (need to restart va_list)
-        va_list args2;
-        va_start(args2, format);
-        
-        char log_buffer[512];
-        int pos = 0;
-        
-        // Format: [LEVEL] [MODULE] message
-        const char *level_str = get_level_string(level);
-        const char *module_str = module ? module : "UNKNOWN";
-        
-        // Write header
-        log_buffer[pos++] = '[';
-        for (int i = 0; level_str[i] && pos < (int)sizeof(log_buffer) - 1; i++) {
-            log_buffer[pos++] = level_str[i];
+}
+
+// Append a batch of formatted lines to system.log (one read-modify-write)
+static void log_file_append(const char *batch, size_t length) {
+    static uint8_t file_buffer[LOG_FILE_MAX];
+    size_t existing_size = 0;
+    
+    if (!fs_read_file(LOG_FILE_PATH, file_buffer, &existing_size)) {
+        existing_size = 0;
+    }
+    if (existing_size + length > LOG_FILE_MAX) {
+        return;  // Full, as before: serial keeps the complete log
+    }
+    for (size_t i = 0; i < length; i++) {
+        file_buffer[existing_size + i] = (uint8_t)batch[i];
+    }
+    fs_write_file(LOG_FILE_PATH, file_buffer, existing_size + length);
+}
+
+// Capture and format one record as logger_logv and logger_flush would
+static int log_test_format(log_record_t *rec, char *line, const char *format, ...) {
+    rec->tsc = 0;
+    rec->module = "LOGTEST";
+    rec->format = format;
+    rec->level = LOG_INFO;
+    
+    va_list args;
+    va_start(args, format);
+    log_capture(rec, format, args);
+    va_end(args);
+    return log_format(rec, line);
+}
+
+bool logger_self_test(void) {
+    static const char long_string[] =
+        "0123456789abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    // Guard bytes after the line catch writes past LOG_LINE_SIZE
+    char line[LOG_LINE_SIZE + 16];
+    memset(line, 0x5a, sizeof(line));
+    log_record_t rec;
+    
+    // More %s text than the record holds: later strings come out empty
+    int length = log_test_format(&rec, line, "%s|%s|%s|%s", long_string, long_string,
+                                 long_string, long_string);
+    if (length <= 0 || length >= LOG_LINE_SIZE || line[length] != '\0' ||
+        rec.arg_count != 4 || rec.strings_used > LOG_STRING_BYTES) {
+        return false;
+    }
+    for (uint32_t i = 0; i < rec.arg_count; i++) {
+        if (rec.args[i] >= LOG_STRING_BYTES) {
+            return false;
         }
-        log_buffer[pos++] = ']';
-        log_buffer[pos++] = ' ';
-        log_buffer[pos++] = '[';
-        for (int i = 0; module_str[i] && pos < (int)sizeof(log_buffer) - 1; i++) {
-            log_buffer[pos++] = module_str[i];
+    }
+    
+    // An unknown conversion at every position up to the end of the line
+    static char format[LOG_LINE_SIZE + 8];
+    for (int padding = LOG_LINE_SIZE - 40; padding < LOG_LINE_SIZE; padding++) {
+        memset(format, 'a', (size_t)padding);
+        format[padding] = '%';
+        format[padding + 1] = 'q';
+        format[padding + 2] = '\0';
+        length = log_test_format(&rec, line, format);
+        if (length <= 0 || length >= LOG_LINE_SIZE || line[length - 1] != '\n') {
+            return false;
         }
-        log_buffer[pos++] = ']';
-        log_buffer[pos++] = ' ';
-        
-        // Re-parse format string to build the message
-        p = format;
-        p = format;
-        while (*p && pos < (int)sizeof(log_buffer) - 1) {
-            if (*p == '%') {
-                p++;
-                switch (*p) {
-                    case 's': {
-                        const char *str = va_arg(args2, const char *);
-                        if (str) {
-                            for (int i = 0; str[i] && pos < (int)sizeof(log_buffer) - 1; i++) {
-                                log_buffer[pos++] = str[i];
-                            }
-                        }
-                        break;
-                    }
-                    case 'd': {
-                        int32_t val = va_arg(args2, int32_t);
-                        char num_buf[32];
-                        if (val < 0) {
-                            if (pos < (int)sizeof(log_buffer) - 1) log_buffer[pos++] = '-';
-                            val = -val;
-                        }
-                        uint_to_string((uint64_t)val, num_buf, sizeof(num_buf));
-                        for (int i = 0; num_buf[i] && pos < (int)sizeof(log_buffer) - 1; i++) {
-                            log_buffer[pos++] = num_buf[i];
-                        }
-                        break;
-                    }
-                    case 'u': {
-                        uint32_t val = va_arg(args2, uint32_t);
-                        char num_buf[32];
-                        uint_to_string(val, num_buf, sizeof(num_buf));
-                        for (int i = 0; num_buf[i] && pos < (int)sizeof(log_buffer) - 1; i++) {
-                            log_buffer[pos++] = num_buf[i];
-                        }
-                        break;
-                    }
-                    case 'x':
-                    case 'X':
-                    case 'p': {
-                        uint32_t val = (uint32_t)va_arg(args2, uintptr_t);
-                        char hex_buf[32];
-                        uint_to_hex_string(val, hex_buf, sizeof(hex_buf));
-                        for (int i = 0; hex_buf[i] && pos < (int)sizeof(log_buffer) - 1; i++) {
-                            log_buffer[pos++] = hex_buf[i];
-                        }
-                        break;
-                    }
-                    default:
-                        if (pos < (int)sizeof(log_buffer) - 1) log_buffer[pos++] = '%';
-                        if (*p && pos < (int)sizeof(log_buffer) - 1) log_buffer[pos++] = *p;
-                        break;
-                }
-                if (*p) p++;
-            } else {
-                if (pos < (int)sizeof(log_buffer) - 1) {
-                    log_buffer[pos++] = *p;
-                }
-                p++;
+    }
+    
+    for (size_t i = LOG_LINE_SIZE; i < sizeof(line); i++) {
+        if (line[i] != 0x5a) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void logger_flush(void) {
+    if (log_flushing) {
+        return;
+    }
+    log_flushing = true;
+    
+    static char batch[LOG_FILE_MAX];
+    size_t batch_length = 0;
+    char line[LOG_LINE_SIZE];
+    uint32_t written = 0;
+    uint32_t perf_flush = PERF_SCOPE_ID("log_flush");
+    
+    while (1) {
+        // Oldest pending record across all CPUs
+        log_ring_t *oldest = NULL;
+        for (int cpu = 0; cpu < LOG_MAX_CPUS; cpu++) {
+            log_ring_t *ring = &log_rings[cpu];
+            uint32_t tail = ring->tail;
+            if (tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE)) {
+                continue;
+            }
+            if (!oldest || ring->records[tail % LOG_RING_SIZE].tsc <
+                           oldest->records[oldest->tail % LOG_RING_SIZE].tsc) {
+                oldest = ring;
             }
         }
-        va_end(args2);
-        
-        if (pos < (int)sizeof(log_buffer) - 1) {
-            log_buffer[pos++] = '\n';
+        if (!oldest) {
+            break;
+        }
+        if (written++ == 0) {
+            trace_begin(TRACE_LOG_FLUSH, 0);
+            perf_begin(perf_flush);
         }
-        log_buffer[pos] = '\0';
         
-        // Append to log file (read existing, append, write back)
-        uint8_t existing_buffer[1024];
-        size_t existing_size = 0;
+        int length = log_format(&oldest->records[oldest->tail % LOG_RING_SIZE], line);
+        __atomic_store_n(&oldest->tail, oldest->tail + 1, __ATOMIC_RELEASE);
         
-        if (fs_read_file(LOG_FILE_PATH, existing_buffer, &existing_size)) {
-            // Append new content
-            size_t total_size = existing_size + pos;
-            if (total_size < 1024) {
-                uint8_t combined_buffer[1024];
-                for (size_t i = 0; i < existing_size; i++) {
-                    combined_buffer[i] = existing_buffer[i];
-                }
-                for (int i = 0; i < pos; i++) {
-                    combined_buffer[existing_size + i] = log_buffer[i];
-                }
-                fs_write_file(LOG_FILE_PATH, combined_buffer, total_size);
+        if (!virtio_console_write(VIRTIO_CONSOLE_PORT_LOG, line, (uint32_t)length)) {
+            serial_print(line);
+        }
+        terminal_print(line);
+        
+        if (log_file_initialized) {
+            if (batch_length + (size_t)length > sizeof(batch)) {
+                log_file_append(batch, batch_length);
+                batch_length = 0;
+            }
+            for (int i = 0; i < length; i++) {
+                batch[batch_length++] = line[i];
             }
-        } else {
-            // File doesn't exist or is empty, just write the new content
-            fs_write_file(LOG_FILE_PATH, (const uint8_t*)log_buffer, pos);
         }
     }
+    
+    if (batch_length > 0) {
+        log_file_append(batch, batch_length);
+    }
+    if (written > 0) {
+        perf_end(perf_flush);
+        trace_end(TRACE_LOG_FLUSH, written);
+    }
+    
+    if (log_dropped > 0) {
+        char num_buf[32];
+        uint_to_string(log_dropped, num_buf, sizeof(num_buf));
+        log_dropped = 0;
+        serial_print("[WARN ] [LOG] dropped ");
+        serial_print(num_buf);
+        serial_print(" records logged during a flush\n");
+    }
+    
+    // Idle is when the UART gets most of its refills and virtio buffers go out
+    serial_tx_pump();
+    virtio_console_flush();
+    
+    log_flushing = false;
+}
+
+void logger_drain(void) {
+    logger_flush();
+    
+    // Spin on the UART until every queued byte has left the shift register
+    while (serial_tx_tail != serial_tx_head) {
+        serial_tx_pump();
+    }
+    while ((inb(SERIAL_LINE_STATUS) & SERIAL_LSR_TX_EMPTY) == 0) {
+    }
 }
 
 // Helper functions
@@ -463,3 +619,15 @@ void logger_print_ptr(void *ptr) {
     uint_to_hex_string((uint64_t)ptr, hex_buf, sizeof(hex_buf));
     terminal_print(hex_buf);
 }
+
+void logger_write_raw(const uint8_t *data, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        serial_putchar((char)data[i]);
+    }
+}
+
+void logger_write_port(uint32_t port, const uint8_t *data, uint32_t length) {
+    if (!virtio_console_write(port, data, length)) {
+        logger_write_raw(data, length);
+    }
+}
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdarg.h>
 
 // Log levels
 typedef enum {
@@ -22,8 +23,19 @@ void logger_set_level(log_level_t level);
 // Get current log level
 log_level_t logger_get_level(void);
 
-// Core logging functions
+// Core logging functions. Records are queued in a per-CPU ring (no formatting,
+// no device I/O) and written out by logger_flush(); errors flush immediately.
+// Supported conversions: %s %d %u %x %X %p %ld %lu %lx. Formats must be literals.
 void logger_log(log_level_t level, const char *module, const char *format, ...);
+void logger_logv(log_level_t level, const char *module, const char *format, va_list args);
+
+// Format queued records and write them to serial, the terminal and system.log,
+// then refill the UART FIFO. Called from the idle loop; cheap when nothing is pending.
+void logger_flush(void);
+
+// Flush, then busy-wait until the serial transmit ring and the UART are empty.
+// For shutdown: nothing is left queued when the CPU halts.
+void logger_drain(void);
 
 // Convenience macros
 #define LOG_DEBUG(module, ...) logger_log(LOG_DEBUG, module, __VA_ARGS__)
@@ -31,9 +43,22 @@ void logger_log(log_level_t level, const char *module, const char *format, ...);
 #define LOG_WARN(module, ...) logger_log(LOG_WARN, module, __VA_ARGS__)
 #define LOG_ERROR(module, ...) logger_log(LOG_ERROR, module, __VA_ARGS__)
 
+// Format records with overlong %s arguments and unknown conversions at the
+// end of the line; false if anything is written out of bounds
+bool logger_self_test(void);
+
 // Helper functions for formatting
 void logger_print_hex(uint64_t value);
 void logger_print_dec(uint64_t value);
 void logger_print_ptr(void *ptr);
 
+// Write raw bytes to the serial port (no newline translation, no log prefix)
+// Used for machine-readable output such as captured frames. Bytes are queued
+// in the serial transmit ring and sent as the UART FIFO drains.
+void logger_write_raw(const uint8_t *data, uint32_t length);
+
+// Same, on a virtio-console port (VIRTIO_CONSOLE_PORT_*) when the host has it
+// open, falling back to the serial port otherwise
+void logger_write_port(uint32_t port, const uint8_t *data, uint32_t length);
+
 #endif // LOGGER_H
@@ -15,6 +15,14 @@
 #include "pci.h"
 #include "gpu_rust.h"
 #include "commands/window_example.h"
+#include "display_server_rust.h"
+#include "tsc.h"
+#include "input.h"
+#include "trace.h"
+#include "profiler.h"
+#include "pmu.h"
+#include "boottime.h"
+#include "virtio_console.h"
 
 // Global framebuffer pointer for graphics3d system
 struct limine_framebuffer *g_framebuffer = NULL;
@@ -170,10 +178,23 @@ static void show_video_error(void) {
     audio_play_event(AUDIO_ERROR_BEEP);
 }
 
+// Deferred boot stage: the PS/2 mouse handshake busy-waits on the controller
+// (and times out without a mouse), so it runs from the idle loop
+static void mouse_start(void) {
+    mouse_init();
+    mouse_set_bounds(g_framebuffer->width, g_framebuffer->height);
+}
+
 // The following will be our kernel's entry point.
 // If renaming kmain() to something else, make sure to change the
 // linker script accordingly.
 void kmain(void) {
+    // Boot timeline starts at kernel entry
+    boot_timeline_start();
+
+    // Profiler stack walks stop at this frame
+    profile_set_stack_top(__builtin_frame_address(0));
+
     // Ensure the bootloader actually understands our base revision (see spec).
     if (LIMINE_BASE_REVISION_SUPPORTED == false) {
         // Early error - show message and halt
@@ -186,6 +207,7 @@ void kmain(void) {
         vga_write_string("DEA OS - Boot Error: Failed to initialize FPU\n");
         hcf();
     }
+    boot_stage("fpu_init");
 
     // Ensure we got a framebuffer.
     if (framebuffer_request.response == NULL
@@ -201,38 +223,64 @@ void kmain(void) {
     // Make framebuffer globally accessible for graphics3d commands
     g_framebuffer = framebuffer;
 
+    // Calibrate the TSC first: input frame pacing and profiling use it
+    tsc_calibrate();
+    boot_stage("tsc_calibrate");
+    
+    // Hardware counters for perf scopes (no-op without a PMU)
+    pmu_init();
+    boot_stage("pmu_init");
+    
     // Initialize subsystems in order
     terminal_init(framebuffer);
+    boot_stage("terminal_init");
     keyboard_init();
+    boot_stage("keyboard_init");
     
-    // Initialize mouse and set screen bounds
-    mouse_init();
-    mouse_set_bounds(framebuffer->width, framebuffer->height);
+    // The desktop doesn't need the mouse to draw; set it up once idle
+    boot_defer("mouse_init", mouse_start);
     
     // Initialize audio system
     audio_init();
+    boot_stage("audio_init");
     
-    // Success beep to indicate video is working
-    audio_play_event(AUDIO_STARTUP_SOUND);
+    // Success beep to indicate video is working (played from the idle loop)
+    audio_play_event_async(AUDIO_STARTUP_SOUND);
+    boot_stage("startup_sound");
     
     // Enumerate PCI devices (for GPU detection)
     pci_enumerate();
+    boot_stage("pci_enumerate");
+    
+    // Fast log/trace channel when QEMU provides virtio-serial; until then
+    // (and without it) everything goes to the UART
+    virtio_console_init();
+    boot_stage("virtio_console_init");
     
     // Initialize GPU rendering system
-    gpu_init(framebuffer->address, framebuffer->width, framebuffer->height, framebuffer->pitch / 4);
+    // (pitch is handed over in pixels; non-32 bpp modes are converted by the display server)
+    uint32_t fb_bytes_per_pixel = framebuffer->bpp >= 8 ? (framebuffer->bpp + 7) / 8 : 4;
+    gpu_init(framebuffer->address, framebuffer->width, framebuffer->height,
+             framebuffer->pitch / fb_bytes_per_pixel);
+    boot_stage("gpu_init");
     
     // Initialize display server (must be before window manager)
     extern void ds_init(struct limine_framebuffer *framebuffer);
     ds_init(framebuffer);
+    boot_stage("ds_init");
     
     // Initialize Rust window manager
     wm_init(framebuffer);
+    boot_stage("wm_init");
     
     // Initialize filesystem and process system
     fs_init();
+    boot_stage("fs_init");
     process_init();
+    boot_stage("process_init");
     
     shell_init();
+    boot_stage("shell_init");
     
     // Clear the screen
     clear_screen();
@@ -241,6 +289,17 @@ void kmain(void) {
     // Initialize logger
     logger_init();
     logger_set_level(LOG_DEBUG);  // Enable debug logging
+    boot_stage("clear_screen+logger_init");
+    
+#ifdef HEADLESS_CAPTURE
+    // Headless build: render offscreen and stream captured frames over serial
+    ds_capture_start(HEADLESS_CAPTURE, true, tsc_get_hz());
+#endif
+    
+#ifdef TRACE_CAPTURE
+    // Trace build: stream binary events over serial (decode with tools/tracedecode)
+    trace_start(tsc_get_hz());
+#endif
     
     terminal_print("DEA OS - Boot Successful!\n");
     terminal_print("Video: ");
@@ -300,20 +359,25 @@ void kmain(void) {
 
     // Create windows directly instead of starting shell
     run_window_examples();
+    boot_stage("window_examples");
+    
+    // Desktop is up: deferred stages run from the idle loop, then the timeline is logged
+    boot_timeline_finish();
     
-    // Simple loop to handle mouse events and window manager updates
+    // Simple loop: gather input and run a window manager frame when one is
+    // due; idle iterations run deferred init and sound and write out the
+    // deferred log and trace records
     while (1) {
-        // Check for mouse events
-        if (mouse_has_data()) {
-            mouse_handle_interrupt();
+        input_poll();
+        if (input_frame_due()) {
+            wm_update();
+        } else {
+            wm_trace_flush();
+            logger_flush();
+            trace_flush();
+            profile_poll();
+            audio_poll();
+            boot_poll();
         }
-        
-        // Handle window manager mouse and update
-        extern void wm_handle_mouse(int mouse_x, int mouse_y, bool left_button);
-        extern void wm_update(void);
-        
-        mouse_state_t *mouse = mouse_get_state();
-        wm_handle_mouse(mouse->x, mouse->y, mouse->left_button);
-        wm_update();
     }
 }
@@ -2,6 +2,7 @@
 #include "keyboard.h" // For inb/outb functions
 
 #include "terminal.h" // For debug output
+#include "input.h"
 
 // PS/2 Controller ports
 #define PS2_DATA_PORT    0x60
@@ -23,9 +24,10 @@
 static mouse_state_t mouse_state = {0};
 static int max_x = 1024, max_y = 768;  // Default screen bounds
 
-// Packet handling
-static uint8_t packet_buffer[3];
+// Packet handling (4-byte packets once the IntelliMouse wheel is enabled)
+static uint8_t packet_buffer[4];
 static int packet_byte = 0;
+static int packet_size = 3;
 static bool packet_ready = false;
 
 // Wait for PS/2 controller to be ready for input (with timeout)
@@ -146,6 +148,23 @@ void mouse_init(void) {
         return;
     }
     
+    // IntelliMouse wheel: the sample rate sequence 200, 100, 80 switches a
+    // wheel mouse to 4-byte packets, which it reports as device ID 3.
+    // Plain mice ignore it and keep sending 3-byte packets.
+    static const uint8_t wheel_rates[] = {200, 100, 80};
+    for (int i = 0; i < 3; i++) {
+        if (mouse_send_command(MOUSE_CMD_SET_SAMPLE_RATE)) {
+            mouse_read_data(&response);
+        }
+        if (mouse_send_command(wheel_rates[i])) {
+            mouse_read_data(&response);
+        }
+    }
+    if (mouse_send_command(MOUSE_CMD_GET_DEVICE_ID) && mouse_read_data(&response) &&
+        response == MOUSE_ACK && mouse_read_data(&response) && response == 3) {
+        packet_size = 4;
+    }
+    
     // Enable data reporting
     if (!mouse_send_command(MOUSE_CMD_ENABLE_DATA_REPORTING)) {
         // Failed to enable data reporting, mouse will not work
@@ -167,8 +186,14 @@ bool mouse_has_data(void) {
     return (status & PS2_STATUS_OUTPUT_FULL) && (status & PS2_STATUS_AUXILIARY);
 }
 
-// Process a complete mouse packet
+// Process a complete mouse packet and queue the resulting input events
 void mouse_process_packet(mouse_packet_t* packet) {
+    int old_x = mouse_state.x;
+    int old_y = mouse_state.y;
+    uint8_t old_buttons = (mouse_state.left_button ? MOUSE_LEFT_BUTTON : 0) |
+                          (mouse_state.right_button ? MOUSE_RIGHT_BUTTON : 0) |
+                          (mouse_state.middle_button ? MOUSE_MIDDLE_BUTTON : 0);
+    
     // Extract button states
     mouse_state.left_button = (packet->flags & MOUSE_LEFT_BUTTON) != 0;
     mouse_state.right_button = (packet->flags & MOUSE_RIGHT_BUTTON) != 0;
@@ -204,6 +229,26 @@ void mouse_process_packet(mouse_packet_t* packet) {
         if (mouse_state.y < 0) mouse_state.y = 0;
         if (mouse_state.y >= max_y) mouse_state.y = max_y - 1;
     }
+    
+    // Motion first, so a click lands where the pointer ended up
+    input_event_t event = {0};
+    event.buttons = packet->flags & (MOUSE_LEFT_BUTTON | MOUSE_RIGHT_BUTTON | MOUSE_MIDDLE_BUTTON);
+    event.x = mouse_state.x;
+    event.y = mouse_state.y;
+    
+    if (mouse_state.x != old_x || mouse_state.y != old_y) {
+        event.type = INPUT_EVENT_MOTION;
+        input_push(&event);
+    }
+    if (event.buttons != old_buttons) {
+        event.type = INPUT_EVENT_BUTTON;
+        input_push(&event);
+    }
+    if (packet->z_movement != 0) {
+        event.type = INPUT_EVENT_WHEEL;
+        event.wheel = packet->z_movement;
+        input_push(&event);
+    }
 }
 
 // Handle mouse interrupt (should be called from interrupt handler)
@@ -227,12 +272,13 @@ void mouse_handle_interrupt(void) {
     } else {
         packet_buffer[packet_byte++] = data;
         
-        if (packet_byte >= 3) {
+        if (packet_byte >= packet_size) {
             // Complete packet received
             mouse_packet_t packet;
             packet.flags = packet_buffer[0];
             packet.x_movement = packet_buffer[1];
             packet.y_movement = packet_buffer[2];
+            packet.z_movement = packet_size == 4 ? (int8_t)packet_buffer[3] : 0;
             
             mouse_process_packet(&packet);
             
@@ -21,11 +21,12 @@
 #define MOUSE_RIGHT_BUTTON  0x02
 #define MOUSE_MIDDLE_BUTTON 0x04
 
-// Mouse packet structure (3 bytes for standard PS/2 mouse)
+// Mouse packet structure (3 bytes for standard PS/2 mouse, 4 with a wheel)
 typedef struct {
     uint8_t flags;      // Button states and movement flags
     uint8_t x_movement; // X movement delta
     uint8_t y_movement; // Y movement delta
+    int8_t z_movement;  // Wheel delta (0 without a wheel)
 } mouse_packet_t;
 
 // Mouse state structure
@@ -8,6 +8,11 @@
 // Maximum number of PCI devices to track
 #define MAX_PCI_DEVICES 32
 
+// PCI-to-PCI bridge: class 0x06, subclass 0x04; secondary bus in byte 1 of 0x18
+#define PCI_CLASS_BRIDGE        0x06
+#define PCI_SUBCLASS_PCI_BRIDGE 0x04
+#define PCI_CONFIG_BUS_NUMBERS  0x18
+
 // Static array to store discovered PCI devices
 static struct pci_device pci_devices[MAX_PCI_DEVICES];
 static int pci_device_count = 0;
@@ -45,79 +50,79 @@ bool pci_device_exists(uint8_t bus, uint8_t device, uint8_t function) {
     return (vendor_id & 0xFFFF) != 0xFFFF;
 }
 
-// Enumerate all PCI devices
-void pci_enumerate(void) {
-    pci_device_count = 0;
+static void pci_scan_bus(uint8_t bus);
+
+// Record one function and descend into it if it is a PCI-to-PCI bridge
+static void pci_scan_function(uint8_t bus, uint8_t device, uint8_t function) {
+    uint32_t vendor_device = pci_read_config(bus, device, function, PCI_CONFIG_VENDOR_ID);
     
-    // Scan all buses (0-255), devices (0-31), and functions (0-7)
-    for (int bus = 0; bus < 256; bus++) {
-        for (uint8_t device = 0; device < 32; device++) {
-            // Check if device exists
-            if (!pci_device_exists(bus, device, 0)) {
-                continue;
-            }
-            
-            // Read device information
-            uint32_t vendor_device = pci_read_config(bus, device, 0, PCI_CONFIG_VENDOR_ID);
-            uint16_t vendor_id = vendor_device & 0xFFFF;
-            uint16_t device_id = (vendor_device >> 16) & 0xFFFF;
-            
-            uint32_t class_reg = pci_read_config(bus, device, 0, PCI_CONFIG_CLASS_CODE);
-            uint8_t class_code = (class_reg >> 16) & 0xFF;
-            uint8_t subclass = (class_reg >> 24) & 0xFF;
-            
-            uint8_t header_type = (pci_read_config(bus, device, 0, PCI_CONFIG_HEADER_TYPE) >> 16) & 0xFF;
-            
-            // Store device if we have space
-            if (pci_device_count < MAX_PCI_DEVICES) {
-                struct pci_device *dev = &pci_devices[pci_device_count];
-                dev->bus = bus;
-                dev->device = device;
-                dev->function = 0;
-                dev->vendor_id = vendor_id;
-                dev->device_id = device_id;
-                dev->class_code = class_code;
-                dev->subclass = subclass;
-                dev->bar0 = pci_read_config(bus, device, 0, PCI_CONFIG_BAR0);
-                dev->is_vga = (class_code == PCI_CLASS_DISPLAY && subclass == 0x00);
-                
-                pci_device_count++;
-            }
-            
-            // Check for multi-function devices
-            if ((header_type & 0x80) != 0) {
-                // Multi-function device - check other functions
-                for (uint8_t function = 1; function < 8; function++) {
-                    if (pci_device_exists(bus, device, function)) {
-                        vendor_device = pci_read_config(bus, device, function, PCI_CONFIG_VENDOR_ID);
-                        vendor_id = vendor_device & 0xFFFF;
-                        device_id = (vendor_device >> 16) & 0xFFFF;
-                        
-                        class_reg = pci_read_config(bus, device, function, PCI_CONFIG_CLASS_CODE);
-                        class_code = (class_reg >> 16) & 0xFF;
-                        subclass = (class_reg >> 24) & 0xFF;
-                        
-                        if (pci_device_count < MAX_PCI_DEVICES) {
-                            struct pci_device *dev = &pci_devices[pci_device_count];
-                            dev->bus = bus;
-                            dev->device = device;
-                            dev->function = function;
-                            dev->vendor_id = vendor_id;
-                            dev->device_id = device_id;
-                            dev->class_code = class_code;
-                            dev->subclass = subclass;
-                            dev->bar0 = pci_read_config(bus, device, function, PCI_CONFIG_BAR0);
-                            dev->is_vga = (class_code == PCI_CLASS_DISPLAY && subclass == 0x00);
-                            
-                            pci_device_count++;
-                        }
-                    }
+    // Class register: revision, prog IF, subclass, class (low to high byte)
+    uint32_t class_reg = pci_read_config(bus, device, function, PCI_CONFIG_CLASS_CODE);
+    uint8_t class_code = (class_reg >> 24) & 0xFF;
+    uint8_t subclass = (class_reg >> 16) & 0xFF;
+    
+    // Store device if we have space
+    if (pci_device_count < MAX_PCI_DEVICES) {
+        struct pci_device *dev = &pci_devices[pci_device_count];
+        dev->bus = bus;
+        dev->device = device;
+        dev->function = function;
+        dev->vendor_id = vendor_device & 0xFFFF;
+        dev->device_id = (vendor_device >> 16) & 0xFFFF;
+        dev->class_code = class_code;
+        dev->subclass = subclass;
+        dev->bar0 = pci_read_config(bus, device, function, PCI_CONFIG_BAR0);
+        dev->is_vga = (class_code == PCI_CLASS_DISPLAY && subclass == 0x00);
+        
+        pci_device_count++;
+    }
+    
+    if (class_code == PCI_CLASS_BRIDGE && subclass == PCI_SUBCLASS_PCI_BRIDGE) {
+        uint8_t secondary = (pci_read_config(bus, device, function, PCI_CONFIG_BUS_NUMBERS) >> 8) & 0xFF;
+        if (secondary > bus) {
+            pci_scan_bus(secondary);
+        }
+    }
+}
+
+static void pci_scan_bus(uint8_t bus) {
+    for (uint8_t device = 0; device < 32; device++) {
+        // Check if device exists
+        if (!pci_device_exists(bus, device, 0)) {
+            continue;
+        }
+        pci_scan_function(bus, device, 0);
+        
+        // Check for multi-function devices
+        uint8_t header_type = (pci_read_config(bus, device, 0, PCI_CONFIG_HEADER_TYPE) >> 16) & 0xFF;
+        if ((header_type & 0x80) != 0) {
+            for (uint8_t function = 1; function < 8; function++) {
+                if (pci_device_exists(bus, device, function)) {
+                    pci_scan_function(bus, device, function);
                 }
             }
         }
     }
 }
 
+// Enumerate PCI devices, following bridges from the root bus instead of
+// probing all 256 buses (a few dozen config reads instead of 8192 probes)
+void pci_enumerate(void) {
+    pci_device_count = 0;
+    
+    // A multi-function host bridge means one host controller (root bus) per function
+    uint8_t header_type = (pci_read_config(0, 0, 0, PCI_CONFIG_HEADER_TYPE) >> 16) & 0xFF;
+    if ((header_type & 0x80) == 0) {
+        pci_scan_bus(0);
+        return;
+    }
+    for (uint8_t function = 0; function < 8; function++) {
+        if (pci_device_exists(0, 0, function)) {
+            pci_scan_bus(function);
+        }
+    }
+}
+
 // Find device by vendor and device ID
 struct pci_device* pci_find_device(uint16_t vendor_id, uint16_t device_id) {
     for (int i = 0; i < pci_device_count; i++) {
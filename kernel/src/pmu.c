@@ -0,0 +1,273 @@
+#include "pmu.h"
+#include "tsc.h"
+#include "string.h"
+#include <stddef.h>
+
+// Memory functions (defined in main.c)
+void *memcpy(void *restrict dest, const void *restrict src, size_t n);
+void *memset(void *s, int c, size_t n);
+
+// Intel architectural PMU MSRs
+#define IA32_PERFEVTSEL0        0x186
+#define IA32_FIXED_CTR_CTRL     0x38D
+#define IA32_PERF_GLOBAL_CTRL   0x38F
+
+// AMD extended core counters (CPUID 0x80000001 ECX bit 23)
+#define AMD_PERF_CTL0           0xC0010200  // Control/counter pairs, stride 2
+#define AMD_PERF_COUNTERS       6
+
+// Event select bits (same layout on Intel and AMD)
+#define EVTSEL_USR              (1u << 16)
+#define EVTSEL_OS               (1u << 17)
+#define EVTSEL_EN               (1u << 22)
+
+#define RDPMC_FIXED             (1u << 30)
+
+typedef struct {
+    bool available;
+    uint32_t rdpmc_index;
+    uint64_t mask;  // Counter width, for wrap-safe deltas
+} pmu_counter_t;
+
+typedef struct {
+    pmu_event_t event;
+    uint32_t select;  // umask << 8 | event
+    int ebx_bit;      // CPUID 0x0A EBX "not available" bit, -1 if not architectural
+} intel_event_t;
+
+static pmu_counter_t counters[PMU_EVENT_COUNT];
+static bool pmu_ready = false;
+
+static perf_scope_stats_t scopes[PERF_MAX_SCOPES];
+static uint32_t scope_count = 0;
+
+static const char *event_names[PMU_EVENT_COUNT] = {
+    "cycles", "instructions", "llc-misses", "branch-misses", "dtlb-misses"
+};
+
+static inline void cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx) {
+    __asm__ volatile ("cpuid" : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx) : "a"(leaf), "c"(0));
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile ("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+static inline uint64_t rdpmc(uint32_t index) {
+    uint32_t low, high;
+    __asm__ volatile ("rdpmc" : "=a"(low), "=d"(high) : "c"(index));
+    return ((uint64_t)high << 32) | low;
+}
+
+static uint64_t width_mask(uint32_t bits) {
+    return bits >= 64 ? ~0ULL : (1ULL << bits) - 1;
+}
+
+static void counter_set(pmu_event_t event, uint32_t rdpmc_index, uint32_t bits) {
+    counters[event].available = true;
+    counters[event].rdpmc_index = rdpmc_index;
+    counters[event].mask = width_mask(bits);
+}
+
+// dTLB walks have no architectural event; these are the big-core encodings
+static uint32_t intel_dtlb_event(uint32_t family, uint32_t model) {
+    static const uint8_t skylake_and_later[] = {
+        0x4E, 0x5E, 0x55, 0x8E, 0x9E, 0x66, 0x6A, 0x6C, 0x7D, 0x7E,
+        0x8C, 0x8D, 0xA5, 0xA6, 0x97, 0x9A, 0xB7, 0xBA, 0xBF, 0x8F
+    };
+    if (family != 6) {
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(skylake_and_later); i++) {
+        if (model == skylake_and_later[i]) {
+            return 0x0E08;  // DTLB_LOAD_MISSES.WALK_COMPLETED
+        }
+    }
+    return model >= 0x1A ? 0x0108 : 0;  // DTLB_LOAD_MISSES.MISS_CAUSES_A_WALK
+}
+
+static bool intel_init(uint32_t family, uint32_t model) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(0, &eax, &ebx, &ecx, &edx);
+    if (eax < 0x0A) {
+        return false;
+    }
+    
+    cpuid(0x0A, &eax, &ebx, &ecx, &edx);
+    uint32_t version = eax & 0xFF;
+    uint32_t gp_count = (eax >> 8) & 0xFF;
+    uint32_t gp_width = (eax >> 16) & 0xFF;
+    uint32_t ebx_length = (eax >> 24) & 0xFF;
+    uint32_t fixed_count = version >= 2 ? edx & 0x1F : 0;
+    uint32_t fixed_width = (edx >> 5) & 0xFF;
+    if (version == 0 || gp_count == 0) {
+        return false;
+    }
+    
+    intel_event_t wanted[PMU_EVENT_COUNT];
+    uint32_t wanted_count = 0;
+    uint32_t fixed_mask = 0;
+    
+    if (fixed_count >= 2) {
+        // Fixed counter 0 counts instructions, fixed counter 1 core cycles
+        counter_set(PMU_INSTRUCTIONS, RDPMC_FIXED | 0, fixed_width);
+        counter_set(PMU_CYCLES, RDPMC_FIXED | 1, fixed_width);
+        wrmsr(IA32_FIXED_CTR_CTRL, 0x33);  // OS + USR for both
+        fixed_mask = 0x3;
+    } else {
+        wanted[wanted_count++] = (intel_event_t){ PMU_CYCLES, 0x003C, 0 };
+        wanted[wanted_count++] = (intel_event_t){ PMU_INSTRUCTIONS, 0x00C0, 1 };
+    }
+    wanted[wanted_count++] = (intel_event_t){ PMU_LLC_MISSES, 0x412E, 4 };
+    wanted[wanted_count++] = (intel_event_t){ PMU_BRANCH_MISSES, 0x00C5, 6 };
+    uint32_t dtlb = intel_dtlb_event(family, model);
+    if (dtlb) {
+        wanted[wanted_count++] = (intel_event_t){ PMU_DTLB_MISSES, dtlb, -1 };
+    }
+    
+    uint32_t gp_used = 0;
+    for (uint32_t i = 0; i < wanted_count && gp_used < gp_count; i++) {
+        // EBX bits set = architectural event not available
+        int bit = wanted[i].ebx_bit;
+        if (bit >= 0 && ((uint32_t)bit >= ebx_length || (ebx & (1u << bit)))) {
+            continue;
+        }
+        wrmsr(IA32_PERFEVTSEL0 + gp_used,
+              wanted[i].select | EVTSEL_USR | EVTSEL_OS | EVTSEL_EN);
+        counter_set(wanted[i].event, gp_used, gp_width);
+        gp_used++;
+    }
+    
+    if (version >= 2) {
+        wrmsr(IA32_PERF_GLOBAL_CTRL, ((uint64_t)fixed_mask << 32) | ((1ULL << gp_used) - 1));
+    }
+    return gp_used > 0 || fixed_mask != 0;
+}
+
+static bool amd_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+    if (eax < 0x80000001) {
+        return false;
+    }
+    cpuid(0x80000001, &eax, &ebx, &ecx, &edx);
+    if (!(ecx & (1u << 23))) {
+        return false;
+    }
+    
+    // No core event for L3 misses (that lives in the L3 PMU)
+    static const struct {
+        pmu_event_t event;
+        uint32_t select;
+    } events[] = {
+        { PMU_CYCLES, 0x0076 },         // Cycles not in halt
+        { PMU_INSTRUCTIONS, 0x00C0 },   // Retired instructions
+        { PMU_BRANCH_MISSES, 0x00C3 },  // Retired mispredicted branches
+        { PMU_DTLB_MISSES, 0xF045 },    // L1 DTLB misses that also missed the L2 TLB
+    };
+    for (uint32_t i = 0; i < sizeof(events) / sizeof(events[0]) && i < AMD_PERF_COUNTERS; i++) {
+        wrmsr(AMD_PERF_CTL0 + 2 * i, events[i].select | EVTSEL_USR | EVTSEL_OS | EVTSEL_EN);
+        counter_set(events[i].event, i, 48);
+    }
+    return true;
+}
+
+bool pmu_init(void) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(0, &eax, &ebx, &ecx, &edx);
+    char vendor[13];
+    memcpy(vendor, &ebx, 4);
+    memcpy(vendor + 4, &edx, 4);
+    memcpy(vendor + 8, &ecx, 4);
+    vendor[12] = '\0';
+    
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    uint32_t family = (eax >> 8) & 0x0F;
+    uint32_t model = (eax >> 4) & 0x0F;
+    if (family == 0x0F) {
+        family += (eax >> 20) & 0xFF;
+    }
+    if (family == 0x06 || family >= 0x0F) {
+        model |= ((eax >> 16) & 0x0F) << 4;
+    }
+    
+    if (strcmp(vendor, "GenuineIntel") == 0) {
+        pmu_ready = intel_init(family, model);
+    } else if (strcmp(vendor, "AuthenticAMD") == 0) {
+        pmu_ready = amd_init();
+    }
+    return pmu_ready;
+}
+
+bool pmu_event_available(pmu_event_t event) {
+    return event < PMU_EVENT_COUNT && counters[event].available;
+}
+
+const char *pmu_event_name(pmu_event_t event) {
+    return event < PMU_EVENT_COUNT ? event_names[event] : "unknown";
+}
+
+void pmu_read(uint64_t counts[PMU_EVENT_COUNT]) {
+    for (int i = 0; i < PMU_EVENT_COUNT; i++) {
+        counts[i] = counters[i].available ? rdpmc(counters[i].rdpmc_index) : 0;
+    }
+}
+
+uint32_t perf_scope(const char *name) {
+    for (uint32_t i = 0; i < scope_count; i++) {
+        if (strcmp(scopes[i].name, name) == 0) {
+            return i;
+        }
+    }
+    if (scope_count >= PERF_MAX_SCOPES) {
+        return PERF_SCOPE_NONE;
+    }
+    memset(&scopes[scope_count], 0, sizeof(perf_scope_stats_t));
+    scopes[scope_count].name = name;
+    return scope_count++;
+}
+
+void perf_begin(uint32_t scope) {
+    if (scope >= scope_count || scopes[scope].depth++ > 0) {
+        return;
+    }
+    perf_scope_stats_t *stats = &scopes[scope];
+    if (pmu_ready) {
+        pmu_read(stats->start);
+    }
+    stats->start_tsc = tsc_read();
+}
+
+void perf_end(uint32_t scope) {
+    if (scope >= scope_count || scopes[scope].depth == 0 || --scopes[scope].depth > 0) {
+        return;
+    }
+    perf_scope_stats_t *stats = &scopes[scope];
+    stats->tsc += tsc_read() - stats->start_tsc;
+    if (pmu_ready) {
+        uint64_t now[PMU_EVENT_COUNT];
+        pmu_read(now);
+        for (int i = 0; i < PMU_EVENT_COUNT; i++) {
+            stats->counts[i] += (now[i] - stats->start[i]) & counters[i].mask;
+        }
+    }
+    stats->calls++;
+}
+
+uint32_t perf_scope_count(void) {
+    return scope_count;
+}
+
+const perf_scope_stats_t *perf_scope_stats(uint32_t scope) {
+    return scope < scope_count ? &scopes[scope] : NULL;
+}
+
+void perf_reset(void) {
+    for (uint32_t i = 0; i < scope_count; i++) {
+        scopes[i].calls = 0;
+        scopes[i].tsc = 0;
+        for (int j = 0; j < PMU_EVENT_COUNT; j++) {
+            scopes[i].counts[j] = 0;
+        }
+    }
+}
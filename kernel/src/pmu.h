@@ -0,0 +1,78 @@
+#ifndef PMU_H
+#define PMU_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Hardware performance counters
+//
+// pmu_init() programs the core PMU to count the events below in the kernel
+// (Intel architectural PMU, or AMD's extended core counters). Named scopes
+// accumulate the counter deltas and TSC time between perf_begin() and
+// perf_end(); the "perfstat" command prints them. IPC and misses per
+// thousand instructions tell memory-bound code (low IPC, many LLC/dTLB
+// misses) from compute-bound code.
+//
+// Without a PMU (QEMU TCG, KVM with pmu=off) scopes still record calls and
+// TSC time, and the counters read as unavailable.
+//
+// C:    perf_begin(PERF_SCOPE_ID("log_flush")); ... perf_end(...);
+// Rust: extern "C" perf_scope/perf_begin/perf_end, id cached per call site
+
+typedef enum {
+    PMU_CYCLES = 0,     // Core clock cycles (unhalted)
+    PMU_INSTRUCTIONS,   // Instructions retired
+    PMU_LLC_MISSES,     // Last level cache misses
+    PMU_BRANCH_MISSES,  // Mispredicted branches retired
+    PMU_DTLB_MISSES,    // Data TLB misses that walked the page tables
+    PMU_EVENT_COUNT
+} pmu_event_t;
+
+#define PERF_MAX_SCOPES 32
+#define PERF_SCOPE_NONE 0xFFFFFFFFu
+
+typedef struct {
+    const char *name;
+    uint64_t calls;
+    uint64_t tsc;                      // Total TSC ticks inside the scope
+    uint64_t counts[PMU_EVENT_COUNT];  // Total event counts inside the scope
+    uint32_t depth;                    // Nesting level, only the outermost counts
+    uint64_t start_tsc;
+    uint64_t start[PMU_EVENT_COUNT];
+} perf_scope_stats_t;
+
+// Detect and start the counters. Returns false if there is no usable PMU.
+bool pmu_init(void);
+
+// True if the event is being counted
+bool pmu_event_available(pmu_event_t event);
+
+const char *pmu_event_name(pmu_event_t event);
+
+// Current counter values (unavailable events read as 0)
+void pmu_read(uint64_t counts[PMU_EVENT_COUNT]);
+
+// Find or register a named scope. name must stay valid (a literal).
+// Returns PERF_SCOPE_NONE when the table is full.
+uint32_t perf_scope(const char *name);
+
+void perf_begin(uint32_t scope);
+void perf_end(uint32_t scope);
+
+// Registered scopes, for reporting
+uint32_t perf_scope_count(void);
+const perf_scope_stats_t *perf_scope_stats(uint32_t scope);
+
+// Zero all aggregates (scopes stay registered)
+void perf_reset(void);
+
+// Scope id looked up once per call site
+#define PERF_SCOPE_ID(name) ({                          \
+    static uint32_t perf_scope_id_ = PERF_SCOPE_NONE;   \
+    if (perf_scope_id_ == PERF_SCOPE_NONE) {            \
+        perf_scope_id_ = perf_scope(name);              \
+    }                                                   \
+    perf_scope_id_;                                     \
+})
+
+#endif // PMU_H
@@ -3,6 +3,7 @@
 #include "terminal.h"
 #include "keyboard.h"
 #include "string.h"
+#include "trace.h"
 
 // Process table
 static process_t processes[MAX_PROCESSES];
@@ -75,8 +76,8 @@ int process_create(const char *name, const uint8_t *elf_data, size_t elf_size) {
     return proc->pid;
 }
 
-// System call handler
-uint64_t syscall_handler(uint64_t syscall_num, uint64_t arg1, uint64_t arg2, uint64_t arg3) {
+// System call dispatch
+static uint64_t syscall_dispatch(uint64_t syscall_num, uint64_t arg1, uint64_t arg2, uint64_t arg3) {
     (void)arg2; // Unused for now
     (void)arg3; // Unused for now
     
@@ -143,6 +144,14 @@ uint64_t syscall_handler(uint64_t syscall_num, uint64_t arg1, uint64_t arg2, uin
     }
 }
 
+// System call handler
+uint64_t syscall_handler(uint64_t syscall_num, uint64_t arg1, uint64_t arg2, uint64_t arg3) {
+    trace_emit(TRACE_SYSCALL, TRACE_BEGIN, syscall_num, arg1, 0);
+    uint64_t result = syscall_dispatch(syscall_num, arg1, arg2, arg3);
+    trace_end(TRACE_SYSCALL, result);
+    return result;
+}
+
 // Execute a process (simulation mode - completely safe)
 bool process_execute(int pid) {
     if (!process_system_initialized) {
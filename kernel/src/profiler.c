@@ -0,0 +1,468 @@
+#include "profiler.h"
+#include "symbols.h"
+#include "logger.h"
+#include "terminal.h"
+#include "string.h"
+#include "virtio_console.h"
+#include "trace.h"
+#include <stddef.h>
+
+// PIT channel 0 drives the sampling interrupt (IRQ0 through the legacy PIC)
+#define PIT_FREQUENCY     1193182
+#define PIT_CHANNEL0_DATA 0x40
+#define PIT_COMMAND       0x43
+
+#define PIC1_COMMAND 0x20
+#define PIC1_DATA    0x21
+#define PIC2_COMMAND 0xA0
+#define PIC2_DATA    0xA1
+#define PIC_EOI      0x20
+
+#define IRQ_BASE_VECTOR 0x20  // PIC remapped above the CPU exceptions
+#define IDT_ENTRIES     256
+
+#define PROFILE_MAX_CPUS    8
+#define PROFILE_RING_SIZE   256   // Samples per CPU between idle folds (power of two)
+#define PROFILE_MAX_DEPTH   16
+#define PROFILE_MAX_STACKS  1024  // Distinct stacks (power of two)
+#define PROFILE_MAX_SECONDS 60
+#define PROFILE_TOP_FUNCS   5
+
+typedef struct __attribute__((packed)) {
+    uint16_t offset_low;
+    uint16_t selector;
+    uint8_t ist;
+    uint8_t type_attr;
+    uint16_t offset_mid;
+    uint32_t offset_high;
+    uint32_t reserved;
+} idt_entry_t;
+
+typedef struct __attribute__((packed)) {
+    uint16_t limit;
+    uint64_t base;
+} idt_pointer_t;
+
+// Registers saved by profile_irq_stub, followed by the CPU's interrupt frame
+typedef struct {
+    uint64_t r15, r14, r13, r12, r11, r10, r9, r8;
+    uint64_t rbp, rdi, rsi, rdx, rcx, rbx, rax;
+    uint64_t rip, cs, rflags, rsp, ss;
+} interrupt_frame_t;
+
+typedef struct {
+    uint64_t frames[PROFILE_MAX_DEPTH];  // frames[0] is the interrupted RIP
+    uint32_t depth;
+} profile_sample_t;
+
+// Written by the interrupt handler, drained by the idle loop
+typedef struct {
+    uint32_t head;
+    uint32_t tail;
+    uint32_t dropped;
+    profile_sample_t samples[PROFILE_RING_SIZE];
+} profile_ring_t;
+
+typedef struct {
+    uint64_t frames[PROFILE_MAX_DEPTH];
+    uint32_t depth;
+    uint32_t count;  // 0 = free slot
+} profile_stack_t;
+
+static idt_entry_t idt[IDT_ENTRIES] __attribute__((aligned(16)));
+static bool idt_loaded = false;
+
+static profile_ring_t profile_rings[PROFILE_MAX_CPUS];
+static profile_stack_t profile_stacks[PROFILE_MAX_STACKS];
+static uint32_t profile_stack_count = 0;
+static uint32_t profile_samples = 0;
+static uint32_t profile_overflow = 0;  // Samples whose stack didn't fit the table
+static uint32_t profile_dropped = 0;
+static uint32_t profile_target = 0;    // Samples (incl. dropped) to take
+static bool profile_active = false;
+static uint64_t stack_top = 0;
+
+// Port I/O functions
+static inline void outb(uint16_t port, uint8_t value) {
+    __asm__ volatile ("outb %0, %1" : : "a"(value), "Nd"(port));
+}
+
+void profile_interrupt(interrupt_frame_t *frame);
+extern void profile_irq_stub(void);
+extern void profile_spurious_stub(void);
+
+// IRQ0 entry: save the general registers and SSE state (the handler is plain
+// C and may touch XMM registers), call profile_interrupt with the frame.
+// The CPU aligns RSP to 16 before pushing its 5-word frame, so after 15 pushes
+// the stack is 16-byte aligned again for fxsave and the call.
+__asm__(
+    ".text\n"
+    ".global profile_irq_stub\n"
+    "profile_irq_stub:\n"
+    "    push %rax\n"
+    "    push %rbx\n"
+    "    push %rcx\n"
+    "    push %rdx\n"
+    "    push %rsi\n"
+    "    push %rdi\n"
+    "    push %rbp\n"
+    "    push %r8\n"
+    "    push %r9\n"
+    "    push %r10\n"
+    "    push %r11\n"
+    "    push %r12\n"
+    "    push %r13\n"
+    "    push %r14\n"
+    "    push %r15\n"
+    "    sub $512, %rsp\n"
+    "    fxsave (%rsp)\n"
+    "    lea 512(%rsp), %rdi\n"
+    "    cld\n"
+    "    call profile_interrupt\n"
+    "    fxrstor (%rsp)\n"
+    "    add $512, %rsp\n"
+    "    pop %r15\n"
+    "    pop %r14\n"
+    "    pop %r13\n"
+    "    pop %r12\n"
+    "    pop %r11\n"
+    "    pop %r10\n"
+    "    pop %r9\n"
+    "    pop %r8\n"
+    "    pop %rbp\n"
+    "    pop %rdi\n"
+    "    pop %rsi\n"
+    "    pop %rdx\n"
+    "    pop %rcx\n"
+    "    pop %rbx\n"
+    "    pop %rax\n"
+    "    iretq\n"
+    // Masked PIC lines can still raise spurious IRQ7/15, which take no EOI
+    ".global profile_spurious_stub\n"
+    "profile_spurious_stub:\n"
+    "    iretq\n"
+);
+
+void profile_set_stack_top(const void *top) {
+    stack_top = (uint64_t)top;
+}
+
+static void idt_set_gate(int vector, void (*handler)(void), uint16_t selector) {
+    uint64_t address = (uint64_t)handler;
+    idt[vector].offset_low = (uint16_t)address;
+    idt[vector].selector = selector;
+    idt[vector].ist = 0;
+    idt[vector].type_attr = 0x8E;  // Present, ring 0, interrupt gate
+    idt[vector].offset_mid = (uint16_t)(address >> 16);
+    idt[vector].offset_high = (uint32_t)(address >> 32);
+    idt[vector].reserved = 0;
+}
+
+// Only the PIC vectors are populated; exceptions still end in a triple fault,
+// exactly as they did before there was an IDT
+static void idt_install(void) {
+    if (idt_loaded) {
+        return;
+    }
+    
+    uint16_t cs;
+    __asm__ volatile ("mov %%cs, %0" : "=r"(cs));
+    for (int vector = IRQ_BASE_VECTOR; vector < IRQ_BASE_VECTOR + 16; vector++) {
+        idt_set_gate(vector, profile_spurious_stub, cs);
+    }
+    idt_set_gate(IRQ_BASE_VECTOR, profile_irq_stub, cs);
+    
+    idt_pointer_t pointer = { sizeof(idt) - 1, (uint64_t)idt };
+    __asm__ volatile ("lidt %0" : : "m"(pointer));
+    idt_loaded = true;
+}
+
+// Remap the PIC to IRQ_BASE_VECTOR and unmask IRQ0 only
+static void pic_enable_timer(void) {
+    outb(PIC1_COMMAND, 0x11);  // ICW1: initialize, ICW4 follows
+    outb(PIC2_COMMAND, 0x11);
+    outb(PIC1_DATA, IRQ_BASE_VECTOR);
+    outb(PIC2_DATA, IRQ_BASE_VECTOR + 8);
+    outb(PIC1_DATA, 0x04);     // Slave on IRQ2
+    outb(PIC2_DATA, 0x02);
+    outb(PIC1_DATA, 0x01);     // 8086 mode
+    outb(PIC2_DATA, 0x01);
+    outb(PIC1_DATA, 0xFE);
+    outb(PIC2_DATA, 0xFF);
+}
+
+void profile_interrupt(interrupt_frame_t *frame) {
+    trace_begin(TRACE_IRQ, IRQ_BASE_VECTOR);
+    profile_ring_t *ring = &profile_rings[0];
+    uint32_t head = ring->head;
+    
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= PROFILE_RING_SIZE) {
+        ring->dropped++;
+    } else {
+        profile_sample_t *sample = &ring->samples[head % PROFILE_RING_SIZE];
+        sample->frames[0] = frame->rip;
+        uint32_t depth = 1;
+        
+        // Only follow frame pointers that stay on the stack and move towards its top
+        uint64_t rbp = frame->rbp;
+        uint64_t low = frame->rsp;
+        while (depth < PROFILE_MAX_DEPTH && rbp >= low && rbp + 16 <= stack_top && (rbp & 7) == 0) {
+            const uint64_t *fp = (const uint64_t *)rbp;
+            if (fp[1] == 0) {
+                break;
+            }
+            sample->frames[depth++] = fp[1];
+            low = rbp + 16;
+            rbp = fp[0];
+        }
+        sample->depth = depth;
+        __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    }
+    
+    outb(PIC1_COMMAND, PIC_EOI);
+    trace_end(TRACE_IRQ, IRQ_BASE_VECTOR);
+}
+
+static uint32_t stack_hash(const profile_sample_t *sample) {
+    uint32_t hash = 0x811c9dc5;
+    for (uint32_t i = 0; i < sample->depth; i++) {
+        hash = (hash ^ (uint32_t)sample->frames[i] ^ (uint32_t)(sample->frames[i] >> 32)) * 0x01000193;
+    }
+    return hash;
+}
+
+// Count a sample against its stack (open addressing, linear probing)
+static void profile_count(const profile_sample_t *sample) {
+    profile_samples++;
+    
+    uint32_t slot = stack_hash(sample) & (PROFILE_MAX_STACKS - 1);
+    for (uint32_t probe = 0; probe < PROFILE_MAX_STACKS; probe++) {
+        profile_stack_t *stack = &profile_stacks[slot];
+        if (stack->count == 0) {
+            // Keep a quarter free so probes stay short
+            if (profile_stack_count >= PROFILE_MAX_STACKS * 3 / 4) {
+                break;
+            }
+            for (uint32_t i = 0; i < sample->depth; i++) {
+                stack->frames[i] = sample->frames[i];
+            }
+            stack->depth = sample->depth;
+            stack->count = 1;
+            profile_stack_count++;
+            return;
+        }
+        if (stack->depth == sample->depth) {
+            uint32_t i = 0;
+            while (i < sample->depth && stack->frames[i] == sample->frames[i]) {
+                i++;
+            }
+            if (i == sample->depth) {
+                stack->count++;
+                return;
+            }
+        }
+        slot = (slot + 1) & (PROFILE_MAX_STACKS - 1);
+    }
+    profile_overflow++;
+}
+
+static void profile_fold(void) {
+    for (int cpu = 0; cpu < PROFILE_MAX_CPUS; cpu++) {
+        profile_ring_t *ring = &profile_rings[cpu];
+        uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        while (ring->tail != head) {
+            profile_count(&ring->samples[ring->tail % PROFILE_RING_SIZE]);
+            __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+        }
+        profile_dropped += __atomic_exchange_n(&ring->dropped, 0, __ATOMIC_RELAXED);
+    }
+}
+
+bool profile_start(uint32_t seconds) {
+    if (profile_active || seconds == 0) {
+        return false;
+    }
+    if (seconds > PROFILE_MAX_SECONDS) {
+        seconds = PROFILE_MAX_SECONDS;
+    }
+    
+    for (uint32_t i = 0; i < PROFILE_MAX_STACKS; i++) {
+        profile_stacks[i].count = 0;
+    }
+    for (int cpu = 0; cpu < PROFILE_MAX_CPUS; cpu++) {
+        profile_rings[cpu].head = 0;
+        profile_rings[cpu].tail = 0;
+        profile_rings[cpu].dropped = 0;
+    }
+    profile_stack_count = 0;
+    profile_samples = 0;
+    profile_overflow = 0;
+    profile_dropped = 0;
+    profile_target = seconds * PROFILE_HZ;
+    profile_active = true;
+    
+    idt_install();
+    
+    uint16_t divisor = PIT_FREQUENCY / PROFILE_HZ;
+    outb(PIT_COMMAND, 0x34);  // Channel 0, lobyte/hibyte, rate generator
+    outb(PIT_CHANNEL0_DATA, (uint8_t)divisor);
+    outb(PIT_CHANNEL0_DATA, (uint8_t)(divisor >> 8));
+    pic_enable_timer();
+    __asm__ volatile ("sti");
+    return true;
+}
+
+bool profile_running(void) {
+    return profile_active;
+}
+
+// Output helpers: folded stacks go to the profile port (or serial)
+static void profile_write(const char *text) {
+    logger_write_port(VIRTIO_CONSOLE_PORT_PROFILE, (const uint8_t *)text, (uint32_t)strlen(text));
+}
+
+static void append_number(char *line, size_t *pos, size_t size, uint64_t value, int base) {
+    if (base == 16) {
+        str_append(line, pos, size, "0x");
+    }
+    str_append_u64(line, pos, size, value, base);
+}
+
+// Return addresses point past the call; look up the call itself
+static const char *frame_name(const profile_stack_t *stack, uint32_t index) {
+    uint64_t address = stack->frames[index] - (index > 0 ? 1 : 0);
+    return symbols_lookup(address, NULL);
+}
+
+static void profile_write_folded(void) {
+    char line[1024];
+    size_t pos = 0;
+    
+    str_append(line, &pos, sizeof(line), "# PROFILE BEGIN samples=");
+    append_number(line, &pos, sizeof(line), profile_samples, 10);
+    str_append(line, &pos, sizeof(line), " hz=");
+    append_number(line, &pos, sizeof(line), PROFILE_HZ, 10);
+    str_append(line, &pos, sizeof(line), " dropped=");
+    append_number(line, &pos, sizeof(line), profile_dropped, 10);
+    str_append(line, &pos, sizeof(line), "\n");
+    profile_write(line);
+    
+    for (uint32_t slot = 0; slot < PROFILE_MAX_STACKS; slot++) {
+        const profile_stack_t *stack = &profile_stacks[slot];
+        if (stack->count == 0) {
+            continue;
+        }
+        
+        // Folded format lists the outermost caller first
+        pos = 0;
+        for (uint32_t i = stack->depth; i-- > 0;) {
+            const char *name = frame_name(stack, i);
+            if (name) {
+                str_append(line, &pos, sizeof(line), name);
+            } else {
+                append_number(line, &pos, sizeof(line), stack->frames[i], 16);
+            }
+            str_append(line, &pos, sizeof(line), i > 0 ? ";" : " ");
+        }
+        append_number(line, &pos, sizeof(line), stack->count, 10);
+        str_append(line, &pos, sizeof(line), "\n");
+        profile_write(line);
+    }
+    
+    if (profile_overflow > 0) {
+        pos = 0;
+        str_append(line, &pos, sizeof(line), "[stack table full] ");
+        append_number(line, &pos, sizeof(line), profile_overflow, 10);
+        str_append(line, &pos, sizeof(line), "\n");
+        profile_write(line);
+    }
+    profile_write("# PROFILE END\n");
+}
+
+// Terminal summary: the functions that were on-CPU most often
+static void profile_print_summary(void) {
+    const char *names[PROFILE_MAX_STACKS];
+    uint32_t counts[PROFILE_MAX_STACKS];
+    uint32_t functions = 0;
+    
+    for (uint32_t slot = 0; slot < PROFILE_MAX_STACKS; slot++) {
+        const profile_stack_t *stack = &profile_stacks[slot];
+        if (stack->count == 0) {
+            continue;
+        }
+        const char *name = frame_name(stack, 0);
+        if (!name) {
+            name = "[unknown]";
+        }
+        uint32_t i = 0;
+        while (i < functions && names[i] != name) {
+            i++;
+        }
+        if (i == functions) {
+            names[functions] = name;
+            counts[functions++] = 0;
+        }
+        counts[i] += stack->count;
+    }
+    
+    char line[160];
+    size_t pos = 0;
+    str_append(line, &pos, sizeof(line), "Profile: ");
+    append_number(line, &pos, sizeof(line), profile_samples, 10);
+    str_append(line, &pos, sizeof(line), " samples, ");
+    append_number(line, &pos, sizeof(line), profile_dropped, 10);
+    str_append(line, &pos, sizeof(line), " dropped. Top functions:\n");
+    terminal_print(line);
+    
+    for (int rank = 0; rank < PROFILE_TOP_FUNCS && functions > 0; rank++) {
+        uint32_t best = 0;
+        for (uint32_t i = 1; i < functions; i++) {
+            if (counts[i] > counts[best]) {
+                best = i;
+            }
+        }
+        if (counts[best] == 0) {
+            break;
+        }
+        
+        uint32_t permille = profile_samples ? (uint32_t)((uint64_t)counts[best] * 1000 / profile_samples) : 0;
+        pos = 0;
+        str_append(line, &pos, sizeof(line), "  ");
+        append_number(line, &pos, sizeof(line), permille / 10, 10);
+        str_append(line, &pos, sizeof(line), ".");
+        append_number(line, &pos, sizeof(line), permille % 10, 10);
+        str_append(line, &pos, sizeof(line), "%  ");
+        str_append(line, &pos, sizeof(line), names[best]);
+        str_append(line, &pos, sizeof(line), "\n");
+        terminal_print(line);
+        counts[best] = 0;
+    }
+}
+
+void profile_stop(void) {
+    if (!profile_active) {
+        return;
+    }
+    
+    __asm__ volatile ("cli");
+    outb(PIC1_DATA, 0xFF);
+    profile_active = false;
+    profile_fold();
+    
+    if (!symbols_init()) {
+        terminal_print("Profile: no kernel symbol table, writing raw addresses\n");
+    }
+    profile_write_folded();
+    profile_print_summary();
+}
+
+void profile_poll(void) {
+    if (!profile_active) {
+        return;
+    }
+    
+    profile_fold();
+    if (profile_samples + profile_overflow + profile_dropped >= profile_target) {
+        profile_stop();
+    }
+}
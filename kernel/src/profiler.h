@@ -0,0 +1,33 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Sampling profiler
+//
+// PIT channel 0 interrupts the kernel PROFILE_HZ times a second while a
+// profile runs. Each interrupt records RIP and a frame-pointer stack walk into
+// the CPU's sample ring; the idle loop folds samples into per-stack counts.
+// When the profile ends the stacks are symbolized against the kernel's ELF
+// symbol table and written in folded-stack format ("caller;callee count")
+// for flamegraph.pl, on the virtio-console profile port or serial.
+
+#define PROFILE_HZ 1000
+
+// Start sampling for the given duration. Returns false if already running.
+bool profile_start(uint32_t seconds);
+
+// Stop now and write out the profile
+void profile_stop(void);
+
+bool profile_running(void);
+
+// Fold pending samples and stop once the duration has elapsed. Called from
+// the idle loop.
+void profile_poll(void);
+
+// Record where the boot stack ends; frame walks stop there (call from kmain)
+void profile_set_stack_top(const void *top);
+
+#endif // PROFILER_H
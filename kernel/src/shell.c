@@ -6,9 +6,12 @@
 #include "commands/execution.h"
 #include "commands/window_example.h"
 #include "commands/gpu.h"
+#include "commands/perf.h"
 #include "terminal.h"
 #include "keyboard.h"
 #include "mouse.h"
+#include "input.h"
+#include "window_manager_rust.h"
 #include "string.h"
 #include "audio.h"
 #include <stddef.h>
@@ -18,25 +21,14 @@
 static char input_buffer[256];
 static size_t input_pos = 0;
 
-// Helper function to check and handle mouse events
+// Helper function to gather input and let the window manager run a frame
 void check_mouse_events(void) {
-    // Check for mouse events multiple times for better responsiveness
-    for (int i = 0; i < 10; i++) {
-        if (mouse_has_data()) {
-            mouse_handle_interrupt();
-        }
+    // Pointer events are queued (and coalesced) here; the window manager
+    // drains the whole queue once per frame instead of once per packet
+    input_poll();
+    if (input_frame_due()) {
+        wm_update();
     }
-    
-    // Handle window manager mouse and update
-    extern void wm_handle_mouse(int mouse_x, int mouse_y, bool left_button);
-    extern void wm_update(void);
-    
-    mouse_state_t *mouse = mouse_get_state();
-    
-    // Always handle mouse and update window manager
-    // Window manager now handles cursor rendering in all cases
-    wm_handle_mouse(mouse->x, mouse->y, mouse->left_button);
-    wm_update();
 }
 
 // Command registry
@@ -136,6 +128,9 @@ void shell_init(void) {
     
     // Register GPU commands
     register_gpu_commands();
+    
+    // Register performance commands
+    register_perf_commands();
 }
 
 // Shell main loop
@@ -166,19 +161,8 @@ void shell_loop(void) {
         // Read command
         input_pos = 0;
         while (1) {
-            // Check for mouse events during input
-            check_mouse_events();
-            
-            // Periodically update window manager for continuous animations
-            // This ensures animating windows update even when waiting for input
-            static uint32_t update_counter = 0;
-            update_counter++;
-            if (update_counter >= 500) {  // Update every ~500 iterations
-                update_counter = 0;
-                extern void wm_update(void);
-                wm_update();
-            }
-            
+            // read_key() keeps gathering input and running frames (including
+            // animating windows) while it waits
             char c = read_key();
             
             if (c == '\n') {
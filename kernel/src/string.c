@@ -90,4 +90,28 @@ void int_to_string(int value, char *buffer) {
         buffer[j++] = temp[--i];
     }
     buffer[j] = '\0';
-}
\ No newline at end of file
+}
+
+void str_append(char *line, size_t *pos, size_t size, const char *text) {
+    while (*text && *pos < size - 1) {
+        line[(*pos)++] = *text++;
+    }
+    line[*pos] = '\0';
+}
+
+void str_append_u64(char *line, size_t *pos, size_t size, uint64_t value, int base) {
+    char digits[24];
+    int count = 0;
+    do {
+        digits[count++] = "0123456789abcdef"[value % (uint64_t)base];
+        value /= (uint64_t)base;
+    } while (value > 0);
+    
+    char text[24];
+    int length = 0;
+    while (count > 0) {
+        text[length++] = digits[--count];
+    }
+    text[length] = '\0';
+    str_append(line, pos, size, text);
+}
@@ -2,6 +2,7 @@
 #define STRING_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 // String functions
 size_t strlen(const char *str);
@@ -12,4 +13,10 @@ int strncmp(const char *s1, const char *s2, size_t n);
 char *strcat(char *dest, const char *src);
 void int_to_string(int value, char *buffer);
 
+// Bounded line building: append at line[*pos], advance *pos and keep the line
+// NUL-terminated, truncating at size - 1 characters
+void str_append(char *line, size_t *pos, size_t size, const char *text);
+// Append an unsigned value in base 10 or 16 (lowercase, no prefix)
+void str_append_u64(char *line, size_t *pos, size_t size, uint64_t value, int base);
+
 #endif // STRING_H 
\ No newline at end of file
@@ -0,0 +1,116 @@
+#include "symbols.h"
+#include <limine.h>
+#include <stddef.h>
+
+__attribute__((used, section(".limine_requests")))
+static volatile struct limine_executable_file_request executable_file_request = {
+    .id = LIMINE_EXECUTABLE_FILE_REQUEST,
+    .revision = 0
+};
+
+#define SHT_SYMTAB 2
+#define STT_FUNC   2
+
+typedef struct {
+    uint8_t e_ident[16];
+    uint16_t e_type;
+    uint16_t e_machine;
+    uint32_t e_version;
+    uint64_t e_entry;
+    uint64_t e_phoff;
+    uint64_t e_shoff;
+    uint32_t e_flags;
+    uint16_t e_ehsize;
+    uint16_t e_phentsize;
+    uint16_t e_phnum;
+    uint16_t e_shentsize;
+    uint16_t e_shnum;
+    uint16_t e_shstrndx;
+} elf64_ehdr_t;
+
+typedef struct {
+    uint32_t sh_name;
+    uint32_t sh_type;
+    uint64_t sh_flags;
+    uint64_t sh_addr;
+    uint64_t sh_offset;
+    uint64_t sh_size;
+    uint32_t sh_link;
+    uint32_t sh_info;
+    uint64_t sh_addralign;
+    uint64_t sh_entsize;
+} elf64_shdr_t;
+
+typedef struct {
+    uint32_t st_name;
+    uint8_t st_info;
+    uint8_t st_other;
+    uint16_t st_shndx;
+    uint64_t st_value;
+    uint64_t st_size;
+} elf64_sym_t;
+
+static const elf64_sym_t *symtab = NULL;
+static uint64_t symbol_count = 0;
+static const char *strtab = NULL;
+
+bool symbols_init(void) {
+    if (symtab) {
+        return true;
+    }
+    
+    struct limine_executable_file_response *response = executable_file_request.response;
+    if (!response || !response->executable_file) {
+        return false;
+    }
+    
+    const uint8_t *image = (const uint8_t *)response->executable_file->address;
+    uint64_t image_size = response->executable_file->size;
+    const elf64_ehdr_t *ehdr = (const elf64_ehdr_t *)image;
+    if (image_size < sizeof(elf64_ehdr_t) || ehdr->e_ident[0] != 0x7F || ehdr->e_ident[1] != 'E' ||
+        ehdr->e_shentsize != sizeof(elf64_shdr_t) ||
+        ehdr->e_shoff + (uint64_t)ehdr->e_shnum * sizeof(elf64_shdr_t) > image_size) {
+        return false;
+    }
+    
+    const elf64_shdr_t *sections = (const elf64_shdr_t *)(image + ehdr->e_shoff);
+    for (uint16_t i = 0; i < ehdr->e_shnum; i++) {
+        const elf64_shdr_t *sym = &sections[i];
+        if (sym->sh_type != SHT_SYMTAB || sym->sh_link >= ehdr->e_shnum) {
+            continue;
+        }
+        const elf64_shdr_t *str = &sections[sym->sh_link];
+        if (sym->sh_offset + sym->sh_size > image_size || str->sh_offset + str->sh_size > image_size) {
+            return false;
+        }
+        strtab = (const char *)(image + str->sh_offset);
+        symbol_count = sym->sh_size / sizeof(elf64_sym_t);
+        symtab = (const elf64_sym_t *)(image + sym->sh_offset);
+        return true;
+    }
+    return false;
+}
+
+const char *symbols_lookup(uint64_t addr, uint64_t *offset) {
+    if (!symtab) {
+        return NULL;
+    }
+    
+    // Linear scan: lookups only happen when a profile is written out
+    const elf64_sym_t *best = NULL;
+    for (uint64_t i = 0; i < symbol_count; i++) {
+        const elf64_sym_t *sym = &symtab[i];
+        if ((sym->st_info & 0x0F) == STT_FUNC && addr >= sym->st_value && addr < sym->st_value + sym->st_size) {
+            best = sym;
+            break;
+        }
+    }
+    
+    if (!best) {
+        return NULL;
+    }
+    if (offset) {
+        *offset = addr - best->st_value;
+    }
+    return strtab + best->st_name;
+}
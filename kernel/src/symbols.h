@@ -0,0 +1,17 @@
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Kernel symbol lookup against the ELF symbol table of the kernel image that
+// Limine loaded (the executable file is handed over unstripped).
+
+// Locate .symtab/.strtab. Returns false if the image has no symbol table.
+bool symbols_init(void);
+
+// Name of the function containing addr, or NULL. offset (optional) receives
+// addr minus the symbol start.
+const char *symbols_lookup(uint64_t addr, uint64_t *offset);
+
+#endif // SYMBOLS_H
@@ -1,8 +1,10 @@
 #include "terminal.h"
 #include "font.h"
 #include "string.h"
-#include "mouse.h"
+#include "input.h"
 #include "window_manager_rust.h"
+#include "gpu_rust.h"
+#include "display_server_rust.h"
 #include <stddef.h>
 
 // Global variables for terminal
@@ -10,33 +12,114 @@ static struct limine_framebuffer *g_framebuffer;
 static int cursor_x = 0;
 static int cursor_y = 0;
 
+// Native pixel format of the framebuffer (colours are given as XRGB8888)
+static gpu_pixel_format_t fb_format;
+
+// Current terminal font. Glyphs are scaled up to roughly CHAR_HEIGHT, so the
+// built-in 8x8 font draws in 16x16 cells and an 8x16 PSF font at 1x.
+static const font_info_t *terminal_font = NULL;
+static int font_scale = 1;
+static int cell_width = CHAR_WIDTH;
+static int cell_height = CHAR_HEIGHT;
+
+
+static void terminal_use_font(const font_info_t *font);
 
 // Initialize terminal
 void terminal_init(struct limine_framebuffer *framebuffer) {
     g_framebuffer = framebuffer;
     cursor_x = 0;
     cursor_y = 0;
+    
+    fb_format = gpu_describe_pixel_format(framebuffer->bpp,
+                                          framebuffer->red_mask_size, framebuffer->red_mask_shift,
+                                          framebuffer->green_mask_size, framebuffer->green_mask_shift,
+                                          framebuffer->blue_mask_size, framebuffer->blue_mask_shift);
+    
+    // Registers the built-in font as font 0 (shared with the window manager)
+    // and loads PSF2 boot modules. The last font loaded is the default.
+    font_init();
+    terminal_use_font(font_get(font_count() - 1));
+}
+
+static void terminal_use_font(const font_info_t *font) {
+    if (font == NULL) {
+        return;
+    }
+    terminal_font = font;
+    font_scale = CHAR_HEIGHT / font->height;
+    if (font_scale < 1) {
+        font_scale = 1;
+    }
+    cell_width = font->width * font_scale;
+    cell_height = font->height * font_scale;
+}
+
+// Describe the framebuffer as a text engine target. Only 32 bpp formats can
+// take masked glyph stores; others fall back to per-pixel drawing.
+static bool fb_text_target(struct limine_framebuffer *framebuffer, gpu_text_target_t *target) {
+    if (terminal_font == NULL || fb_format.bytes_per_pixel != 4) {
+        return false;
+    }
+    target->buffer = (uint32_t *)framebuffer->address;
+    target->pitch = (uint32_t)(framebuffer->pitch / 4);
+    target->clip_x = 0;
+    target->clip_y = 0;
+    target->clip_width = (uint32_t)framebuffer->width;
+    target->clip_height = (uint32_t)framebuffer->height;
+    return true;
+}
+
+// Write an already-packed pixel value at (x, y), honouring the framebuffer depth
+static inline void fb_store_pixel(struct limine_framebuffer *framebuffer, int x, int y, uint32_t value) {
+    volatile uint8_t *p = (volatile uint8_t *)framebuffer->address
+                        + (size_t)y * framebuffer->pitch
+                        + (size_t)x * fb_format.bytes_per_pixel;
+    
+    switch (fb_format.bytes_per_pixel) {
+        case 4:
+            *(volatile uint32_t *)p = value;
+            break;
+        case 2:
+            *(volatile uint16_t *)p = (uint16_t)value;
+            break;
+        default:
+            for (uint32_t i = 0; i < fb_format.bytes_per_pixel && i < 4; i++) {
+                p[i] = (uint8_t)(value >> (i * 8));
+            }
+            break;
+    }
 }
 
-// Function to draw a character at a specific position with high quality
+// Function to draw a character at a specific position in the terminal font
 void draw_char(struct limine_framebuffer *framebuffer, char c, int x, int y, uint32_t color) {
-    if (c < 32 || c > 126) return; // Only printable ASCII
+    if (terminal_font == NULL) return;
     
-    const uint8_t *glyph = font_8x8[(unsigned char)c];
-    volatile uint32_t *fb_ptr = framebuffer->address;
+    const uint8_t *glyph = font_glyph(terminal_font, (unsigned char)c);
+    if (glyph == NULL) return;
     
-    // Clean 2x scaling from 8x8 to 16x16 - each pixel becomes a 2x2 block
-    for (int row = 0; row < 8; row++) {
-        for (int col = 0; col < 8; col++) {
-            if (glyph[row] & (1 << (7 - col))) {
-                // Each source pixel becomes a 2x2 block in the output
-                for (int scale_y = 0; scale_y < 2; scale_y++) {
-                    for (int scale_x = 0; scale_x < 2; scale_x++) {
-                        int pixel_x = x + (col * 2) + scale_x;
-                        int pixel_y = y + (row * 2) + scale_y;
+    uint32_t value = gpu_pack_pixel(color, &fb_format);
+    ds_invalidate_scanline_hashes();
+    
+    gpu_text_target_t target;
+    if (fb_text_target(framebuffer, &target)) {
+        gpu_draw_text(&target, x, y, &c, 1, terminal_font->id, font_scale, value, 0, 0);
+        return;
+    }
+    
+    // Per-pixel fallback for framebuffers the masked stores cannot write:
+    // each set bit becomes a font_scale x font_scale block
+    for (int row = 0; row < terminal_font->height; row++) {
+        const uint8_t *bits = glyph + row * terminal_font->bytes_per_row;
+        for (int col = 0; col < terminal_font->width; col++) {
+            if (bits[col / 8] & (0x80 >> (col % 8))) {
+                for (int scale_y = 0; scale_y < font_scale; scale_y++) {
+                    for (int scale_x = 0; scale_x < font_scale; scale_x++) {
+                        int pixel_x = x + (col * font_scale) + scale_x;
+                        int pixel_y = y + (row * font_scale) + scale_y;
                         
                         if (pixel_x < (int)framebuffer->width && pixel_y < (int)framebuffer->height) {
-                            fb_ptr[pixel_y * (framebuffer->pitch / 4) + pixel_x] = color;
+                            fb_store_pixel(framebuffer, pixel_x, pixel_y, value);
                         }
                     }
                 }
@@ -47,20 +130,32 @@ void draw_char(struct limine_framebuffer *framebuffer, char c, int x, int y, uin
 
 // Function to draw a string
 void draw_string(struct limine_framebuffer *framebuffer, const char *str, int x, int y, uint32_t color) {
+    ds_invalidate_scanline_hashes();
+    gpu_text_target_t target;
+    if (fb_text_target(framebuffer, &target)) {
+        // Whole string in one call so repeated labels hit the layout cache
+        gpu_draw_text(&target, x, y, str, (uint32_t)strlen(str), terminal_font->id, font_scale,
+                      gpu_pack_pixel(color, &fb_format), 0, 0);
+        return;
+    }
+    
     int current_x = x;
     
     while (*str) {
         draw_char(framebuffer, *str, current_x, y, color);
-        current_x += CHAR_WIDTH; // Move to next character position (14 pixels wide)
+        current_x += cell_width; // Move to next character position
         str++;
     }
 }
 
 // Clear screen
 void clear_screen(void) {
-    volatile uint32_t *fb_ptr = g_framebuffer->address;
-    for (size_t i = 0; i < g_framebuffer->width * g_framebuffer->height; i++) {
-        fb_ptr[i] = BG_COLOR;
+    ds_invalidate_scanline_hashes();
+    uint32_t value = gpu_pack_pixel(BG_COLOR, &fb_format);
+    for (size_t y = 0; y < g_framebuffer->height; y++) {
+        for (size_t x = 0; x < g_framebuffer->width; x++) {
+            fb_store_pixel(g_framebuffer, (int)x, (int)y, value);
+        }
     }
     cursor_x = 0;
     cursor_y = 0;
@@ -68,35 +163,46 @@ void clear_screen(void) {
 
 // Print character to terminal
 void terminal_putchar(char c) {
+    // This draws straight to VRAM, under the display server's feet
+    ds_invalidate_scanline_hashes();
     if (c == '\n') {
         cursor_x = 0;
-        cursor_y += CHAR_HEIGHT;
-        if (cursor_y >= (int)g_framebuffer->height - CHAR_HEIGHT) {
-            cursor_y = (int)g_framebuffer->height - CHAR_HEIGHT;
+        cursor_y += cell_height;
+        if (cursor_y >= (int)g_framebuffer->height - cell_height) {
+            cursor_y = (int)g_framebuffer->height - cell_height;
             // Simple scroll: clear screen and start from top
             clear_screen();
         }
     } else if (c == '\b') {
         if (cursor_x > 0) {
-            cursor_x -= CHAR_WIDTH;
+            cursor_x -= cell_width;
             // Clear the character
-            for (int y = cursor_y; y < cursor_y + CHAR_HEIGHT; y++) {
-                for (int x = cursor_x; x < cursor_x + CHAR_WIDTH; x++) {
+            uint32_t value = gpu_pack_pixel(BG_COLOR, &fb_format);
+            for (int y = cursor_y; y < cursor_y + cell_height; y++) {
+                for (int x = cursor_x; x < cursor_x + cell_width; x++) {
                     if (x < (int)g_framebuffer->width && y < (int)g_framebuffer->height) {
-                        volatile uint32_t *fb_ptr = g_framebuffer->address;
-                        fb_ptr[y * (g_framebuffer->pitch / 4) + x] = BG_COLOR;
+                        fb_store_pixel(g_framebuffer, x, y, value);
                     }
                 }
             }
         }
     } else {
-        draw_char(g_framebuffer, c, cursor_x, cursor_y, TEXT_COLOR);
-        cursor_x += CHAR_WIDTH;
-        if (cursor_x >= (int)g_framebuffer->width - CHAR_WIDTH) {
+        // Terminal cells sit on the background colour, so draw them opaque:
+        // this never reads back from framebuffer memory
+        gpu_text_target_t target;
+        if (terminal_font != NULL && font_glyph(terminal_font, (unsigned char)c) != NULL && fb_text_target(g_framebuffer, &target)) {
+            gpu_draw_text(&target, cursor_x, cursor_y, &c, 1, terminal_font->id, font_scale,
+                          gpu_pack_pixel(TEXT_COLOR, &fb_format), gpu_pack_pixel(BG_COLOR, &fb_format),
+                          GPU_TEXT_OPAQUE);
+        } else {
+            draw_char(g_framebuffer, c, cursor_x, cursor_y, TEXT_COLOR);
+        }
+        cursor_x += cell_width;
+        if (cursor_x >= (int)g_framebuffer->width - cell_width) {
             cursor_x = 0;
-            cursor_y += CHAR_HEIGHT;
-            if (cursor_y >= (int)g_framebuffer->height - CHAR_HEIGHT) {
-                cursor_y = (int)g_framebuffer->height - CHAR_HEIGHT;
+            cursor_y += cell_height;
+            if (cursor_y >= (int)g_framebuffer->height - cell_height) {
+                cursor_y = (int)g_framebuffer->height - cell_height;
                 clear_screen();
             }
         }
@@ -110,22 +216,12 @@ void terminal_print(const char *str) {
         terminal_putchar(*str);
         str++;
         
-        // Check for mouse events every 10 characters to keep cursor responsive
+        // Gather input every 10 characters to keep the cursor responsive;
+        // frames only run while input is waiting, at the frame rate
         if (++char_count % 10 == 0) {
-            extern bool mouse_has_data(void);
-            extern void mouse_handle_interrupt(void);
-            extern void wm_handle_mouse(int mouse_x, int mouse_y, bool left_button);
-            extern void wm_update(void);
-            extern mouse_state_t* mouse_get_state(void);
-            
-            // Quick mouse check - don't do too many iterations to avoid slowing down text output
-            for (int i = 0; i < 3; i++) {
-                if (mouse_has_data()) {
-                    mouse_handle_interrupt();
-                    mouse_state_t *mouse = mouse_get_state();
-                    wm_handle_mouse(mouse->x, mouse->y, mouse->left_button);
-                    wm_update();
-                }
+            input_poll();
+            if (input_pending() > 0 && input_frame_due()) {
+                wm_update();
             }
         }
     }
@@ -137,6 +233,43 @@ void draw_pixel(int x, int y, uint32_t color) {
         return;
     }
     
-    volatile uint32_t *fb_ptr = g_framebuffer->address;
-    fb_ptr[y * (g_framebuffer->pitch / 4) + x] = color;
+    ds_invalidate_scanline_hashes();
+    fb_store_pixel(g_framebuffer, x, y, gpu_pack_pixel(color, &fb_format));
+}
+
+// Switch the terminal to a loaded font by name. Clears the screen, since the
+// cell grid changes with the font size.
+bool set_current_font(const char *font_name) {
+    const font_info_t *font = font_find(font_name);
+    if (font == NULL) {
+        return false;
+    }
+    terminal_use_font(font);
+    clear_screen();
+    return true;
+}
+
+// Print the loaded fonts, marking the terminal's current one
+void list_available_fonts(void) {
+    char num[16];
+    for (size_t i = 0; i < font_count(); i++) {
+        const font_info_t *font = font_get(i);
+        terminal_print(font == terminal_font ? "* " : "  ");
+        terminal_print(font->name);
+        terminal_print(" (");
+        int_to_string(font->width, num);
+        terminal_print(num);
+        terminal_print("x");
+        int_to_string(font->height, num);
+        terminal_print(num);
+        terminal_print(", ");
+        int_to_string(font->glyph_count, num);
+        terminal_print(num);
+        terminal_print(" glyphs)\n");
+    }
+}
+
+// Font the terminal is currently drawing with
+const font_info_t *terminal_get_font(void) {
+    return terminal_font;
 }
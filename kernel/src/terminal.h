@@ -5,6 +5,7 @@
 #include <stddef.h>
 #include <stdbool.h>
 #include <limine.h>
+#include "font.h"
 
 // Display constants
 #define CHAR_WIDTH 16
@@ -34,6 +35,7 @@ bool load_font_from_file(const char *filename, font_t *font);
 bool set_current_font(const char *font_name);
 void create_default_fonts(void);
 void list_available_fonts(void);
+const font_info_t *terminal_get_font(void);
 
 // Drawing functions
 void draw_char(struct limine_framebuffer *framebuffer, char c, int x, int y, uint32_t color);
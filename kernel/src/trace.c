@@ -0,0 +1,152 @@
+#include "trace.h"
+#include "logger.h"
+#include "tsc.h"
+#include "virtio_console.h"
+
+// Per-CPU event rings. Like the log rings each has a single producer and the
+// idle-loop flusher as its only consumer; only the BSP runs kernel code today.
+#define TRACE_MAX_CPUS  8
+#define TRACE_RING_SIZE 1024  // Events per CPU (power of two)
+
+typedef struct {
+    uint32_t head;  // Written by the producing CPU
+    uint32_t tail;  // Written by the flusher
+    uint32_t seq;
+    uint32_t lost;
+    trace_record_t records[TRACE_RING_SIZE];
+} trace_ring_t;
+
+static trace_ring_t trace_rings[TRACE_MAX_CPUS];
+static bool trace_active = false;
+
+static const char *const trace_event_names[TRACE_EVENT_COUNT] = {
+    [TRACE_WM_FRAME]      = "wm_frame",
+    [TRACE_WM_ANIMATIONS] = "wm_animations",
+    [TRACE_WM_RENDER]     = "wm_render_windows",
+    [TRACE_DS_COMPOSITE]  = "ds_composite",
+    [TRACE_DS_PRESENT]    = "ds_present",
+    [TRACE_DS_SCANOUT]    = "ds_scanout",
+    [TRACE_FS_READ]       = "fs_read",
+    [TRACE_FS_WRITE]      = "fs_write",
+    [TRACE_FS_CREATE]     = "fs_create",
+    [TRACE_FS_DELETE]     = "fs_delete",
+    [TRACE_ALLOC]         = "alloc",
+    [TRACE_LOG_FLUSH]     = "log_flush",
+    [TRACE_INPUT]         = "input",
+    [TRACE_SYSCALL]       = "syscall",
+    [TRACE_IRQ]           = "irq",
+};
+
+static inline uint32_t trace_cpu_id(void) {
+    return 0;
+}
+
+// Packets go out through a small staging buffer, one write each (to the
+// virtio-console trace port when there is one, else the UART)
+static void trace_write_packet(uint8_t type, const void *payload, uint32_t length) {
+    uint8_t packet[3 + 256];
+    const uint8_t *bytes = (const uint8_t *)payload;
+    
+    packet[0] = TRACE_MAGIC0;
+    packet[1] = TRACE_MAGIC1;
+    packet[2] = type;
+    for (uint32_t i = 0; i < length && i < 256; i++) {
+        packet[3 + i] = bytes[i];
+    }
+    logger_write_port(VIRTIO_CONSOLE_PORT_TRACE, packet, 3 + (length < 256 ? length : 256));
+}
+
+void trace_start(uint64_t tsc_hz) {
+    struct __attribute__((packed)) {
+        uint32_t version;
+        uint64_t tsc_hz;
+    } info = { TRACE_VERSION, tsc_hz };
+    trace_write_packet(TRACE_PACKET_INFO, &info, sizeof(info));
+    
+    // String table: every event name once, up front
+    for (uint32_t id = 0; id < TRACE_EVENT_COUNT; id++) {
+        uint8_t entry[3 + 64];
+        const char *name = trace_event_names[id];
+        uint8_t length = 0;
+        while (name[length] && length < 64) {
+            entry[3 + length] = (uint8_t)name[length];
+            length++;
+        }
+        entry[0] = (uint8_t)id;
+        entry[1] = (uint8_t)(id >> 8);
+        entry[2] = length;
+        trace_write_packet(TRACE_PACKET_STRING, entry, 3 + length);
+    }
+    
+    trace_active = true;
+}
+
+void trace_stop(void) {
+    trace_flush();
+    trace_active = false;
+}
+
+bool trace_enabled(void) {
+    return trace_active;
+}
+
+void trace_emit(uint32_t event, uint32_t phase, uint64_t a0, uint64_t a1, uint64_t a2) {
+    if (!trace_active) {
+        return;
+    }
+    
+    // An interrupt handler emitting in the middle of this would claim the same slot
+    uint64_t flags;
+    __asm__ volatile ("pushfq\n\tpopq %0\n\tcli" : "=r"(flags) : : "memory");
+    
+    uint32_t cpu = trace_cpu_id();
+    trace_ring_t *ring = &trace_rings[cpu];
+    uint32_t head = ring->head;
+    uint32_t seq = ring->seq++;
+    
+    // Never block the traced code: drop and let the decoder report the gap
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= TRACE_RING_SIZE) {
+        ring->lost++;
+    } else {
+    
+        trace_record_t *rec = &ring->records[head % TRACE_RING_SIZE];
+        rec->tsc = tsc_read();
+        rec->seq = seq;
+        rec->event = (uint16_t)event;
+        rec->cpu = (uint8_t)cpu;
+        rec->phase = (uint8_t)phase;
+        rec->args[0] = a0;
+        rec->args[1] = a1;
+        rec->args[2] = a2;
+        __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+    }
+    
+    if (flags & (1u << 9)) {
+        __asm__ volatile ("sti" : : : "memory");
+    }
+}
+
+void trace_flush(void) {
+    if (!trace_active) {
+        return;
+    }
+    
+    for (int cpu = 0; cpu < TRACE_MAX_CPUS; cpu++) {
+        trace_ring_t *ring = &trace_rings[cpu];
+        uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint32_t tail = ring->tail;
+        
+        while (tail != head) {
+            trace_write_packet(TRACE_PACKET_EVENT, &ring->records[tail % TRACE_RING_SIZE],
+                               sizeof(trace_record_t));
+            tail++;
+            __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+        }
+        
+        if (ring->lost > 0) {
+            uint32_t lost = ring->lost;
+            ring->lost = 0;
+            trace_write_packet(TRACE_PACKET_LOST, &lost, sizeof(lost));
+        }
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Binary event tracing
+//
+// Events are fixed-size records (timestamp, CPU, event id, phase, three u64
+// arguments) queued in a ring and streamed out by trace_flush() from the idle
+// loop, on the virtio-console trace port if there is one, else the UART.
+// tools/tracedecode turns a capture into Chrome trace JSON (chrome://tracing,
+// ui.perfetto.dev). Recording costs one flag test until trace_start() is
+// called; build with "make TRACE=1" to start at boot.
+//
+// Stream layout, little endian. Every packet starts with TRACE_MAGIC and a
+// type byte, so the decoder can skip the text log sharing the serial line:
+//   TRACE_PACKET_INFO:   u32 version, u64 tsc_hz
+//   TRACE_PACKET_STRING: u16 event id, u8 length, name bytes (once per event)
+//   TRACE_PACKET_EVENT:  trace_record_t
+//   TRACE_PACKET_LOST:   u32 events dropped because the ring was full
+
+#define TRACE_MAGIC0 0xfe
+#define TRACE_MAGIC1 0xa5
+#define TRACE_VERSION 1
+
+#define TRACE_PACKET_INFO   1
+#define TRACE_PACKET_STRING 2
+#define TRACE_PACKET_EVENT  3
+#define TRACE_PACKET_LOST   4
+
+// Event phases, using the Chrome trace "ph" letters
+#define TRACE_BEGIN   'B'
+#define TRACE_END     'E'
+#define TRACE_INSTANT 'i'
+#define TRACE_COUNTER 'C'
+
+// Event ids (the Rust crates mirror the ones they emit, must match)
+typedef enum {
+    TRACE_WM_FRAME = 0,      // wm_update(): a0 = window count
+    TRACE_WM_ANIMATIONS,     // Animation step: a0 = active animations
+    TRACE_WM_RENDER,         // Window redraws: end a0 = windows rendered
+    TRACE_DS_COMPOSITE,      // Backbuffer composition: a0 = dirty pixels
+    TRACE_DS_PRESENT,        // Backbuffer to VRAM: a0 = bytes flushed
+    TRACE_DS_SCANOUT,        // Direct scanout of a fullscreen surface
+    TRACE_FS_READ,           // a0 = bytes, a1 = success
+    TRACE_FS_WRITE,          // a0 = bytes, a1 = success
+    TRACE_FS_CREATE,         // End: a0 = success
+    TRACE_FS_DELETE,         // End: a0 = success
+    TRACE_ALLOC,             // Instant: a0 = bytes, a1 = address
+    TRACE_LOG_FLUSH,         // logger_flush(): a0 = records written
+    TRACE_INPUT,             // Instant: a0 = input events handled
+    TRACE_SYSCALL,           // syscall_handler(): begin a0 = number, a1 = arg1; end a0 = result
+    TRACE_IRQ,               // Interrupt handler: a0 = vector
+    TRACE_EVENT_COUNT
+} trace_event_t;
+
+// Event record as sent on the wire (must match tools/tracedecode.c)
+typedef struct __attribute__((packed)) {
+    uint64_t tsc;
+    uint32_t seq;       // Per-CPU sequence number, gaps mean lost events
+    uint16_t event;
+    uint8_t cpu;
+    uint8_t phase;
+    uint64_t args[3];
+} trace_record_t;
+
+// Start recording and emit the stream header (TSC frequency, string table)
+void trace_start(uint64_t tsc_hz);
+void trace_stop(void);
+bool trace_enabled(void);
+
+// Record an event; a no-op unless tracing was started. Safe to call from
+// interrupt handlers.
+void trace_emit(uint32_t event, uint32_t phase, uint64_t a0, uint64_t a1, uint64_t a2);
+
+// Write out queued events. Called from the idle loop.
+void trace_flush(void);
+
+static inline void trace_begin(uint32_t event, uint64_t a0) {
+    trace_emit(event, TRACE_BEGIN, a0, 0, 0);
+}
+
+static inline void trace_end(uint32_t event, uint64_t a0) {
+    trace_emit(event, TRACE_END, a0, 0, 0);
+}
+
+#endif // TRACE_H
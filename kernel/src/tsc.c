@@ -0,0 +1,61 @@
+#include "tsc.h"
+
+// PIT ports and frequency
+#define PIT_FREQUENCY     1193182
+#define PIT_CHANNEL2_DATA 0x42
+#define PIT_COMMAND       0x43
+#define PIT_GATE_PORT     0x61  // Bit 0: channel 2 gate, bit 1: speaker, bit 5: channel 2 output
+
+// Calibration window: 10 ms worth of PIT ticks
+#define CALIBRATION_TICKS (PIT_FREQUENCY / 100)
+
+static uint64_t tsc_hz = 0;
+
+// Port I/O functions
+static inline void outb(uint16_t port, uint8_t value) {
+    __asm__ volatile ("outb %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t value;
+    __asm__ volatile ("inb %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+uint64_t tsc_calibrate(void) {
+    uint8_t gate = inb(PIT_GATE_PORT);
+    
+    // Gate low, speaker off while programming the counter
+    outb(PIT_GATE_PORT, gate & ~0x03);
+    
+    // Channel 2, lobyte/hibyte, mode 0 (interrupt on terminal count)
+    outb(PIT_COMMAND, 0xB0);
+    outb(PIT_CHANNEL2_DATA, CALIBRATION_TICKS & 0xFF);
+    outb(PIT_CHANNEL2_DATA, (CALIBRATION_TICKS >> 8) & 0xFF);
+    
+    // Raise the gate to start counting, then wait for the output to go high
+    outb(PIT_GATE_PORT, (gate & ~0x02) | 0x01);
+    uint64_t start = tsc_read();
+    while ((inb(PIT_GATE_PORT) & 0x20) == 0) {
+        // Busy wait
+    }
+    uint64_t end = tsc_read();
+    
+    // Restore speaker/gate state
+    outb(PIT_GATE_PORT, gate);
+    
+    tsc_hz = (end - start) * PIT_FREQUENCY / CALIBRATION_TICKS;
+    return tsc_hz;
+}
+
+uint64_t tsc_get_hz(void) {
+    return tsc_hz;
+}
+
+uint64_t tsc_to_us(uint64_t cycles) {
+    if (tsc_hz == 0) {
+        return 0;
+    }
+    // Split to avoid overflowing cycles * 1000000
+    return (cycles / tsc_hz) * 1000000 + (cycles % tsc_hz) * 1000000 / tsc_hz;
+}
@@ -0,0 +1,23 @@
+#ifndef TSC_H
+#define TSC_H
+
+#include <stdint.h>
+
+// Read the CPU timestamp counter
+static inline uint64_t tsc_read(void) {
+    uint32_t low, high;
+    __asm__ volatile ("rdtsc" : "=a" (low), "=d" (high));
+    return ((uint64_t)high << 32) | low;
+}
+
+// Measure the TSC frequency against PIT channel 2 (takes about 10 ms)
+// Returns the frequency in Hz and remembers it for tsc_get_hz()
+uint64_t tsc_calibrate(void);
+
+// Get the calibrated TSC frequency in Hz (0 if tsc_calibrate() hasn't run)
+uint64_t tsc_get_hz(void);
+
+// Convert a TSC delta to microseconds (0 if not calibrated)
+uint64_t tsc_to_us(uint64_t cycles);
+
+#endif // TSC_H
@@ -0,0 +1,449 @@
+#include "virtio_console.h"
+#include "pci.h"
+#include "tsc.h"
+#include <limine.h>
+#include <stddef.h>
+
+// DMA needs physical addresses; our buffers live in the kernel image
+__attribute__((used, section(".limine_requests")))
+static volatile struct limine_executable_address_request executable_address_request = {
+    .id = LIMINE_EXECUTABLE_ADDRESS_REQUEST,
+    .revision = 0
+};
+
+#define VIRTIO_VENDOR_ID         0x1AF4
+#define VIRTIO_CONSOLE_DEVICE_ID 0x1003  // Transitional (legacy interface) console
+
+// Legacy virtio-pci registers, relative to the I/O BAR
+#define VIRTIO_REG_DEVICE_FEATURES 0x00
+#define VIRTIO_REG_GUEST_FEATURES  0x04
+#define VIRTIO_REG_QUEUE_PFN       0x08
+#define VIRTIO_REG_QUEUE_SIZE      0x0C
+#define VIRTIO_REG_QUEUE_SELECT    0x0E
+#define VIRTIO_REG_QUEUE_NOTIFY    0x10
+#define VIRTIO_REG_DEVICE_STATUS   0x12
+
+#define VIRTIO_STATUS_ACKNOWLEDGE 0x01
+#define VIRTIO_STATUS_DRIVER      0x02
+#define VIRTIO_STATUS_DRIVER_OK   0x04
+#define VIRTIO_STATUS_FAILED      0x80
+
+#define VIRTIO_CONSOLE_F_MULTIPORT (1u << 1)
+
+#define VIRTQ_DESC_F_WRITE 2  // Device writes the buffer (receive)
+
+// Control messages (virtio spec 5.3.6.2)
+#define VIRTIO_CONSOLE_DEVICE_READY  0
+#define VIRTIO_CONSOLE_DEVICE_ADD    1
+#define VIRTIO_CONSOLE_DEVICE_REMOVE 2
+#define VIRTIO_CONSOLE_PORT_READY    3
+#define VIRTIO_CONSOLE_CONSOLE_PORT  4
+#define VIRTIO_CONSOLE_PORT_OPEN     6
+
+// Queue indices: port 0 uses 0/1, the control queues are 2/3, port n > 0 uses 2n+2/2n+3
+#define CONTROL_RX_QUEUE 2
+#define CONTROL_TX_QUEUE 3
+
+#define VIRTQ_MAX_SIZE  256
+#define VIRTQ_ALIGN     4096
+#define VIRTQ_BYTES     (3 * VIRTQ_ALIGN)  // Legacy layout of a 256-entry queue
+
+#define TX_BUFFERS          8
+#define TX_BUFFER_SIZE      4096
+#define CONTROL_BUFFERS     8
+#define CONTROL_BUFFER_SIZE 128  // Room for a PORT_NAME message
+
+// How long init waits for the device to announce its ports
+#define PORT_DISCOVERY_US 50000
+
+typedef struct {
+    uint64_t addr;
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed)) virtq_desc_t;
+
+typedef struct {
+    uint16_t flags;
+    uint16_t idx;
+    uint16_t ring[];
+} __attribute__((packed)) virtq_avail_t;
+
+typedef struct {
+    uint32_t id;
+    uint32_t len;
+} __attribute__((packed)) virtq_used_elem_t;
+
+typedef struct {
+    uint16_t flags;
+    uint16_t idx;
+    virtq_used_elem_t ring[];
+} __attribute__((packed)) virtq_used_t;
+
+typedef struct {
+    uint16_t index;
+    uint16_t size;
+    uint16_t last_used;
+    bool notify_pending;
+    volatile virtq_desc_t *desc;
+    volatile virtq_avail_t *avail;
+    volatile virtq_used_t *used;
+} virtq_t;
+
+typedef struct {
+    uint32_t id;
+    uint16_t event;
+    uint16_t value;
+} __attribute__((packed)) control_msg_t;
+
+typedef struct {
+    virtq_t tx;
+    bool present;       // Announced by the device
+    bool host_open;     // Host side connected
+    bool in_flight[TX_BUFFERS];
+    int fill;           // Buffer being filled, -1 if none
+    uint32_t fill_length;
+} console_port_t;
+
+enum { QUEUE_CONTROL_RX, QUEUE_CONTROL_TX, QUEUE_PORT_TX, QUEUE_MEMORY_COUNT = QUEUE_PORT_TX + VIRTIO_CONSOLE_PORTS };
+
+static uint8_t queue_memory[QUEUE_MEMORY_COUNT][VIRTQ_BYTES] __attribute__((aligned(VIRTQ_ALIGN)));
+static uint8_t tx_buffers[VIRTIO_CONSOLE_PORTS][TX_BUFFERS][TX_BUFFER_SIZE] __attribute__((aligned(VIRTQ_ALIGN)));
+static uint8_t control_rx_buffers[CONTROL_BUFFERS][CONTROL_BUFFER_SIZE];
+static control_msg_t control_tx_buffers[CONTROL_BUFFERS];
+static bool control_tx_in_flight[CONTROL_BUFFERS];
+
+static console_port_t ports[VIRTIO_CONSOLE_PORTS];
+static virtq_t control_rx;
+static virtq_t control_tx;
+static uint16_t io_base = 0;
+static bool multiport = false;
+static bool console_ready = false;
+
+// Port I/O functions
+static inline void outb(uint16_t port, uint8_t value) {
+    __asm__ volatile ("outb %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline uint8_t inb(uint16_t port) {
+    uint8_t value;
+    __asm__ volatile ("inb %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+static inline void outw(uint16_t port, uint16_t value) {
+    __asm__ volatile ("outw %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline uint16_t inw(uint16_t port) {
+    uint16_t value;
+    __asm__ volatile ("inw %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+static inline void outl(uint16_t port, uint32_t value) {
+    __asm__ volatile ("outl %0, %1" : : "a"(value), "Nd"(port));
+}
+
+static inline uint32_t inl(uint16_t port) {
+    uint32_t value;
+    __asm__ volatile ("inl %1, %0" : "=a"(value) : "Nd"(port));
+    return value;
+}
+
+static uint64_t virt_to_phys(const void *ptr) {
+    struct limine_executable_address_response *response = executable_address_request.response;
+    return (uint64_t)ptr - response->virtual_base + response->physical_base;
+}
+
+static void zero(void *ptr, size_t length) {
+    uint8_t *bytes = (uint8_t *)ptr;
+    for (size_t i = 0; i < length; i++) {
+        bytes[i] = 0;
+    }
+}
+
+// Legacy queue layout: descriptors and available ring, then the used ring on
+// the next 4 KiB boundary. The device picks the size; we only accept up to 256.
+static bool virtq_setup(virtq_t *vq, uint16_t index, uint8_t *memory) {
+    outw(io_base + VIRTIO_REG_QUEUE_SELECT, index);
+    uint16_t size = inw(io_base + VIRTIO_REG_QUEUE_SIZE);
+    if (size == 0 || size > VIRTQ_MAX_SIZE) {
+        return false;
+    }
+    
+    zero(memory, VIRTQ_BYTES);
+    size_t used_offset = (16 * (size_t)size + 6 + 2 * (size_t)size + VIRTQ_ALIGN - 1) & ~(size_t)(VIRTQ_ALIGN - 1);
+    vq->index = index;
+    vq->size = size;
+    vq->last_used = 0;
+    vq->notify_pending = false;
+    vq->desc = (volatile virtq_desc_t *)memory;
+    vq->avail = (volatile virtq_avail_t *)(memory + 16 * (size_t)size);
+    vq->used = (volatile virtq_used_t *)(memory + used_offset);
+    
+    outl(io_base + VIRTIO_REG_QUEUE_PFN, (uint32_t)(virt_to_phys(memory) / VIRTQ_ALIGN));
+    return true;
+}
+
+// Make descriptor `id` available; the device hears about it at the next notify
+static void virtq_push(virtq_t *vq, uint16_t id, const void *buffer, uint32_t length, uint16_t flags) {
+    vq->desc[id].addr = virt_to_phys(buffer);
+    vq->desc[id].len = length;
+    vq->desc[id].flags = flags;
+    vq->desc[id].next = 0;
+    
+    uint16_t avail_idx = vq->avail->idx;
+    vq->avail->ring[avail_idx % vq->size] = id;
+    __asm__ volatile ("" ::: "memory");
+    vq->avail->idx = avail_idx + 1;
+    vq->notify_pending = true;
+}
+
+static void virtq_notify(virtq_t *vq) {
+    if (!vq->notify_pending) {
+        return;
+    }
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    outw(io_base + VIRTIO_REG_QUEUE_NOTIFY, vq->index);
+    vq->notify_pending = false;
+}
+
+// Next completed descriptor id, or -1
+static int virtq_pop_used(virtq_t *vq, uint32_t *length) {
+    if (vq->last_used == vq->used->idx) {
+        return -1;
+    }
+    __asm__ volatile ("" ::: "memory");
+    volatile virtq_used_elem_t *elem = &vq->used->ring[vq->last_used % vq->size];
+    if (length) {
+        *length = elem->len;
+    }
+    vq->last_used++;
+    return (int)elem->id;
+}
+
+static void control_send(uint32_t id, uint16_t event, uint16_t value) {
+    int slot;
+    while (1) {
+        int done;
+        while ((done = virtq_pop_used(&control_tx, NULL)) >= 0) {
+            control_tx_in_flight[done] = false;
+        }
+        for (slot = 0; slot < CONTROL_BUFFERS && control_tx_in_flight[slot]; slot++) {
+        }
+        if (slot < CONTROL_BUFFERS) {
+            break;
+        }
+        virtq_notify(&control_tx);
+    }
+    
+    control_tx_buffers[slot].id = id;
+    control_tx_buffers[slot].event = event;
+    control_tx_buffers[slot].value = value;
+    control_tx_in_flight[slot] = true;
+    virtq_push(&control_tx, (uint16_t)slot, &control_tx_buffers[slot], sizeof(control_msg_t), 0);
+    virtq_notify(&control_tx);
+}
+
+// Handle device-to-driver control messages; returns how many were processed
+static int control_poll(void) {
+    int handled = 0;
+    uint32_t length;
+    int slot;
+    
+    while ((slot = virtq_pop_used(&control_rx, &length)) >= 0) {
+        handled++;
+        if (length >= sizeof(control_msg_t)) {
+            control_msg_t *msg = (control_msg_t *)control_rx_buffers[slot];
+            if (msg->id < VIRTIO_CONSOLE_PORTS) {
+                console_port_t *port = &ports[msg->id];
+                switch (msg->event) {
+                    case VIRTIO_CONSOLE_DEVICE_ADD:
+                        port->present = port->tx.size != 0;
+                        control_send(msg->id, VIRTIO_CONSOLE_PORT_READY, port->present);
+                        break;
+                    case VIRTIO_CONSOLE_DEVICE_REMOVE:
+                        port->present = false;
+                        port->host_open = false;
+                        break;
+                    case VIRTIO_CONSOLE_CONSOLE_PORT:
+                        control_send(msg->id, VIRTIO_CONSOLE_PORT_OPEN, 1);
+                        break;
+                    case VIRTIO_CONSOLE_PORT_OPEN:
+                        port->host_open = msg->value != 0;
+                        break;
+                    default:
+                        break;  // Names, resizes: nothing to do for output-only ports
+                }
+            }
+        }
+        virtq_push(&control_rx, (uint16_t)slot, control_rx_buffers[slot], CONTROL_BUFFER_SIZE, VIRTQ_DESC_F_WRITE);
+    }
+    virtq_notify(&control_rx);
+    return handled;
+}
+
+static uint16_t port_tx_queue(uint32_t port) {
+    return port == 0 ? 1 : (uint16_t)(2 * port + 3);
+}
+
+bool virtio_console_init(void) {
+    struct pci_device *dev = pci_find_device(VIRTIO_VENDOR_ID, VIRTIO_CONSOLE_DEVICE_ID);
+    if (!dev || !(dev->bar0 & 1) || !executable_address_request.response) {
+        return false;
+    }
+    io_base = (uint16_t)(dev->bar0 & ~0x3u);
+    
+    // I/O decoding and bus mastering (the device DMAs from our buffers)
+    uint32_t command = pci_read_config(dev->bus, dev->device, dev->function, PCI_CONFIG_COMMAND);
+    pci_write_config(dev->bus, dev->device, dev->function, PCI_CONFIG_COMMAND, (command & 0xFFFF) | 0x05);
+    
+    outb(io_base + VIRTIO_REG_DEVICE_STATUS, 0);
+    outb(io_base + VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_ACKNOWLEDGE);
+    outb(io_base + VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+    
+    uint32_t features = inl(io_base + VIRTIO_REG_DEVICE_FEATURES);
+    multiport = (features & VIRTIO_CONSOLE_F_MULTIPORT) != 0;
+    outl(io_base + VIRTIO_REG_GUEST_FEATURES, features & VIRTIO_CONSOLE_F_MULTIPORT);
+    
+    for (uint32_t i = 0; i < VIRTIO_CONSOLE_PORTS; i++) {
+        zero(&ports[i], sizeof(ports[i]));
+        ports[i].fill = -1;
+        if (i > 0 && !multiport) {
+            continue;
+        }
+        if (!virtq_setup(&ports[i].tx, port_tx_queue(i), queue_memory[QUEUE_PORT_TX + i])) {
+            ports[i].tx.size = 0;
+        }
+    }
+    
+    if (multiport && (!virtq_setup(&control_rx, CONTROL_RX_QUEUE, queue_memory[QUEUE_CONTROL_RX]) ||
+                      !virtq_setup(&control_tx, CONTROL_TX_QUEUE, queue_memory[QUEUE_CONTROL_TX]))) {
+        outb(io_base + VIRTIO_REG_DEVICE_STATUS, VIRTIO_STATUS_FAILED);
+        return false;
+    }
+    
+    outb(io_base + VIRTIO_REG_DEVICE_STATUS,
+         VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+    
+    if (!multiport) {
+        // Single-port device: port 0 always exists and is always connected
+        ports[0].present = ports[0].tx.size != 0;
+        ports[0].host_open = ports[0].present;
+        console_ready = ports[0].present;
+        return console_ready;
+    }
+    
+    for (uint16_t i = 0; i < CONTROL_BUFFERS && i < control_rx.size; i++) {
+        virtq_push(&control_rx, i, control_rx_buffers[i], CONTROL_BUFFER_SIZE, VIRTQ_DESC_F_WRITE);
+    }
+    virtq_notify(&control_rx);
+    control_send(0xFFFFFFFF, VIRTIO_CONSOLE_DEVICE_READY, 1);
+    
+    // The device answers with DEVICE_ADD/PORT_OPEN for every port it has;
+    // give it a moment so early logs already go to the right place
+    console_ready = true;
+    uint64_t hz = tsc_get_hz();
+    uint64_t deadline = tsc_read() + (hz ? hz / 1000000 * PORT_DISCOVERY_US : 100000000);
+    while (tsc_read() < deadline) {
+        control_poll();
+        
+        bool all_open = true;
+        for (uint32_t i = 0; i < VIRTIO_CONSOLE_PORTS; i++) {
+            all_open = all_open && virtio_console_port_ready(i);
+        }
+        if (all_open) {
+            break;
+        }
+    }
+    
+    return true;
+}
+
+bool virtio_console_port_ready(uint32_t port) {
+    return console_ready && port < VIRTIO_CONSOLE_PORTS && ports[port].present && ports[port].host_open;
+}
+
+static void port_reclaim(console_port_t *port) {
+    int done;
+    while ((done = virtq_pop_used(&port->tx, NULL)) >= 0) {
+        if (done < TX_BUFFERS) {
+            port->in_flight[done] = false;
+        }
+    }
+}
+
+// Hand the buffer being filled to the device (without notifying it yet)
+static void port_submit(console_port_t *port, uint32_t port_index) {
+    if (port->fill < 0 || port->fill_length == 0) {
+        return;
+    }
+    virtq_push(&port->tx, (uint16_t)port->fill, tx_buffers[port_index][port->fill], port->fill_length, 0);
+    port->in_flight[port->fill] = true;
+    port->fill = -1;
+    port->fill_length = 0;
+}
+
+bool virtio_console_write(uint32_t port_index, const void *data, uint32_t length) {
+    if (!virtio_console_port_ready(port_index)) {
+        return false;
+    }
+    
+    console_port_t *port = &ports[port_index];
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint32_t buffers = port->tx.size < TX_BUFFERS ? port->tx.size : TX_BUFFERS;
+    
+    while (length > 0) {
+        if (port->fill < 0) {
+            // All buffers queued: kick the device and wait for one to come back
+            while (1) {
+                port_reclaim(port);
+                uint32_t i;
+                for (i = 0; i < buffers && port->in_flight[i]; i++) {
+                }
+                if (i < buffers) {
+                    port->fill = (int)i;
+                    break;
+                }
+                virtq_notify(&port->tx);
+            }
+        }
+        
+        uint32_t chunk = TX_BUFFER_SIZE - port->fill_length;
+        if (chunk > length) {
+            chunk = length;
+        }
+        uint8_t *dst = &tx_buffers[port_index][port->fill][port->fill_length];
+        for (uint32_t i = 0; i < chunk; i++) {
+            dst[i] = bytes[i];
+        }
+        port->fill_length += chunk;
+        bytes += chunk;
+        length -= chunk;
+        
+        if (port->fill_length == TX_BUFFER_SIZE) {
+            port_submit(port, port_index);
+        }
+    }
+    return true;
+}
+
+void virtio_console_flush(void) {
+    if (!console_ready) {
+        return;
+    }
+    if (multiport) {
+        control_poll();
+    }
+    
+    for (uint32_t i = 0; i < VIRTIO_CONSOLE_PORTS; i++) {
+        console_port_t *port = &ports[i];
+        if (!port->present) {
+            continue;
+        }
+        port_submit(port, i);
+        virtq_notify(&port->tx);
+        port_reclaim(port);
+    }
+}
@@ -0,0 +1,41 @@
+#ifndef VIRTIO_CONSOLE_H
+#define VIRTIO_CONSOLE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// virtio-console (virtio-serial) output channels
+//
+// With a virtio-serial-pci device, logs, traces, frame captures and profiles
+// stream out through their own ports at memory speed instead of 115200 baud.
+// Writes are copied into page-sized DMA buffers that are handed to the device
+// in batches (one notify per flush). Ports the host didn't create or connect report
+// not-ready, and callers fall back to the UART.
+//
+// QEMU: -device virtio-serial-pci
+//       -device virtconsole,chardev=log       -chardev file,id=log,path=...
+//       -device virtserialport,nr=1,chardev=trace -chardev file,id=trace,path=...
+//       -device virtserialport,nr=2,chardev=frames -chardev file,id=frames,path=...
+//       -device virtserialport,nr=3,chardev=prof -chardev file,id=prof,path=...
+
+#define VIRTIO_CONSOLE_PORT_LOG     0  // Kernel log text (virtconsole)
+#define VIRTIO_CONSOLE_PORT_TRACE   1  // Binary trace stream (trace.h)
+#define VIRTIO_CONSOLE_PORT_FRAMES  2  // Headless frame capture
+#define VIRTIO_CONSOLE_PORT_PROFILE 3  // Folded profiler stacks (profiler.h)
+#define VIRTIO_CONSOLE_PORTS        4
+
+// Find and start the device (after pci_enumerate). Returns false if absent.
+bool virtio_console_init(void);
+
+// True when the host has this port open
+bool virtio_console_port_ready(uint32_t port);
+
+// Queue bytes for a port. Returns false (nothing written) if the port isn't
+// ready, so the caller can use the UART instead.
+bool virtio_console_write(uint32_t port, const void *data, uint32_t length);
+
+// Hand partially filled buffers to the device, notify it once and handle
+// control messages. Called from the idle loop.
+void virtio_console_flush(void);
+
+#endif // VIRTIO_CONSOLE_H
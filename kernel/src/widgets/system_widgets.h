@@ -25,13 +25,13 @@ typedef enum {
 #define WIDGET_CPU_BAR_HIGH_COLOR 0xFF8800
 #define WIDGET_CPU_BAR_BUSY_COLOR 0xFF0000
 
-// Widget dimensions
+// Widget dimensions (heights include the 20px window title bar)
 #define WIDGET_RAM_WIDTH          200
-#define WIDGET_RAM_HEIGHT         120
+#define WIDGET_RAM_HEIGHT         140
 #define WIDGET_CPU_WIDTH          200
-#define WIDGET_CPU_HEIGHT         120
+#define WIDGET_CPU_HEIGHT         140
 #define WIDGET_SYSTEM_WIDTH       250
-#define WIDGET_SYSTEM_HEIGHT      150
+#define WIDGET_SYSTEM_HEIGHT      170
 
 // Widget refresh rate (in update cycles) - lower = more frequent updates
 #define WIDGET_REFRESH_RATE       3
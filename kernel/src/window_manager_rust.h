@@ -33,22 +33,55 @@ typedef struct window {
     int32_t orig_y;   // Original y position before maximize
     uint32_t orig_width;   // Original width before maximize/resize
     uint32_t orig_height;  // Original height before maximize/resize
+    bool decor_valid;          // Title bar strip in the buffer holds current decorations
+    bool decor_focused;        // Focus state the decorations were rendered with
+    bool decor_maximized;      // Maximize state the decorations were rendered with
+    uint32_t decor_width;      // Window size the buffer contents were laid out for
+    uint32_t decor_height;
+    uint32_t decor_title_hash; // Hash of the title the decorations were rendered with
 } window_t;
 
+// Height of the title bar drawn (and cached) by the window manager
+#define WM_TITLE_BAR_HEIGHT 20
+
 // Window manager functions
 void wm_init(struct limine_framebuffer *framebuffer);
 window_t* wm_create_window(const char *title, int x, int y, uint32_t width, uint32_t height, uint32_t flags);
 void wm_destroy_window(window_t *window);
 void wm_invalidate_window(window_t *window);
+
+// Client drawing: coordinates are relative to the content area below the title bar
+// and clipped to it. Draw callbacks own the content area and must clear it themselves.
+void wm_get_content_size(window_t *window, uint32_t *width, uint32_t *height);
 void wm_clear_window(window_t *window, uint32_t color);
 void wm_draw_pixel_to_window(window_t *window, int x, int y, uint32_t color);
 void wm_draw_filled_rect_to_window(window_t *window, int x, int y, uint32_t width, uint32_t height, uint32_t color);
 void wm_draw_rect_to_window(window_t *window, int x, int y, uint32_t width, uint32_t height, uint32_t color);
 void wm_draw_text_to_window(window_t *window, const char *text, int x, int y, uint32_t color);
 void wm_handle_mouse(int mouse_x, int mouse_y, bool left_button);
+// Run one frame: drain the input queue (see input.h), step animations, then render
 void wm_update(void);
+// True when a frame has work to do (running animation, invalidated window, undrawn damage)
+bool wm_frame_pending(void);
+// Format and log trace records the window manager buffered (see trace! in wm_rust)
+void wm_trace_flush(void);
+
+// Animations are stepped once per frame by wm_update() from the frame clock.
+// The callback gets the frame time and the time since the previous frame in
+// microseconds; returning false stops it. The window is redrawn after each step.
+// All functions return an animation id, or 0 on failure (table full, bad window).
+typedef bool (*wm_animation_callback_t)(window_t *window, void *user_data, uint64_t now_us, uint64_t delta_us);
+uint32_t wm_animate(window_t *window, wm_animation_callback_t callback, void *user_data);
+// Ease-out tweens of the window rectangle; a new tween replaces a running one of the same kind
+uint32_t wm_animate_window_move(window_t *window, int x, int y, uint32_t duration_ms);
+uint32_t wm_animate_window_resize(window_t *window, uint32_t width, uint32_t height, uint32_t duration_ms);
+void wm_animation_stop(uint32_t id);
 int wm_get_window_count(void);
 void wm_get_window_info(int index, int *x, int *y, int *w, int *h, char *title);
 void wm_bring_to_front(window_t *window);
 
+// Preview of a minimized window: its last frame box-filtered to fit 160x120
+// (XRGB8888, pitch = width). Returns NULL if the window isn't minimized.
+const uint32_t* wm_get_thumbnail(window_t *window, uint32_t *width, uint32_t *height);
+
 #endif // WINDOW_MANAGER_RUST_H
@@ -1,7 +1,9 @@
-#![no_std]
-#![no_main]
+// The "host" feature builds a std library for the benchmarks in host_bench
+#![cfg_attr(not(feature = "host"), no_std)]
+#![cfg_attr(not(feature = "host"), no_main)]
 
 // Panic handler for bare metal
+#[cfg(not(feature = "host"))]
 #[panic_handler]
 fn panic(_info: &core::panic::PanicInfo) -> ! {
     loop {}
@@ -9,45 +11,114 @@ fn panic(_info: &core::panic::PanicInfo) -> ! {
 
 use core::ptr;
 use core::ffi::{c_char, c_int, c_void};
+use core::arch::x86_64::_rdtsc;
 
-// Helper function for logging (simplified - just pass static strings)
-#[inline(always)]
-unsafe fn log_debug(msg: &[u8]) {
-    let mut buf = [0u8; 256];
-    let mut i = 0;
-    for &b in msg.iter().take(255) {
-        buf[i] = b;
-        i += 1;
-        if b == 0 { break; }
-    }
-    if i < 255 { buf[i] = 0; }
-    logger_rust_log(0, b"WM\0".as_ptr() as *const c_char, buf.as_ptr() as *const c_char);
+// Tracing
+//
+// trace!() does not format anything inline: an enabled record is stored in a
+// binary ring (level, static format string, up to eight integer or
+// pointer arguments) and formatted later by wm_trace_flush(), outside the
+// compositor path. Levels below TRACE_LEVEL compile to nothing, arguments
+// included. Release builds keep warnings and errors; the trace-info and
+// trace-debug cargo features enable the chattier levels.
+const LEVEL_DEBUG: u32 = 0;
+const LEVEL_INFO: u32 = 1;
+const LEVEL_WARN: u32 = 2;
+const LEVEL_ERROR: u32 = 3;
+
+const TRACE_LEVEL: u32 = if cfg!(feature = "trace-debug") {
+    LEVEL_DEBUG
+} else if cfg!(feature = "trace-info") {
+    LEVEL_INFO
+} else {
+    LEVEL_WARN
+};
+
+const TRACE_MAX_ARGS: usize = 8;
+const TRACE_RING_SIZE: usize = 256;
+
+#[derive(Clone, Copy)]
+#[cfg_attr(feature = "host", allow(dead_code))]  // Host builds drop records unformatted
+struct TraceRecord {
+    level: u32,
+    format: *const u8,  // NUL-terminated, static
+    args: [u64; TRACE_MAX_ARGS],
+}
+
+static mut TRACE_RING: [TraceRecord; TRACE_RING_SIZE] = [TraceRecord {
+    level: 0,
+    format: ptr::null(),
+    args: [0; TRACE_MAX_ARGS],
+}; TRACE_RING_SIZE];
+static mut TRACE_HEAD: usize = 0;     // Records ever written
+static mut TRACE_FLUSHED: usize = 0;  // Records already handed to the logger
+
+macro_rules! trace {
+    ($level:expr, $fmt:literal $(, $arg:expr)* $(,)?) => {
+        if $level >= TRACE_LEVEL {
+            trace_record($level, concat!($fmt, "\0").as_ptr(), &[$(($arg) as u64),*]);
+        }
+    };
+}
+
+fn trace_record(level: u32, format: *const u8, args: &[u64]) {
+    unsafe {
+        let mut record = TraceRecord {
+            level,
+            format,
+            args: [0; TRACE_MAX_ARGS],
+        };
+        for (slot, &arg) in record.args.iter_mut().zip(args.iter()) {
+            *slot = arg;
+        }
+        
+        let ring = &mut *ptr::addr_of_mut!(TRACE_RING);
+        ring[TRACE_HEAD % TRACE_RING_SIZE] = record;
+        TRACE_HEAD = TRACE_HEAD.wrapping_add(1);
+    }
+    
+    // Errors are rare and wanted right away
+    if level >= LEVEL_ERROR {
+        wm_trace_flush();
+    }
 }
 
-#[inline(always)]
-unsafe fn log_info(msg: &[u8]) {
-    let mut buf = [0u8; 256];
-    let mut i = 0;
-    for &b in msg.iter().take(255) {
-        buf[i] = b;
-        i += 1;
-        if b == 0 { break; }
-    }
-    if i < 255 { buf[i] = 0; }
-    logger_rust_log(1, b"WM\0".as_ptr() as *const c_char, buf.as_ptr() as *const c_char);
+// Format and log every record not flushed yet. Called when the shell is idle.
+#[cfg(not(feature = "host"))]
+#[no_mangle]
+pub extern "C" fn wm_trace_flush() {
+    unsafe {
+        if TRACE_FLUSHED == TRACE_HEAD {
+            return;
+        }
+        
+        // The ring overwrote records nobody flushed in time
+        let oldest = TRACE_HEAD.saturating_sub(TRACE_RING_SIZE);
+        if TRACE_FLUSHED < oldest {
+            logger_rust_log_fmt(LEVEL_WARN, b"WM\0".as_ptr() as *const c_char,
+                b"trace: %u records dropped\0".as_ptr() as *const c_char,
+                (oldest - TRACE_FLUSHED) as u32);
+            TRACE_FLUSHED = oldest;
+        }
+        
+        let ring = &*ptr::addr_of!(TRACE_RING);
+        while TRACE_FLUSHED != TRACE_HEAD {
+            let r = ring[TRACE_FLUSHED % TRACE_RING_SIZE];
+            TRACE_FLUSHED = TRACE_FLUSHED.wrapping_add(1);
+            // Unused trailing arguments are simply not consumed by the format
+            logger_rust_log_fmt(r.level, b"WM\0".as_ptr() as *const c_char, r.format as *const c_char,
+                r.args[0], r.args[1], r.args[2], r.args[3], r.args[4], r.args[5], r.args[6], r.args[7]);
+        }
+    }
 }
 
-#[inline(always)]
-unsafe fn log_error(msg: &[u8]) {
-    let mut buf = [0u8; 256];
-    let mut i = 0;
-    for &b in msg.iter().take(255) {
-        buf[i] = b;
-        i += 1;
-        if b == 0 { break; }
-    }
-    if i < 255 { buf[i] = 0; }
-    logger_rust_log(3, b"WM\0".as_ptr() as *const c_char, buf.as_ptr() as *const c_char);
+// Host builds have no kernel logger (its entry point is variadic): drop records
+#[cfg(feature = "host")]
+#[no_mangle]
+pub extern "C" fn wm_trace_flush() {
+    unsafe {
+        TRACE_FLUSHED = TRACE_HEAD;
+    }
 }
 
 // Surface structure (must match display server definition)
@@ -68,16 +139,88 @@ extern "C" {
     fn ds_destroy_surface(surface: *mut Surface);
     fn ds_set_surface_position(surface: *mut Surface, x: c_int, y: c_int);
     fn ds_set_surface_z_order(surface: *mut Surface, z_order: c_int);
-    fn ds_set_surface_size(surface: *mut Surface, width: u32, height: u32);
+    fn ds_set_surface_size(surface: *mut Surface, width: u32, height: u32) -> bool;
+    fn ds_get_surface_capacity(surface: *mut Surface) -> u32;
     fn ds_get_surface_buffer(surface: *mut Surface) -> *mut u32;
     fn ds_mark_dirty(x: c_int, y: c_int, width: u32, height: u32);
     fn ds_update_cursor_position(x: c_int, y: c_int);
     fn ds_render();
+    fn ds_get_scale() -> u32;
+    fn ds_get_screen_size(width: *mut u32, height: *mut u32);
+    fn ds_has_damage() -> bool;
+    fn ds_set_surface_visible(surface: *mut Surface, visible: bool);
+    fn ds_set_outline(x: c_int, y: c_int, width: u32, height: u32);
+    fn ds_clear_outline();
+}
+
+// External TSC functions (tsc.c); the frame clock is derived from them
+extern "C" {
+    fn tsc_to_us(cycles: u64) -> u64;
+}
+
+// Text destination for the shared text engine (must match gpu_rust definition)
+#[repr(C)]
+pub struct GpuTextTarget {
+    pub buffer: *mut u32,
+    pub pitch: u32,
+    pub clip_x: i32,
+    pub clip_y: i32,
+    pub clip_width: u32,
+    pub clip_height: u32,
+}
+
+// Font 0 is the built-in 8x8 font registered by the terminal at boot
+const SYSTEM_FONT: i32 = 0;
+
+// External text engine functions
+extern "C" {
+    fn gpu_draw_text(target: *const GpuTextTarget, x: c_int, y: c_int, text: *const u8, len: u32,
+                     font: i32, scale: u32, color: u32, background: u32, flags: u32) -> u32;
+    fn gpu_downscale_box(dst: *mut u32, dst_pitch: u32, src: *const u32,
+                         src_width: u32, src_height: u32, src_pitch: u32, factor: u32) -> bool;
+}
+
+// Kernel input event (must match input_event_t in input.h)
+#[repr(C)]
+pub struct InputEvent {
+    pub kind: u8,
+    pub buttons: u8,
+    pub key: u8,
+    pub scancode: u8,
+    pub x: i32,
+    pub y: i32,
+    pub wheel: i32,
+    pub timestamp: u64,
 }
 
+const INPUT_EVENT_KEY: u8 = 1;
+const INPUT_EVENT_MOTION: u8 = 2;
+const INPUT_EVENT_BUTTON: u8 = 3;
+const MOUSE_LEFT_BUTTON: u8 = 0x01;
+
+// External input functions
+extern "C" {
+    fn input_pop(event: *mut InputEvent) -> bool;
+    fn keyboard_deliver(c: c_char);
+}
+
+// External binary trace functions (see trace.h)
+extern "C" {
+    fn trace_emit(event: u32, phase: u32, a0: u64, a1: u64, a2: u64);
+}
+
+// Trace event ids and phases (must match trace.h)
+const TRACE_WM_FRAME: u32 = 0;
+const TRACE_WM_ANIMATIONS: u32 = 1;
+const TRACE_WM_RENDER: u32 = 2;
+const TRACE_INPUT: u32 = 12;
+const TRACE_BEGIN: u32 = b'B' as u32;
+const TRACE_END: u32 = b'E' as u32;
+const TRACE_INSTANT: u32 = b'i' as u32;
+
 // External logger functions
+#[cfg(not(feature = "host"))]
 extern "C" {
-    fn logger_rust_log(level: u32, module: *const c_char, message: *const c_char);
     fn logger_rust_log_fmt(level: u32, module: *const c_char, format: *const c_char, ...);
 }
 
@@ -131,14 +274,125 @@ pub struct Window {
     pub orig_y: i32,       // Original y position before maximize
     pub orig_width: u32,   // Original width before maximize/resize
     pub orig_height: u32,  // Original height before maximize/resize
+    pub decor_valid: bool,      // Title bar strip in the buffer holds current decorations
+    pub decor_focused: bool,    // Focus state the decorations were rendered with
+    pub decor_maximized: bool,  // Maximize state the decorations were rendered with
+    pub decor_width: u32,       // Window size the buffer contents were laid out for
+    pub decor_height: u32,
+    pub decor_title_hash: u32,  // Hash of the title the decorations were rendered with
 }
 
+// Height of the title bar strip; client content lives below it
+const TITLE_BAR_HEIGHT: u32 = 20;
+
+// Default window background
+const WINDOW_BACKGROUND: u32 = 0x2d2d2d;
+
+// Largest surface a display server pool slot holds (800x600); only a
+// maximized window may get more, from the single scanout buffer
+const MAX_SURFACE_PIXELS: usize = 800 * 600;
+
 // Window manager state
 static mut WM_STATE: Option<WindowManager> = None;
 
 // Window pool for static allocation
 static mut WINDOW_POOL: [Option<Window>; 32] = [const { None }; 32];
 
+// Thumbnails of minimized windows: the last frame box-filtered down to fit
+// THUMBNAIL_MAX_WIDTH x THUMBNAIL_MAX_HEIGHT. Only a few windows are minimized
+// at once, so they share a small pool; when it is full, minimizing another
+// window takes the least recently used thumbnail (that window shows none).
+const THUMBNAIL_MAX_WIDTH: u32 = 160;
+const THUMBNAIL_MAX_HEIGHT: u32 = 120;
+const THUMBNAIL_PIXELS: usize = (THUMBNAIL_MAX_WIDTH * THUMBNAIL_MAX_HEIGHT) as usize;
+const THUMBNAIL_SLOTS: usize = 4;
+
+#[derive(Clone, Copy)]
+struct Thumbnail {
+    window_slot: usize,  // Window pool slot of the owner
+    width: u32,
+    height: u32,
+    last_used: u32,
+}
+
+static mut THUMBNAIL_POOL: [[u32; THUMBNAIL_PIXELS]; THUMBNAIL_SLOTS] = [[0; THUMBNAIL_PIXELS]; THUMBNAIL_SLOTS];
+static mut THUMBNAILS: [Option<Thumbnail>; THUMBNAIL_SLOTS] = [None; THUMBNAIL_SLOTS];
+static mut THUMBNAIL_CLOCK: u32 = 0;
+
+// Hit-testing grid: 64x64 logical pixel cells covering 4096x4096. Each cell
+// holds a bitmask of the window pool slots overlapping it (32 slots, so a u32);
+// coordinates outside the grid fall into the edge cells.
+const HIT_CELL_SHIFT: i32 = 6;
+const HIT_GRID_SIZE: usize = 64;
+
+struct HitGrid {
+    cells: [[u32; HIT_GRID_SIZE]; HIT_GRID_SIZE],
+    spans: [Option<(usize, usize, usize, usize)>; 32], // Cell range (col0, row0, col1, row1) per slot
+}
+
+static mut HIT_GRID: HitGrid = HitGrid {
+    cells: [[0; HIT_GRID_SIZE]; HIT_GRID_SIZE],
+    spans: [None; 32],
+};
+
+fn hit_cell(coord: i32) -> usize {
+    (coord.max(0) >> HIT_CELL_SHIFT).min(HIT_GRID_SIZE as i32 - 1) as usize
+}
+
+// Remove a window pool slot from every cell it was registered in
+unsafe fn unindex_slot(slot: usize) {
+    if let Some((col0, row0, col1, row1)) = HIT_GRID.spans[slot] {
+        let bit = !(1u32 << slot);
+        for row in row0..=row1 {
+            for col in col0..=col1 {
+                HIT_GRID.cells[row][col] &= bit;
+            }
+        }
+        HIT_GRID.spans[slot] = None;
+    }
+}
+
+// Animation callback: window, user data, frame time and time since the previous
+// frame (both in microseconds). Return false to stop the animation.
+pub type AnimationCallback = extern "C" fn(*mut Window, *mut c_void, u64, u64) -> bool;
+
+const MAX_ANIMATIONS: usize = 16;
+
+// Frame delta used when the TSC is not calibrated (nominal 60 Hz)
+const FALLBACK_FRAME_US: u64 = 16667;
+
+// Longest step a single frame may advance the clock, so animations don't
+// jump after the shell has been busy for a while
+const MAX_FRAME_DELTA_US: u64 = 100000;
+
+#[derive(Clone, Copy)]
+enum AnimationKind {
+    // Runs every frame until the callback returns false
+    Callback(AnimationCallback, *mut c_void),
+    // Tweens the window rectangle from one value to another
+    Move { from_x: i32, from_y: i32, to_x: i32, to_y: i32 },
+    Resize { from_width: u32, from_height: u32, to_width: u32, to_height: u32 },
+}
+
+#[derive(Clone, Copy)]
+struct Animation {
+    id: u32,
+    window: *mut Window,
+    kind: AnimationKind,
+    start_us: u64,
+    duration_us: u64,
+}
+
+// Ease-out cubic on 16.16 fixed point: fast start, gentle landing
+fn ease_out(t: i64) -> i64 {
+    let inv = 65536 - t;
+    65536 - ((inv * inv) >> 16) * inv / 65536
+}
+
+fn tween(from: i64, to: i64, eased: i64) -> i64 {
+    from + (to - from) * eased / 65536
+}
+
 // Resize edge types
 #[derive(Clone, Copy, PartialEq)]
 enum ResizeEdge {
@@ -167,9 +421,15 @@ struct WindowManager {
     resize_start_y: i32,
     resize_start_width: u32,
     resize_start_height: u32,
+    resize_preview: (i32, i32, u32, u32),  // Outlined rectangle the resize will commit to
     last_mouse_button: bool,
     next_z_order: i32,  // Next z-order value to assign
     min_z_order: i32,   // Minimum z-order for minimized windows
+    animations: [Option<Animation>; MAX_ANIMATIONS],
+    next_animation_id: u32,
+    frame_time_us: u64,   // Frame clock: advanced once per update()
+    frame_delta_us: u64,  // Time covered by the current frame
+    last_frame_tsc: u64,
 }
 
 impl WindowManager {
@@ -188,9 +448,15 @@ impl WindowManager {
             resize_start_y: 0,
             resize_start_width: 0,
             resize_start_height: 0,
+            resize_preview: (0, 0, 0, 0),
             last_mouse_button: false,
             next_z_order: 0,
             min_z_order: -1000, // Z-order for minimized windows
+            animations: [None; MAX_ANIMATIONS],
+            next_animation_id: 1,
+            frame_time_us: 0,
+            frame_delta_us: 0,
+            last_frame_tsc: 0,
         }
     }
 
@@ -198,6 +464,25 @@ impl WindowManager {
         self.framebuffer
     }
 
+    // Screen size in logical pixels (the display server upscales on HiDPI screens)
+    fn screen_size(&self) -> (u32, u32) {
+        let mut width: u32 = 0;
+        let mut height: u32 = 0;
+        unsafe {
+            ds_get_screen_size(&mut width, &mut height);
+            
+            // Display server not up yet: fall back to the raw framebuffer
+            if width == 0 || height == 0 {
+                let fb = self.get_framebuffer();
+                if !fb.is_null() {
+                    width = (*fb).width as u32;
+                    height = (*fb).height as u32;
+                }
+            }
+        }
+        (width, height)
+    }
+
     fn bring_to_front(&mut self, window: *mut Window) {
         // Find window index
         let mut idx = None;
@@ -224,6 +509,7 @@ impl WindowManager {
                     (*w).z_order = self.next_z_order;
                     self.next_z_order += 1;
                     ds_set_surface_z_order((*w).surface, (*w).z_order);
+                    self.index_window(w);
                     (*w).invalidated = true;
                     ds_mark_dirty((*w).x, (*w).y, (*w).width, (*w).height);
                 }
@@ -288,6 +574,12 @@ impl WindowManager {
                 orig_y: y,
                 orig_width: width,
                 orig_height: height,
+                decor_valid: false,
+                decor_focused: false,
+                decor_maximized: false,
+                decor_width: width,
+                decor_height: height,
+                decor_title_hash: 0,
             };
             
             // Copy title
@@ -306,6 +598,9 @@ impl WindowManager {
             WINDOW_POOL[slot] = Some(new_window);
             let window_ptr = WINDOW_POOL[slot].as_mut().unwrap() as *mut Window;
             
+            // Start with an empty content area; decorations are drawn on first update
+            self.clear_window(window_ptr, WINDOW_BACKGROUND);
+            
             window_ptr
         };
 
@@ -322,6 +617,8 @@ impl WindowManager {
     }
 
     fn destroy_window(&mut self, window: *mut Window) {
+        self.stop_window_animations(window);
+        
         unsafe {
             // Mark window area as dirty
             ds_mark_dirty((*window).x, (*window).y, (*window).width, (*window).height);
@@ -334,6 +631,8 @@ impl WindowManager {
         unsafe {
             let window_id = (*window).id as usize;
             if window_id < 32 {
+                unindex_slot(window_id);
+                release_thumbnail(window_id);
                 WINDOW_POOL[window_id] = None;
             }
         }
@@ -373,7 +672,12 @@ impl WindowManager {
                 return; // Already minimized
             }
             
+            // Keep a preview of the last frame, then stop compositing the full surface
+            capture_thumbnail(window);
+            ds_set_surface_visible((*window).surface, false);
+            
             (*window).minimized = true;
+            self.index_window(window); // Minimized windows can't be hit
             (*window).z_order = self.min_z_order;
             self.min_z_order -= 1;
             ds_set_surface_z_order((*window).surface, (*window).z_order);
@@ -396,6 +700,8 @@ impl WindowManager {
             }
             
             (*window).minimized = false;
+            ds_set_surface_visible((*window).surface, true);
+            drop_thumbnail(window);
             (*window).z_order = self.next_z_order;
             self.next_z_order += 1;
             ds_set_surface_z_order((*window).surface, (*window).z_order);
@@ -419,10 +725,10 @@ impl WindowManager {
 
     fn maximize_window(&mut self, window: *mut Window) {
         unsafe {
-            log_debug(b"maximize_window: called\0");
+            trace!(LEVEL_DEBUG, "maximize_window: called");
             
             if (*window).maximized {
-                log_info(b"maximize_window: already maximized\0");
+                trace!(LEVEL_INFO, "maximize_window: already maximized");
                 return; // Already maximized
             }
             
@@ -432,13 +738,11 @@ impl WindowManager {
             (*window).orig_width = (*window).width;
             (*window).orig_height = (*window).height;
             
-            // Get framebuffer dimensions
-            let fb = self.get_framebuffer();
-            let fb_width = (*fb).width as u32;
-            let fb_height = (*fb).height as u32;
+            // Get screen dimensions (logical pixels)
+            let (fb_width, fb_height) = self.screen_size();
             
-            logger_rust_log_fmt(0, b"WM\0".as_ptr() as *const c_char, 
-                b"fb_size=%ux%u, orig=%ux%u\0".as_ptr() as *const c_char,
+            trace!(LEVEL_DEBUG,
+                "fb_size=%ux%u, orig=%ux%u",
                 fb_width, fb_height, (*window).width, (*window).height);
             
             // Check buffer size limit (800x600 = 480000 pixels max)
@@ -450,8 +754,12 @@ impl WindowManager {
             let mut new_width = fb_width;
             let mut new_height = fb_height;
             
+            // The display server backs one screen-sized surface beyond the pool
+            // limit (for direct scanout); use it when it is free
+            let fullscreen = ds_set_surface_size((*window).surface, fb_width, fb_height);
+            
             // If framebuffer is larger than buffer limit, scale down proportionally using integer math
-            if (new_width * new_height) as usize > MAX_BUFFER_SIZE {
+            if !fullscreen && (new_width * new_height) as usize > MAX_BUFFER_SIZE {
                 // Calculate aspect ratio (width/height) - use direct ratio without multiplying
                 let aspect_num = fb_width as u64;
                 let aspect_den = fb_height as u64;
@@ -507,16 +815,15 @@ impl WindowManager {
             }
             
             // Final safety check - ensure we never exceed buffer size
-            if (new_width * new_height) as usize > MAX_BUFFER_SIZE {
+            if !fullscreen && (new_width * new_height) as usize > MAX_BUFFER_SIZE {
                 // Use maximum safe dimensions
                 new_width = MAX_WIDTH;
                 new_height = MAX_HEIGHT;
             }
             
-            logger_rust_log_fmt(0, b"WM\0".as_ptr() as *const c_char,
-                b"new_size=%ux%u, buffer_size=%u, fb=%lux%lu\0".as_ptr() as *const c_char,
-                new_width, new_height, (new_width * new_height) as u32, 
-                fb_width as u64, fb_height as u64);
+            trace!(LEVEL_DEBUG,
+                "new_size=%ux%u, buffer_size=%u, fb=%ux%u",
+                new_width, new_height, new_width * new_height, fb_width, fb_height);
             
             // Mark old position as dirty
             ds_mark_dirty((*window).x, (*window).y, (*window).width, (*window).height);
@@ -533,7 +840,7 @@ impl WindowManager {
             
             // Double-check buffer size before updating
             let buffer_size = (new_width * new_height) as usize;
-            if buffer_size > MAX_BUFFER_SIZE {
+            if !fullscreen && buffer_size > MAX_BUFFER_SIZE {
                 // Shouldn't happen due to our check above, but be safe
                 return;
             }
@@ -550,22 +857,22 @@ impl WindowManager {
             (*window).invalidated = true;  // Mark as invalidated immediately when dimensions change
             
             // Update surface position first (before size change)
-            logger_rust_log_fmt(0, b"WM\0".as_ptr() as *const c_char,
-                b"setting position to %d,%d\0".as_ptr() as *const c_char,
+            trace!(LEVEL_DEBUG,
+                "setting position to %d,%d",
                 (*window).x, (*window).y);
             ds_set_surface_position((*window).surface, (*window).x, (*window).y);
             
             // Then update surface size
-            logger_rust_log_fmt(0, b"WM\0".as_ptr() as *const c_char,
-                b"setting size to %ux%u\0".as_ptr() as *const c_char,
+            trace!(LEVEL_DEBUG,
+                "setting size to %ux%u",
                 (*window).width, (*window).height);
             ds_set_surface_size((*window).surface, (*window).width, (*window).height);
             
             // Update buffer pointer (shouldn't change, but be safe)
             (*window).buffer = ds_get_surface_buffer((*window).surface);
             
-            logger_rust_log_fmt(0, b"WM\0".as_ptr() as *const c_char,
-                b"buffer=%p, surface=%p\0".as_ptr() as *const c_char,
+            trace!(LEVEL_DEBUG,
+                "buffer=%p, surface=%p",
                 (*window).buffer, (*window).surface);
             
             // Verify surface dimensions match window dimensions
@@ -574,12 +881,12 @@ impl WindowManager {
                 let surf_height = (*(*window).surface).height;
                 let surf_x = (*(*window).surface).x;
                 let surf_y = (*(*window).surface).y;
-                logger_rust_log_fmt(0, b"WM\0".as_ptr() as *const c_char,
-                    b"surface: pos=%d,%d size=%ux%u, window: pos=%d,%d size=%ux%u\0".as_ptr() as *const c_char,
+                trace!(LEVEL_DEBUG,
+                    "surface: pos=%d,%d size=%ux%u, window: pos=%d,%d size=%ux%u",
                     surf_x, surf_y, surf_width, surf_height, (*window).x, (*window).y, (*window).width, (*window).height);
                 
                 if surf_width != (*window).width || surf_height != (*window).height {
-                    log_error(b"ERROR - surface size mismatch! Restoring original size.\0");
+                    trace!(LEVEL_ERROR, "ERROR - surface size mismatch! Restoring original size.");
                     // Restore original dimensions
                     (*window).x = (*window).orig_x;
                     (*window).y = (*window).orig_y;
@@ -590,17 +897,18 @@ impl WindowManager {
                     ds_set_surface_position((*window).surface, (*window).x, (*window).y);
                     (*window).buffer = ds_get_surface_buffer((*window).surface);
                     (*window).invalidated = true;
+                    self.index_window(window);
                     return;
                 }
                 
                 if surf_x != (*window).x || surf_y != (*window).y {
-                    log_error(b"ERROR - surface position mismatch!\0");
+                    trace!(LEVEL_ERROR, "ERROR - surface position mismatch!");
                 }
             }
             
             // Verify buffer is still valid
             if (*window).buffer.is_null() {
-                log_error(b"ERROR - buffer is null after resize!\0");
+                trace!(LEVEL_ERROR, "ERROR - buffer is null after resize!");
                 // Resize failed, restore original dimensions
                 (*window).x = (*window).orig_x;
                 (*window).y = (*window).orig_y;
@@ -610,6 +918,7 @@ impl WindowManager {
                 ds_set_surface_size((*window).surface, (*window).width, (*window).height);
                 ds_set_surface_position((*window).surface, (*window).x, (*window).y);
                 (*window).buffer = ds_get_surface_buffer((*window).surface);
+                self.index_window(window);
                 return;
             }
             
@@ -632,15 +941,15 @@ impl WindowManager {
                 (*window).minimized = false;  // Ensure not minimized
                 
                 // Log window state before update
-                logger_rust_log_fmt(0, b"WM\0".as_ptr() as *const c_char,
-                    b"maximize_window: before update - invalidated=%u, pos=%d,%d, size=%ux%u, buffer=%p\0".as_ptr() as *const c_char,
+                trace!(LEVEL_DEBUG,
+                    "maximize_window: before update - invalidated=%u, pos=%d,%d, size=%ux%u, buffer=%p",
                     if (*window).invalidated { 1 } else { 0 }, (*window).x, (*window).y, (*window).width, (*window).height, (*window).buffer);
                 
                 ds_mark_dirty((*window).x, (*window).y, (*window).width, (*window).height);
             }
             
             // Force immediate render to clear artifacts
-            log_debug(b"maximize_window: completed successfully, invalidated=true\0");
+            trace!(LEVEL_DEBUG, "maximize_window: completed successfully, invalidated=true");
             
             // Don't call self.update() here - it would clear the invalidated flag
             // The main loop will call update() and render the window
@@ -652,7 +961,7 @@ impl WindowManager {
             // Double-check that invalidated is still true
             unsafe {
                 if !(*window).invalidated {
-                    log_error(b"maximize_window: ERROR - invalidated flag was cleared!\0");
+                    trace!(LEVEL_ERROR, "maximize_window: ERROR - invalidated flag was cleared!");
                     (*window).invalidated = true;
                 }
             }
@@ -681,12 +990,73 @@ impl WindowManager {
             
             // Update buffer pointer
             (*window).buffer = ds_get_surface_buffer((*window).surface);
+            self.index_window(window);
             
             (*window).invalidated = true;
             ds_mark_dirty((*window).x, (*window).y, (*window).width, (*window).height);
         }
     }
 
+    // Bring the hit-testing grid in line with the window's current rectangle
+    fn index_window(&mut self, window: *mut Window) {
+        unsafe {
+            let slot = (*window).id as usize;
+            if slot >= 32 {
+                return;
+            }
+            
+            let span = if (*window).minimized || (*window).width == 0 || (*window).height == 0 {
+                None
+            } else {
+                Some((hit_cell((*window).x), hit_cell((*window).y),
+                      hit_cell((*window).x + (*window).width as i32 - 1),
+                      hit_cell((*window).y + (*window).height as i32 - 1)))
+            };
+            // Most drag steps stay within the same cells
+            if HIT_GRID.spans[slot] == span {
+                return;
+            }
+            
+            unindex_slot(slot);
+            if let Some((col0, row0, col1, row1)) = span {
+                let bit = 1u32 << slot;
+                for row in row0..=row1 {
+                    for col in col0..=col1 {
+                        HIT_GRID.cells[row][col] |= bit;
+                    }
+                }
+                HIT_GRID.spans[slot] = span;
+            }
+        }
+    }
+    
+    // Topmost visible window containing the point: only the windows registered
+    // in the point's grid cell are checked
+    fn window_at(&self, x: i32, y: i32) -> Option<*mut Window> {
+        unsafe {
+            let mut mask = HIT_GRID.cells[hit_cell(y)][hit_cell(x)];
+            let mut best: Option<*mut Window> = None;
+            while mask != 0 {
+                let slot = mask.trailing_zeros() as usize;
+                mask &= mask - 1;
+                
+                let window = match WINDOW_POOL[slot].as_mut() {
+                    Some(w) => w as *mut Window,
+                    None => continue,
+                };
+                if (*window).minimized ||
+                   x < (*window).x || x >= (*window).x + (*window).width as i32 ||
+                   y < (*window).y || y >= (*window).y + (*window).height as i32 {
+                    continue;
+                }
+                if best.map_or(true, |b| (*window).z_order > (*b).z_order) {
+                    best = Some(window);
+                }
+            }
+            best
+        }
+    }
+
     fn get_resize_edge(&self, window: *mut Window, mouse_x: i32, mouse_y: i32) -> ResizeEdge {
         unsafe {
             if ((*window).flags & WINDOW_RESIZABLE) == 0 {
@@ -738,14 +1108,14 @@ impl WindowManager {
             }
             
             let buffer = (*window).buffer;
-            // Safety: Limit to MAX_BUFFER_SIZE to prevent overflow
-            const MAX_BUFFER_SIZE: usize = 800 * 600;
+            // Safety: Limit to the surface's buffer to prevent overflow
             let requested_size = ((*window).width * (*window).height) as usize;
-            let size = if requested_size > MAX_BUFFER_SIZE {
-                MAX_BUFFER_SIZE
+            let surface_size = if (*window).surface.is_null() {
+                0
             } else {
-                requested_size
+                ((*(*window).surface).width * (*(*window).surface).height) as usize
             };
+            let size = requested_size.min(surface_size);
             for i in 0..size {
                 *buffer.add(i) = color;
             }
@@ -791,45 +1161,107 @@ impl WindowManager {
         }
     }
 
-    fn draw_rect_to_window(&mut self, window: *mut Window, x: i32, y: i32, width: u32, height: u32, color: u32) {
+    fn draw_text_to_window(&mut self, window: *mut Window, text: *const c_char, x: i32, y: i32, color: u32) {
+        draw_text_clipped(window, text as *const u8, x, y, color, 0);
+    }
+
+    // Client drawing: coordinates are relative to the content rectangle below
+    // the title bar and clipped to it, so cached decorations are never touched
+
+    fn client_clear_window(&mut self, window: *mut Window, color: u32) {
+        unsafe {
+            if (*window).height > TITLE_BAR_HEIGHT {
+                let content_height = (*window).height - TITLE_BAR_HEIGHT;
+                self.draw_filled_rect_to_window(window, 0, TITLE_BAR_HEIGHT as i32,
+                                                (*window).width, content_height, color);
+            }
+        }
+    }
+
+    fn client_draw_pixel(&mut self, window: *mut Window, x: i32, y: i32, color: u32) {
+        if y < 0 {
+            return;
+        }
+        self.draw_pixel_to_window(window, x, y + TITLE_BAR_HEIGHT as i32, color);
+    }
+
+    fn client_draw_filled_rect(&mut self, window: *mut Window, x: i32, y: i32, width: u32, height: u32, color: u32) {
+        let mut y = y;
+        let mut height = height;
+        if y < 0 {
+            let cut = (-y) as u32;
+            if cut >= height {
+                return;
+            }
+            height -= cut;
+            y = 0;
+        }
+        self.draw_filled_rect_to_window(window, x, y + TITLE_BAR_HEIGHT as i32, width, height, color);
+    }
+
+    fn client_draw_rect(&mut self, window: *mut Window, x: i32, y: i32, width: u32, height: u32, color: u32) {
         // Top and bottom lines
-        self.draw_filled_rect_to_window(window, x, y, width, 1, color);
-        self.draw_filled_rect_to_window(window, x, y + height as i32 - 1, width, 1, color);
+        self.client_draw_filled_rect(window, x, y, width, 1, color);
+        self.client_draw_filled_rect(window, x, y + height as i32 - 1, width, 1, color);
         
         // Left and right lines
-        self.draw_filled_rect_to_window(window, x, y, 1, height, color);
-        self.draw_filled_rect_to_window(window, x + width as i32 - 1, y, 1, height, color);
+        self.client_draw_filled_rect(window, x, y, 1, height, color);
+        self.client_draw_filled_rect(window, x + width as i32 - 1, y, 1, height, color);
     }
 
-    fn draw_text_to_window(&mut self, window: *mut Window, text: *const c_char, x: i32, y: i32, color: u32) {
+    fn client_draw_text(&mut self, window: *mut Window, text: *const c_char, x: i32, y: i32, color: u32) {
+        let top = TITLE_BAR_HEIGHT as i32;
+        draw_text_clipped(window, text as *const u8, x, y + top, color, top);
+    }
+
+    // Render title bar, title and buttons into the cached strip at the top of
+    // the buffer and remember what they were rendered for
+    fn render_decorations(&mut self, window: *mut Window) {
         unsafe {
-            if (*window).buffer.is_null() {
-                return;
+            // Draw window border and title bar
+            let title_color = if (*window).focused { 0x4a90e2 } else { 0x404040 };
+            self.draw_filled_rect_to_window(window, 0, 0, (*window).width, TITLE_BAR_HEIGHT, title_color);
+            
+            // Draw title text
+            let title_ptr = (*window).title.as_ptr() as *const c_char;
+            self.draw_text_to_window(window, title_ptr, 4, 4, 0xffffff);
+            
+            // Draw window control buttons (minimize, maximize, close)
+            let mut button_x = (*window).width as i32 - 18;
+            
+            // Close button
+            if ((*window).flags & WINDOW_CLOSABLE) != 0 {
+                self.draw_filled_rect_to_window(window, button_x, 2, 16, 16, 0xff4444);
+                draw_char_to_window(window, b'X', button_x + 2, 4, 0xffffff);
+                button_x -= 20;
             }
             
-            if text.is_null() {
-                return;
+            // Maximize button
+            self.draw_filled_rect_to_window(window, button_x, 2, 16, 16, 0x4444ff);
+            if (*window).maximized {
+                draw_char_to_window(window, b'R', button_x + 2, 4, 0xffffff); // Restore
+            } else {
+                draw_char_to_window(window, b'M', button_x + 2, 4, 0xffffff); // Maximize
             }
+            button_x -= 20;
             
-            let mut current_x = x;
-            let text_bytes = text as *const u8;
-            let mut i = 0;
-            const MAX_TEXT_LENGTH: usize = 1024;
+            // Minimize button
+            self.draw_filled_rect_to_window(window, button_x, 2, 16, 16, 0x44ff44);
+            draw_char_to_window(window, b'_', button_x + 2, 4, 0xffffff);
             
-            while i < MAX_TEXT_LENGTH && *text_bytes.add(i) != 0 {
-                let ch = *text_bytes.add(i) as usize;
-                if ch >= 32 && ch <= 126 {
-                    draw_char_to_window(window, ch as u8, current_x, y, color);
-                    current_x += 8; // 8 pixels per character
-                } else if ch == b'\n' as usize {
-                    current_x = x;
-                }
-                i += 1;
-            }
+            (*window).decor_valid = true;
+            (*window).decor_focused = (*window).focused;
+            (*window).decor_maximized = (*window).maximized;
+            (*window).decor_title_hash = title_hash(&(*window).title);
         }
     }
 
     fn handle_mouse(&mut self, mouse_x: i32, mouse_y: i32, left_button: bool) {
+        // Mouse reports physical pixels, windows live in logical pixels
+        let scale = unsafe { ds_get_scale() }.max(1) as i32;
+        let mouse_x = mouse_x / scale;
+        let mouse_y = mouse_y / scale;
+        
         // Track button state for press detection
         let button_just_pressed = left_button && !self.last_mouse_button;
         self.last_mouse_button = left_button;
@@ -838,9 +1270,9 @@ impl WindowManager {
         if let Some(resizing) = self.resizing_window {
             if left_button {
                 unsafe {
-                    let fb = self.get_framebuffer();
-                    let fb_width = (*fb).width as i32;
-                    let fb_height = (*fb).height as i32;
+                    let (fb_width, fb_height) = self.screen_size();
+                    let fb_width = fb_width as i32;
+                    let fb_height = fb_height as i32;
                     
                     let mut new_x = (*resizing).x;
                     let mut new_y = (*resizing).y;
@@ -975,36 +1407,47 @@ impl WindowManager {
                         _ => {},
                     }
                     
-                    // Update window if size or position changed
-                    if (*resizing).x != new_x || (*resizing).y != new_y ||
-                        (*resizing).width != new_width || (*resizing).height != new_height {
-                        // Mark old area as dirty
-                        ds_mark_dirty((*resizing).x, (*resizing).y, (*resizing).width, (*resizing).height);
-                        
-                        (*resizing).x = new_x;
-                        (*resizing).y = new_y;
-                        (*resizing).width = new_width;
-                        (*resizing).height = new_height;
-                        
-                        // Update surface size and position
-                        ds_set_surface_size((*resizing).surface, new_width, new_height);
-                        ds_set_surface_position((*resizing).surface, new_x, new_y);
-                        
-                        // Update buffer pointer
-                        (*resizing).buffer = ds_get_surface_buffer((*resizing).surface);
-                        
-                        (*resizing).invalidated = true;
-                        ds_mark_dirty(new_x, new_y, new_width, new_height);
-                        
-                        // Force immediate render
-                        ds_render();
+                    // Never preview a size the surface can't hold: the release would be
+                    // refused and the window would only move. Shrink the dragged
+                    // dimension and keep the opposite edges where they are.
+                    let capacity = ds_get_surface_capacity((*resizing).surface) as usize;
+                    if new_width as usize * new_height as usize > capacity {
+                        match self.resize_edge {
+                            ResizeEdge::Left | ResizeEdge::Right => {
+                                new_width = (capacity / new_height as usize) as u32;
+                            },
+                            _ => {
+                                new_height = ((capacity / new_width as usize) as u32).max(MIN_HEIGHT);
+                                if new_width as usize * new_height as usize > capacity {
+                                    new_width = (capacity / new_height as usize) as u32;
+                                }
+                            },
+                        }
+                        if matches!(self.resize_edge, ResizeEdge::Left | ResizeEdge::TopLeft | ResizeEdge::BottomLeft) {
+                            new_x = (*resizing).x + (*resizing).width as i32 - new_width as i32;
+                        }
+                        if matches!(self.resize_edge, ResizeEdge::Top | ResizeEdge::TopLeft | ResizeEdge::TopRight) {
+                            new_y = (*resizing).y + (*resizing).height as i32 - new_height as i32;
+                        }
+                    }
+                    
+                    // Only move the outline while the button is held; the window keeps
+                    // its surface and content until the resize is committed
+                    let preview = (new_x, new_y, new_width, new_height);
+                    if self.resize_preview != preview {
+                        self.resize_preview = preview;
+                        ds_set_outline(new_x, new_y, new_width, new_height);
                     }
+                    ds_update_cursor_position(mouse_x, mouse_y);
                 }
             } else {
-                // Button released - stop resizing
+                // Button released - commit the previewed size: one surface resize, one client redraw
+                let (x, y, width, height) = self.resize_preview;
+                self.set_window_bounds(resizing, x, y, width, height);
                 self.resizing_window = None;
                 self.resize_edge = ResizeEdge::None;
                 unsafe {
+                    ds_clear_outline();
                     ds_update_cursor_position(mouse_x, mouse_y);
                 }
             }
@@ -1023,18 +1466,18 @@ impl WindowManager {
                     
                     // Clamp to screen bounds (unless maximized)
                     if !(*dragging).maximized {
-                        let fb = self.get_framebuffer();
+                        let (screen_width, screen_height) = self.screen_size();
                         if (*dragging).x < 0 {
                             (*dragging).x = 0;
                         }
                         if (*dragging).y < 0 {
                             (*dragging).y = 0;
                         }
-                        if (*dragging).x + (*dragging).width as i32 > (*fb).width as i32 {
-                            (*dragging).x = (*fb).width as i32 - (*dragging).width as i32;
+                        if (*dragging).x + (*dragging).width as i32 > screen_width as i32 {
+                            (*dragging).x = screen_width as i32 - (*dragging).width as i32;
                         }
-                        if (*dragging).y + (*dragging).height as i32 > (*fb).height as i32 {
-                            (*dragging).y = (*fb).height as i32 - (*dragging).height as i32;
+                        if (*dragging).y + (*dragging).height as i32 > screen_height as i32 {
+                            (*dragging).y = screen_height as i32 - (*dragging).height as i32;
                         }
                     }
                     
@@ -1049,6 +1492,7 @@ impl WindowManager {
                         
                         // Update surface position in display server (marks old and new positions as dirty)
                         ds_set_surface_position((*dragging).surface, (*dragging).x, (*dragging).y);
+                        self.index_window(dragging);
                         
                         // Force immediate render to clear artifacts and show window at new position
                         ds_render();
@@ -1071,161 +1515,376 @@ impl WindowManager {
 
         // Check for window focus and drag start
         if button_just_pressed {
-            // Check windows in reverse order (top to bottom), skip minimized windows
-            for i in (0..self.window_count).rev() {
-                if let Some(window) = self.windows[i] {
-                    unsafe {
-                        // Skip minimized windows
-                        if (*window).minimized {
-                            continue;
-                        }
-                        
-                        let wx = (*window).x;
-                        let wy = (*window).y;
-                        let ww = (*window).width as i32;
-                        let wh = (*window).height as i32;
-                        
-                        if mouse_x >= wx && mouse_x < wx + ww &&
-                           mouse_y >= wy && mouse_y < wy + wh {
+            // Topmost visible window under the cursor, from the spatial index
+            if let Some(window) = self.window_at(mouse_x, mouse_y) {
+                unsafe {
+                    let wx = (*window).x;
+                    let wy = (*window).y;
+                    let ww = (*window).width as i32;
+                    
+                    // Check for resize edge first (if not in title bar)
+                    if mouse_y >= wy + 20 {
+                        let resize_edge = self.get_resize_edge(window, mouse_x, mouse_y);
+                        if resize_edge != ResizeEdge::None {
+                            self.resizing_window = Some(window);
+                            self.resize_edge = resize_edge;
+                            self.resize_start_x = mouse_x;
+                            self.resize_start_y = mouse_y;
+                            self.resize_start_width = (*window).width;
+                            self.resize_start_height = (*window).height;
+                            self.resize_preview = (wx, wy, (*window).width, (*window).height);
                             
-                            // Check for resize edge first (if not in title bar)
-                            if mouse_y >= wy + 20 {
-                                let resize_edge = self.get_resize_edge(window, mouse_x, mouse_y);
-                                if resize_edge != ResizeEdge::None {
-                                    self.resizing_window = Some(window);
-                                    self.resize_edge = resize_edge;
-                                    self.resize_start_x = mouse_x;
-                                    self.resize_start_y = mouse_y;
-                                    self.resize_start_width = (*window).width;
-                                    self.resize_start_height = (*window).height;
-                                    
-                                    // Focus window
-                                    if let Some(old_focused) = self.focused_window {
-                                        if old_focused != window {
-                                            (*old_focused).focused = false;
-                                            (*old_focused).invalidated = true;
-                                            ds_mark_dirty((*old_focused).x, (*old_focused).y, 
-                                                          (*old_focused).width, (*old_focused).height);
-                                        }
-                                    }
-                                    self.focused_window = Some(window);
-                                    (*window).focused = true;
-                                    (*window).invalidated = true;
-                                    self.bring_to_front(window);
-                                    return;
+                            // Focus window
+                            if let Some(old_focused) = self.focused_window {
+                                if old_focused != window {
+                                    (*old_focused).focused = false;
+                                    (*old_focused).invalidated = true;
+                                    ds_mark_dirty((*old_focused).x, (*old_focused).y, 
+                                                  (*old_focused).width, (*old_focused).height);
                                 }
                             }
-                            
-                            // Check if click is on control buttons
-                            let mut button_x = wx + ww as i32 - 18;
-                            
-                            // Close button
-                            if ((*window).flags & WINDOW_CLOSABLE) != 0 {
-                                let close_x_start = button_x;
-                                let close_x_end = close_x_start + 16;
-                                let close_y_start = wy + 2;
-                                let close_y_end = close_y_start + 16;
-                                
-                                if mouse_x >= close_x_start && mouse_x < close_x_end &&
-                                   mouse_y >= close_y_start && mouse_y < close_y_end {
-                                    self.destroy_window(window);
-                                    return;
-                                }
-                                button_x -= 20;
+                            self.focused_window = Some(window);
+                            (*window).focused = true;
+                            (*window).invalidated = true;
+                            self.bring_to_front(window);
+                            return;
+                        }
+                    }
+                    
+                    // Check if click is on control buttons
+                    let mut button_x = wx + ww as i32 - 18;
+                    
+                    // Close button
+                    if ((*window).flags & WINDOW_CLOSABLE) != 0 {
+                        let close_x_start = button_x;
+                        let close_x_end = close_x_start + 16;
+                        let close_y_start = wy + 2;
+                        let close_y_end = close_y_start + 16;
+                        
+                        if mouse_x >= close_x_start && mouse_x < close_x_end &&
+                           mouse_y >= close_y_start && mouse_y < close_y_end {
+                            self.destroy_window(window);
+                            return;
+                        }
+                        button_x -= 20;
+                    }
+                    
+                    // Maximize button
+                    let max_x_start = button_x;
+                    let max_x_end = max_x_start + 16;
+                    let max_y_start = wy + 2;
+                    let max_y_end = max_y_start + 16;
+                    
+                    if mouse_x >= max_x_start && mouse_x < max_x_end &&
+                       mouse_y >= max_y_start && mouse_y < max_y_end {
+                        if (*window).maximized {
+                            self.unmaximize_window(window);
+                        } else {
+                            self.maximize_window(window);
+                        }
+                        return;
+                    }
+                    button_x -= 20;
+                    
+                    // Minimize button
+                    let min_x_start = button_x;
+                    let min_x_end = min_x_start + 16;
+                    let min_y_start = wy + 2;
+                    let min_y_end = min_y_start + 16;
+                    
+                    if mouse_x >= min_x_start && mouse_x < min_x_end &&
+                       mouse_y >= min_y_start && mouse_y < min_y_end {
+                        self.minimize_window(window);
+                        return;
+                    }
+                    
+                    // Check if click is in title bar (top 20 pixels)
+                    let title_bar_y_start = wy;
+                    let title_bar_y_end = wy + 20;
+                    
+                    if mouse_y >= title_bar_y_start && mouse_y < title_bar_y_end {
+                        // Focus this window and bring to front
+                        if let Some(old_focused) = self.focused_window {
+                            if old_focused != window {
+                                (*old_focused).focused = false;
+                                (*old_focused).invalidated = true;
+                                ds_mark_dirty((*old_focused).x, (*old_focused).y, 
+                                              (*old_focused).width, (*old_focused).height);
                             }
-                            
-                            // Maximize button
-                            let max_x_start = button_x;
-                            let max_x_end = max_x_start + 16;
-                            let max_y_start = wy + 2;
-                            let max_y_end = max_y_start + 16;
-                            
-                            if mouse_x >= max_x_start && mouse_x < max_x_end &&
-                               mouse_y >= max_y_start && mouse_y < max_y_end {
-                                if (*window).maximized {
-                                    self.unmaximize_window(window);
-                                } else {
-                                    self.maximize_window(window);
-                                }
-                                return;
+                        }
+                        self.focused_window = Some(window);
+                        (*window).focused = true;
+                        (*window).invalidated = true;
+                        ds_mark_dirty((*window).x, (*window).y, (*window).width, (*window).height);
+                        self.bring_to_front(window);
+                        
+                        // Start dragging if window is movable and not maximized
+                        if ((*window).flags & WINDOW_MOVABLE) != 0 && !(*window).maximized {
+                            self.dragging_window = Some(window);
+                            self.drag_offset_x = mouse_x - wx;
+                            self.drag_offset_y = mouse_y - wy;
+                        }
+                    } else {
+                        // Click in window content - just focus
+                        if let Some(old_focused) = self.focused_window {
+                            if old_focused != window {
+                                (*old_focused).focused = false;
+                                (*old_focused).invalidated = true;
+                                ds_mark_dirty((*old_focused).x, (*old_focused).y, 
+                                              (*old_focused).width, (*old_focused).height);
                             }
-                            button_x -= 20;
-                            
-                            // Minimize button
-                            let min_x_start = button_x;
-                            let min_x_end = min_x_start + 16;
-                            let min_y_start = wy + 2;
-                            let min_y_end = min_y_start + 16;
-                            
-                            if mouse_x >= min_x_start && mouse_x < min_x_end &&
-                               mouse_y >= min_y_start && mouse_y < min_y_end {
-                                self.minimize_window(window);
-                                return;
+                        }
+                        self.focused_window = Some(window);
+                        (*window).focused = true;
+                        (*window).invalidated = true;
+                        ds_mark_dirty((*window).x, (*window).y, (*window).width, (*window).height);
+                        self.bring_to_front(window);
+                    }
+                }
+            }
+        }
+    }
+
+    // Advance the frame clock by the real time since the previous frame
+    fn advance_frame_clock(&mut self) {
+        let now = unsafe { _rdtsc() };
+        let delta = if self.last_frame_tsc == 0 {
+            0
+        } else {
+            match unsafe { tsc_to_us(now - self.last_frame_tsc) } {
+                0 => FALLBACK_FRAME_US, // TSC not calibrated
+                us => us.min(MAX_FRAME_DELTA_US),
+            }
+        };
+        self.last_frame_tsc = now;
+        self.frame_delta_us = delta;
+        self.frame_time_us += delta;
+    }
+    
+    fn add_animation(&mut self, window: *mut Window, kind: AnimationKind, duration_us: u64) -> u32 {
+        if window.is_null() {
+            return 0;
+        }
+        let slot = match self.animations.iter().position(|a| a.is_none()) {
+            Some(slot) => slot,
+            None => return 0,
+        };
+        
+        let id = self.next_animation_id;
+        self.next_animation_id = self.next_animation_id.wrapping_add(1).max(1);
+        self.animations[slot] = Some(Animation {
+            id,
+            window,
+            kind,
+            start_us: self.frame_time_us,
+            duration_us,
+        });
+        id
+    }
+    
+    fn stop_animation(&mut self, id: u32) {
+        for slot in self.animations.iter_mut() {
+            if matches!(slot, Some(a) if a.id == id) {
+                *slot = None;
+            }
+        }
+    }
+    
+    fn stop_window_animations(&mut self, window: *mut Window) {
+        for slot in self.animations.iter_mut() {
+            if matches!(slot, Some(a) if a.window == window) {
+                *slot = None;
+            }
+        }
+    }
+    
+    fn animate(&mut self, window: *mut Window, callback: AnimationCallback, user_data: *mut c_void) -> u32 {
+        let id = self.add_animation(window, AnimationKind::Callback(callback, user_data), 0);
+        if id != 0 {
+            self.invalidate_window(window);
+        }
+        id
+    }
+    
+    // Tween the window to (x, y); a new move tween replaces a running one
+    fn animate_move(&mut self, window: *mut Window, x: i32, y: i32, duration_ms: u32) -> u32 {
+        unsafe {
+            if window.is_null() || (*window).maximized {
+                return 0;
+            }
+            for slot in self.animations.iter_mut() {
+                if matches!(slot, Some(a) if a.window == window && matches!(a.kind, AnimationKind::Move { .. })) {
+                    *slot = None;
+                }
+            }
+            let kind = AnimationKind::Move { from_x: (*window).x, from_y: (*window).y, to_x: x, to_y: y };
+            self.add_animation(window, kind, duration_ms as u64 * 1000)
+        }
+    }
+    
+    // Tween the window to width x height; a new resize tween replaces a running one
+    fn animate_resize(&mut self, window: *mut Window, width: u32, height: u32, duration_ms: u32) -> u32 {
+        unsafe {
+            if window.is_null() || (*window).maximized || width == 0 || height <= TITLE_BAR_HEIGHT {
+                return 0;
+            }
+            // Every step must fit the window's pool slot
+            if width as usize * height as usize > MAX_SURFACE_PIXELS {
+                return 0;
+            }
+            for slot in self.animations.iter_mut() {
+                if matches!(slot, Some(a) if a.window == window && matches!(a.kind, AnimationKind::Resize { .. })) {
+                    *slot = None;
+                }
+            }
+            let kind = AnimationKind::Resize {
+                from_width: (*window).width, from_height: (*window).height,
+                to_width: width, to_height: height,
+            };
+            self.add_animation(window, kind, duration_ms as u64 * 1000)
+        }
+    }
+    
+    // Move and resize a window, keeping its surface in step. A size the surface
+    // can't hold is ignored (the window only moves), so drawing never runs past
+    // the surface buffer.
+    fn set_window_bounds(&mut self, window: *mut Window, x: i32, y: i32, width: u32, height: u32) {
+        unsafe {
+            let resized = ((*window).width != width || (*window).height != height) &&
+                ds_set_surface_size((*window).surface, width, height);
+            if !resized {
+                if (*window).x != x || (*window).y != y {
+                    (*window).x = x;
+                    (*window).y = y;
+                    // Marks the old and new positions dirty
+                    ds_set_surface_position((*window).surface, x, y);
+                    self.index_window(window);
+                }
+                return;
+            }
+            
+            ds_mark_dirty((*window).x, (*window).y, (*window).width, (*window).height);
+            (*window).x = x;
+            (*window).y = y;
+            (*window).width = width;
+            (*window).height = height;
+            ds_set_surface_position((*window).surface, x, y);
+            (*window).buffer = ds_get_surface_buffer((*window).surface);
+            self.index_window(window);
+            (*window).invalidated = true;
+            ds_mark_dirty(x, y, width, height);
+        }
+    }
+    
+    // Step every active animation once; called at the start of each frame
+    fn run_animations(&mut self) {
+        let now = self.frame_time_us;
+        let delta = self.frame_delta_us;
+        
+        for i in 0..MAX_ANIMATIONS {
+            let anim = match self.animations[i] {
+                Some(anim) => anim,
+                None => continue,
+            };
+            let window = anim.window;
+            
+            unsafe {
+                match anim.kind {
+                    AnimationKind::Callback(callback, user_data) => {
+                        // Nothing to show while minimized; the callback only sees frames it ran in
+                        if (*window).minimized {
+                            continue;
+                        }
+                        let keep = callback(window, user_data, now, delta);
+                        // The callback may have stopped this animation or destroyed the window
+                        if !matches!(self.animations[i], Some(a) if a.id == anim.id) {
+                            continue;
+                        }
+                        if keep {
+                            self.invalidate_window(window);
+                        } else {
+                            self.animations[i] = None;
+                        }
+                    }
+                    AnimationKind::Move { .. } | AnimationKind::Resize { .. } => {
+                        // The user grabbed the window: hand it over
+                        if self.dragging_window == Some(window) || self.resizing_window == Some(window) ||
+                           (*window).maximized {
+                            self.animations[i] = None;
+                            continue;
+                        }
+                        
+                        let elapsed = now - anim.start_us;
+                        let t = if anim.duration_us == 0 || elapsed >= anim.duration_us {
+                            65536
+                        } else {
+                            (elapsed * 65536 / anim.duration_us) as i64
+                        };
+                        let eased = ease_out(t);
+                        
+                        let (mut x, mut y, mut width, mut height) =
+                            ((*window).x, (*window).y, (*window).width, (*window).height);
+                        match anim.kind {
+                            AnimationKind::Move { from_x, from_y, to_x, to_y } => {
+                                x = tween(from_x as i64, to_x as i64, eased) as i32;
+                                y = tween(from_y as i64, to_y as i64, eased) as i32;
                             }
-                            
-                            // Check if click is in title bar (top 20 pixels)
-                            let title_bar_y_start = wy;
-                            let title_bar_y_end = wy + 20;
-                            
-                            if mouse_y >= title_bar_y_start && mouse_y < title_bar_y_end {
-                                // Focus this window and bring to front
-                                if let Some(old_focused) = self.focused_window {
-                                    if old_focused != window {
-                                        (*old_focused).focused = false;
-                                        (*old_focused).invalidated = true;
-                                        ds_mark_dirty((*old_focused).x, (*old_focused).y, 
-                                                      (*old_focused).width, (*old_focused).height);
-                                    }
-                                }
-                                self.focused_window = Some(window);
-                                (*window).focused = true;
-                                (*window).invalidated = true;
-                                ds_mark_dirty((*window).x, (*window).y, (*window).width, (*window).height);
-                                self.bring_to_front(window);
-                                
-                                // Start dragging if window is movable and not maximized
-                                if ((*window).flags & WINDOW_MOVABLE) != 0 && !(*window).maximized {
-                                    self.dragging_window = Some(window);
-                                    self.drag_offset_x = mouse_x - wx;
-                                    self.drag_offset_y = mouse_y - wy;
-                                }
-                            } else {
-                                // Click in window content - just focus
-                                if let Some(old_focused) = self.focused_window {
-                                    if old_focused != window {
-                                        (*old_focused).focused = false;
-                                        (*old_focused).invalidated = true;
-                                        ds_mark_dirty((*old_focused).x, (*old_focused).y, 
-                                                      (*old_focused).width, (*old_focused).height);
-                                    }
-                                }
-                                self.focused_window = Some(window);
-                                (*window).focused = true;
-                                (*window).invalidated = true;
-                                ds_mark_dirty((*window).x, (*window).y, (*window).width, (*window).height);
-                                self.bring_to_front(window);
+                            AnimationKind::Resize { from_width, from_height, to_width, to_height } => {
+                                width = tween(from_width as i64, to_width as i64, eased) as u32;
+                                height = tween(from_height as i64, to_height as i64, eased) as u32;
                             }
-                            break; // Stop checking other windows
+                            _ => {}
+                        }
+                        self.set_window_bounds(window, x, y, width, height);
+                        
+                        if t >= 65536 {
+                            self.animations[i] = None;
                         }
                     }
                 }
             }
         }
     }
-
+    
+    // True when a frame would do work: an animation is running, a window
+    // needs redrawing, or the display server holds unflushed damage
+    fn frame_pending(&self) -> bool {
+        if self.animations.iter().any(|a| a.is_some()) {
+            return true;
+        }
+        for i in 0..self.window_count {
+            if let Some(window) = self.windows[i] {
+                if unsafe { (*window).invalidated && !(*window).minimized } {
+                    return true;
+                }
+            }
+        }
+        unsafe { ds_has_damage() }
+    }
+    
     fn update(&mut self) {
+        self.advance_frame_clock();
+        unsafe {
+            let active = self.animations.iter().filter(|anim| anim.is_some()).count() as u64;
+            trace_emit(TRACE_WM_ANIMATIONS, TRACE_BEGIN, active, 0, 0);
+            self.run_animations();
+            trace_emit(TRACE_WM_ANIMATIONS, TRACE_END, active, 0, 0);
+        }
+        
         // Render all invalidated windows (skip minimized windows)
         // First pass: render invalidated windows
         unsafe {
             // Track which windows we've already rendered in this update cycle
             // to prevent infinite loops from re-invalidation
             let mut rendered_this_cycle: [bool; 32] = [false; 32];
+            let mut rendered: u64 = 0;
+            trace_emit(TRACE_WM_RENDER, TRACE_BEGIN, 0, 0, 0);
             
             for i in 0..self.window_count {
                 if let Some(window) = self.windows[i] {
                     // Skip minimized windows
                     if (*window).minimized {
-                        log_debug(b"update: skipping minimized window\0");
+                        trace!(LEVEL_DEBUG, "update: skipping minimized window");
                         continue;
                     }
                     
@@ -1235,84 +1894,72 @@ impl WindowManager {
                     }
                     
                     if (*window).invalidated {
-                        logger_rust_log_fmt(0, b"WM\0".as_ptr() as *const c_char,
-                            b"update: rendering window id=%u, pos=%d,%d, size=%ux%u, buffer=%p\0".as_ptr() as *const c_char,
+                        trace!(LEVEL_DEBUG,
+                            "update: rendering window id=%u, pos=%d,%d, size=%ux%u, buffer=%p",
                             (*window).id, (*window).x, (*window).y, (*window).width, (*window).height, (*window).buffer);
                         
                         if (*window).buffer.is_null() {
-                            log_error(b"update: window buffer is null!\0");
+                            trace!(LEVEL_ERROR, "update: window buffer is null!");
                             continue;
                         }
-                        // Clear window buffer
-                        self.clear_window(window, 0x2d2d2d); // Window background
-                        
-                        // Draw window border and title bar
-                        let title_color = if (*window).focused { 0x4a90e2 } else { 0x404040 };
-                        self.draw_filled_rect_to_window(window, 0, 0, (*window).width, 20, title_color);
                         
-                        // Draw title text
-                        let title_ptr = (*window).title.as_ptr() as *const c_char;
-                        self.draw_text_to_window(window, title_ptr, 4, 4, 0xffffff);
-                        
-                        // Draw window control buttons (minimize, maximize, close)
-                        let mut button_x = (*window).width as i32 - 18;
-                        
-                        // Close button
-                        if ((*window).flags & WINDOW_CLOSABLE) != 0 {
-                            self.draw_filled_rect_to_window(window, button_x, 2, 16, 16, 0xff4444);
-                            draw_char_to_window(window, b'X', button_x + 2, 4, 0xffffff);
-                            button_x -= 20;
+                        // A new size means a new buffer layout: old content is meaningless
+                        let size_changed = (*window).decor_width != (*window).width ||
+                                           (*window).decor_height != (*window).height;
+                        if size_changed {
+                            self.client_clear_window(window, WINDOW_BACKGROUND);
+                            (*window).decor_width = (*window).width;
+                            (*window).decor_height = (*window).height;
                         }
                         
-                        // Maximize button
-                        self.draw_filled_rect_to_window(window, button_x, 2, 16, 16, 0x4444ff);
-                        if (*window).maximized {
-                            draw_char_to_window(window, b'R', button_x + 2, 4, 0xffffff); // Restore
-                        } else {
-                            draw_char_to_window(window, b'M', button_x + 2, 4, 0xffffff); // Maximize
+                        // Decorations are retained; re-render only when something they show changed
+                        let decorations_stale = size_changed ||
+                            !(*window).decor_valid ||
+                            (*window).decor_focused != (*window).focused ||
+                            (*window).decor_maximized != (*window).maximized ||
+                            (*window).decor_title_hash != title_hash(&(*window).title);
+                        if decorations_stale {
+                            self.render_decorations(window);
                         }
-                        button_x -= 20;
                         
-                        // Minimize button
-                        self.draw_filled_rect_to_window(window, button_x, 2, 16, 16, 0x44ff44);
-                        draw_char_to_window(window, b'_', button_x + 2, 4, 0xffffff);
+                        // Only the content rectangle changed unless decorations were redrawn
+                        let (dirty_y, dirty_height) = if decorations_stale || (*window).height <= TITLE_BAR_HEIGHT {
+                            ((*window).y, (*window).height)
+                        } else {
+                            ((*window).y + TITLE_BAR_HEIGHT as i32, (*window).height - TITLE_BAR_HEIGHT)
+                        };
                         
-                        // Call custom draw callback if set
+                        // Call custom draw callback if set; it owns the content rectangle.
+                        // Continuous redraws are driven by wm_animate(), not by re-invalidating here.
                         if let Some(callback) = (*window).draw_callback {
                             callback(window);
-                            // Check if callback re-invalidated the window (for continuous animations)
-                            // If so, preserve the invalidation so it gets redrawn on next update
-                            if (*window).invalidated {
-                                // Window was re-invalidated by callback - keep it invalidated
-                                // This allows continuous animations to work
-                                ds_mark_dirty((*window).x, (*window).y, (*window).width, (*window).height);
-                                continue; // Skip clearing invalidated flag
-                            }
                         }
                         
                         // Mark this window as rendered in this cycle
                         if i < 32 {
                             rendered_this_cycle[i] = true;
                         }
+                        rendered += 1;
                         
                         // Clear invalidated flag BEFORE marking dirty to prevent re-render loop
                         (*window).invalidated = false;
                         
                         // Log successful render, especially for maximized windows
                         if (*window).maximized {
-                            logger_rust_log_fmt(0, b"WM\0".as_ptr() as *const c_char,
-                                b"update: maximized window id=%u rendered, pos=%d,%d, size=%ux%u\0".as_ptr() as *const c_char,
+                            trace!(LEVEL_DEBUG,
+                                "update: maximized window id=%u rendered, pos=%d,%d, size=%ux%u",
                                 (*window).id, (*window).x, (*window).y, (*window).width, (*window).height);
                         } else {
-                            log_debug(b"update: window rendered successfully\0");
+                            trace!(LEVEL_DEBUG, "update: window rendered successfully");
                         }
                         
                         // Mark dirty AFTER clearing invalidated flag
-                        ds_mark_dirty((*window).x, (*window).y, (*window).width, (*window).height);
+                        ds_mark_dirty((*window).x, dirty_y, (*window).width, dirty_height);
                     }
                     // Window not invalidated - this is normal after rendering, no action needed
                 }
             }
+            trace_emit(TRACE_WM_RENDER, TRACE_END, rendered, 0, 0);
         }
         
         // Request display server to render
@@ -1322,85 +1969,72 @@ impl WindowManager {
     }
 }
 
-// 8x8 font data - get glyph for a character
-fn get_font_glyph(ch: u8) -> [u8; 8] {
-    match ch {
-        b' ' => [0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00],
-        b'0' => [0x3C, 0x66, 0x6E, 0x76, 0x66, 0x66, 0x3C, 0x00],
-        b'1' => [0x18, 0x18, 0x38, 0x18, 0x18, 0x18, 0x7E, 0x00],
-        b'2' => [0x3C, 0x66, 0x06, 0x0C, 0x30, 0x60, 0x7E, 0x00],
-        b'3' => [0x3C, 0x66, 0x06, 0x1C, 0x06, 0x66, 0x3C, 0x00],
-        b'4' => [0x06, 0x0E, 0x1E, 0x66, 0x7F, 0x06, 0x06, 0x00],
-        b'5' => [0x7E, 0x60, 0x7C, 0x06, 0x06, 0x66, 0x3C, 0x00],
-        b'6' => [0x3C, 0x66, 0x60, 0x7C, 0x66, 0x66, 0x3C, 0x00],
-        b'7' => [0x7E, 0x66, 0x0C, 0x18, 0x18, 0x18, 0x18, 0x00],
-        b'8' => [0x3C, 0x66, 0x66, 0x3C, 0x66, 0x66, 0x3C, 0x00],
-        b'9' => [0x3C, 0x66, 0x66, 0x3E, 0x06, 0x66, 0x3C, 0x00],
-        b'A' => [0x3C, 0x66, 0x66, 0x7E, 0x66, 0x66, 0x66, 0x00],
-        b'B' => [0x7C, 0x66, 0x66, 0x7C, 0x66, 0x66, 0x7C, 0x00],
-        b'C' => [0x3C, 0x66, 0x60, 0x60, 0x60, 0x66, 0x3C, 0x00],
-        b'D' => [0x7C, 0x66, 0x66, 0x66, 0x66, 0x66, 0x7C, 0x00],
-        b'E' => [0x7E, 0x60, 0x60, 0x7C, 0x60, 0x60, 0x7E, 0x00],
-        b'F' => [0x7E, 0x60, 0x60, 0x7C, 0x60, 0x60, 0x60, 0x00],
-        b'G' => [0x3C, 0x66, 0x60, 0x6E, 0x66, 0x66, 0x3C, 0x00],
-        b'H' => [0x66, 0x66, 0x66, 0x7E, 0x66, 0x66, 0x66, 0x00],
-        b'I' => [0x3C, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, 0x00],
-        b'J' => [0x1E, 0x0C, 0x0C, 0x0C, 0x0C, 0x6C, 0x38, 0x00],
-        b'K' => [0x66, 0x6C, 0x78, 0x70, 0x78, 0x6C, 0x66, 0x00],
-        b'L' => [0x60, 0x60, 0x60, 0x60, 0x60, 0x60, 0x7E, 0x00],
-        b'M' => [0x63, 0x77, 0x7F, 0x6B, 0x63, 0x63, 0x63, 0x00],
-        b'N' => [0x66, 0x76, 0x7E, 0x7E, 0x6E, 0x66, 0x66, 0x00],
-        b'O' => [0x3C, 0x66, 0x66, 0x66, 0x66, 0x66, 0x3C, 0x00],
-        b'P' => [0x7C, 0x66, 0x66, 0x7C, 0x60, 0x60, 0x60, 0x00],
-        b'Q' => [0x3C, 0x66, 0x66, 0x66, 0x66, 0x3C, 0x0E, 0x00],
-        b'R' => [0x7C, 0x66, 0x66, 0x7C, 0x78, 0x6C, 0x66, 0x00],
-        b'S' => [0x3C, 0x66, 0x60, 0x3C, 0x06, 0x66, 0x3C, 0x00],
-        b'T' => [0x7E, 0x18, 0x18, 0x18, 0x18, 0x18, 0x18, 0x00],
-        b'U' => [0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0x3C, 0x00],
-        b'V' => [0x66, 0x66, 0x66, 0x66, 0x66, 0x3C, 0x18, 0x00],
-        b'W' => [0x63, 0x63, 0x63, 0x6B, 0x7F, 0x77, 0x63, 0x00],
-        b'X' => [0x66, 0x66, 0x3C, 0x18, 0x3C, 0x66, 0x66, 0x00],
-        b'Y' => [0x66, 0x66, 0x66, 0x3C, 0x18, 0x18, 0x18, 0x00],
-        b'Z' => [0x7E, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x7E, 0x00],
-        b'a' => [0x00, 0x00, 0x3C, 0x06, 0x3E, 0x66, 0x3E, 0x00],
-        b'b' => [0x60, 0x60, 0x7C, 0x66, 0x66, 0x66, 0x7C, 0x00],
-        b'c' => [0x00, 0x00, 0x3C, 0x60, 0x60, 0x60, 0x3C, 0x00],
-        b'd' => [0x06, 0x06, 0x3E, 0x66, 0x66, 0x66, 0x3E, 0x00],
-        b'e' => [0x00, 0x00, 0x3C, 0x66, 0x7E, 0x60, 0x3C, 0x00],
-        b'f' => [0x1C, 0x36, 0x30, 0x7C, 0x30, 0x30, 0x30, 0x00],
-        b'g' => [0x00, 0x00, 0x3E, 0x66, 0x66, 0x3E, 0x06, 0x7C],
-        b'h' => [0x60, 0x60, 0x7C, 0x66, 0x66, 0x66, 0x66, 0x00],
-        b'i' => [0x18, 0x00, 0x38, 0x18, 0x18, 0x18, 0x3C, 0x00],
-        b'j' => [0x06, 0x00, 0x0E, 0x06, 0x06, 0x06, 0x66, 0x3C],
-        b'k' => [0x60, 0x60, 0x66, 0x6C, 0x78, 0x6C, 0x66, 0x00],
-        b'l' => [0x38, 0x18, 0x18, 0x18, 0x18, 0x18, 0x3C, 0x00],
-        b'm' => [0x00, 0x00, 0x66, 0x7F, 0x7F, 0x6B, 0x63, 0x00],
-        b'n' => [0x00, 0x00, 0x7C, 0x66, 0x66, 0x66, 0x66, 0x00],
-        b'o' => [0x00, 0x00, 0x3C, 0x66, 0x66, 0x66, 0x3C, 0x00],
-        b'p' => [0x00, 0x00, 0x7C, 0x66, 0x66, 0x7C, 0x60, 0x60],
-        b'q' => [0x00, 0x00, 0x3E, 0x66, 0x66, 0x3E, 0x06, 0x06],
-        b'r' => [0x00, 0x00, 0x7C, 0x66, 0x60, 0x60, 0x60, 0x00],
-        b's' => [0x00, 0x00, 0x3E, 0x60, 0x3C, 0x06, 0x7C, 0x00],
-        b't' => [0x18, 0x18, 0x7E, 0x18, 0x18, 0x18, 0x0E, 0x00],
-        b'u' => [0x00, 0x00, 0x66, 0x66, 0x66, 0x66, 0x3E, 0x00],
-        b'v' => [0x00, 0x00, 0x66, 0x66, 0x66, 0x3C, 0x18, 0x00],
-        b'w' => [0x00, 0x00, 0x63, 0x6B, 0x7F, 0x3E, 0x36, 0x00],
-        b'x' => [0x00, 0x00, 0x66, 0x3C, 0x18, 0x3C, 0x66, 0x00],
-        b'y' => [0x00, 0x00, 0x66, 0x66, 0x66, 0x3E, 0x0C, 0x78],
-        b'z' => [0x00, 0x00, 0x7E, 0x0C, 0x18, 0x30, 0x7E, 0x00],
-        b'!' => [0x18, 0x18, 0x18, 0x18, 0x00, 0x18, 0x18, 0x00],
-        b':' => [0x00, 0x00, 0x18, 0x00, 0x00, 0x18, 0x00, 0x00],
-        b'(' => [0x0C, 0x18, 0x30, 0x30, 0x30, 0x18, 0x0C, 0x00],
-        b')' => [0x30, 0x18, 0x0C, 0x0C, 0x0C, 0x18, 0x30, 0x00],
-        b'.' => [0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x18, 0x00],
-        b',' => [0x00, 0x00, 0x00, 0x00, 0x00, 0x18, 0x30, 0x00],
-        b'-' => [0x00, 0x00, 0x00, 0x7E, 0x00, 0x00, 0x00, 0x00],
-        b'=' => [0x00, 0x00, 0x7E, 0x00, 0x7E, 0x00, 0x00, 0x00],
-        b'+' => [0x00, 0x18, 0x18, 0x7E, 0x18, 0x18, 0x00, 0x00],
-        b'/' => [0x00, 0x06, 0x0C, 0x18, 0x30, 0x60, 0x00, 0x00],
-        b'\\' => [0x00, 0x60, 0x30, 0x18, 0x0C, 0x06, 0x00, 0x00],
-        b'%' => [0x00, 0x46, 0x66, 0x30, 0x18, 0xCC, 0xC4, 0x00],
-        _ => [0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00],
+// Thumbnail pool entry owned by a window pool slot
+unsafe fn find_thumbnail(window_slot: usize) -> Option<usize> {
+    (0..THUMBNAIL_SLOTS).find(|&i| matches!(THUMBNAILS[i], Some(t) if t.window_slot == window_slot))
+}
+
+unsafe fn release_thumbnail(window_slot: usize) {
+    if let Some(index) = find_thumbnail(window_slot) {
+        THUMBNAILS[index] = None;
+    }
+}
+
+// Snapshot the window's current buffer (decorations included) into a thumbnail
+unsafe fn capture_thumbnail(window: *mut Window) {
+    let slot = (*window).id as usize;
+    if slot >= 32 {
+        return;
+    }
+    release_thumbnail(slot);
+    
+    let (width, height) = ((*window).width, (*window).height);
+    if (*window).buffer.is_null() || width == 0 || height == 0 {
+        return;
+    }
+    
+    // Smallest integer factor that fits the thumbnail box
+    let factor = ((width + THUMBNAIL_MAX_WIDTH - 1) / THUMBNAIL_MAX_WIDTH)
+        .max((height + THUMBNAIL_MAX_HEIGHT - 1) / THUMBNAIL_MAX_HEIGHT)
+        .max(1);
+    let (thumb_width, thumb_height) = (width / factor, height / factor);
+    if thumb_width == 0 || thumb_height == 0 {
+        return;
+    }
+    
+    // A free entry, or else the least recently used one
+    let mut index = 0;
+    for i in 0..THUMBNAIL_SLOTS {
+        match THUMBNAILS[i] {
+            None => {
+                index = i;
+                break;
+            }
+            Some(t) => {
+                if matches!(THUMBNAILS[index], Some(best) if t.last_used < best.last_used) {
+                    index = i;
+                }
+            }
+        }
+    }
+    THUMBNAILS[index] = None;
+    
+    let dst = (ptr::addr_of_mut!(THUMBNAIL_POOL[index])) as *mut u32;
+    if gpu_downscale_box(dst, thumb_width, (*window).buffer, width, height, width, factor) {
+        THUMBNAIL_CLOCK = THUMBNAIL_CLOCK.wrapping_add(1);
+        THUMBNAILS[index] = Some(Thumbnail {
+            window_slot: slot,
+            width: thumb_width,
+            height: thumb_height,
+            last_used: THUMBNAIL_CLOCK,
+        });
+    }
+}
+
+unsafe fn drop_thumbnail(window: *mut Window) {
+    let slot = (*window).id as usize;
+    if slot < 32 {
+        release_thumbnail(slot);
     }
 }
 
@@ -1409,25 +2043,65 @@ fn draw_char_to_window(window: *mut Window, ch: u8, x: i32, y: i32, color: u32)
         if (*window).buffer.is_null() {
             return;
         }
+        let target = window_text_target(window, 0);
+        gpu_draw_text(&target, x, y, &ch, 1, SYSTEM_FONT, 1, color, 0, 0);
+    }
+}
+
+// Draw a NUL-terminated string through the shared text engine, one call per
+// line so each label is a single cached blit. Rows above min_y are clipped
+// (keeps client text out of the title bar); '\n' returns to the start x.
+fn draw_text_clipped(window: *mut Window, text: *const u8, x: i32, y: i32, color: u32, min_y: i32) {
+    unsafe {
+        if (*window).buffer.is_null() || text.is_null() {
+            return;
+        }
         
-        let glyph = get_font_glyph(ch);
-        let buffer = (*window).buffer;
-        let win_width = (*window).width;
+        let target = window_text_target(window, min_y);
+        const MAX_TEXT_LENGTH: usize = 1024;
+        let mut start = 0;
+        let mut i = 0;
         
-        for row in 0..8 {
-            for col in 0..8 {
-                if (glyph[row] & (1 << (7 - col))) != 0 {
-                    let px = x + col as i32;
-                    let py = y + row as i32;
-                    
-                    if px >= 0 && py >= 0 && px < (*window).width as i32 && py < (*window).height as i32 {
-                        let index = (py as u32 * win_width + px as u32) as usize;
-                        *buffer.add(index) = color;
-                    }
+        loop {
+            let ch = if i < MAX_TEXT_LENGTH { *text.add(i) } else { 0 };
+            if ch == 0 || ch == b'\n' {
+                if i > start {
+                    gpu_draw_text(&target, x, y, text.add(start), (i - start) as u32, SYSTEM_FONT, 1, color, 0, 0);
+                }
+                if ch == 0 {
+                    break;
                 }
+                start = i + 1;
             }
+            i += 1;
+        }
+    }
+}
+
+fn window_text_target(window: *mut Window, min_y: i32) -> GpuTextTarget {
+    unsafe {
+        let top = min_y.max(0).min((*window).height as i32);
+        GpuTextTarget {
+            buffer: (*window).buffer,
+            pitch: (*window).width,
+            clip_x: 0,
+            clip_y: top,
+            clip_width: (*window).width,
+            clip_height: (*window).height - top as u32,
+        }
+    }
+}
+
+// FNV-1a over a NUL-terminated title, used to detect title changes
+fn title_hash(title: &[u8; 64]) -> u32 {
+    let mut hash: u32 = 0x811c9dc5;
+    for &b in title.iter() {
+        if b == 0 {
+            break;
         }
+        hash = (hash ^ b as u32).wrapping_mul(0x01000193);
     }
+    hash
 }
 
 // FFI Functions
@@ -1479,7 +2153,7 @@ pub extern "C" fn wm_invalidate_window(window: *mut Window) {
 pub extern "C" fn wm_clear_window(window: *mut Window, color: u32) {
     unsafe {
         if let Some(ref mut wm) = WM_STATE {
-            wm.clear_window(window, color);
+            wm.client_clear_window(window, color);
         }
     }
 }
@@ -1488,7 +2162,7 @@ pub extern "C" fn wm_clear_window(window: *mut Window, color: u32) {
 pub extern "C" fn wm_draw_pixel_to_window(window: *mut Window, x: c_int, y: c_int, color: u32) {
     unsafe {
         if let Some(ref mut wm) = WM_STATE {
-            wm.draw_pixel_to_window(window, x, y, color);
+            wm.client_draw_pixel(window, x, y, color);
         }
     }
 }
@@ -1504,7 +2178,7 @@ pub extern "C" fn wm_draw_filled_rect_to_window(
 ) {
     unsafe {
         if let Some(ref mut wm) = WM_STATE {
-            wm.draw_filled_rect_to_window(window, x, y, width, height, color);
+            wm.client_draw_filled_rect(window, x, y, width, height, color);
         }
     }
 }
@@ -1520,7 +2194,7 @@ pub extern "C" fn wm_draw_rect_to_window(
 ) {
     unsafe {
         if let Some(ref mut wm) = WM_STATE {
-            wm.draw_rect_to_window(window, x, y, width, height, color);
+            wm.client_draw_rect(window, x, y, width, height, color);
         }
     }
 }
@@ -1535,7 +2209,34 @@ pub extern "C" fn wm_draw_text_to_window(
 ) {
     unsafe {
         if let Some(ref mut wm) = WM_STATE {
-            wm.draw_text_to_window(window, text, x, y, color);
+            wm.client_draw_text(window, text, x, y, color);
+        }
+    }
+}
+
+// Size of the content rectangle client drawing is relative to
+#[no_mangle]
+pub extern "C" fn wm_get_content_size(window: *mut Window, width: *mut u32, height: *mut u32) {
+    unsafe {
+        if window.is_null() {
+            return;
+        }
+        if !width.is_null() {
+            *width = (*window).width;
+        }
+        if !height.is_null() {
+            *height = (*window).height.saturating_sub(TITLE_BAR_HEIGHT);
+        }
+    }
+}
+
+// Topmost window under a point, for the host hit-testing benchmark
+#[cfg(feature = "host")]
+pub fn wm_window_at(x: c_int, y: c_int) -> *mut Window {
+    unsafe {
+        match WM_STATE {
+            Some(ref wm) => wm.window_at(x, y).unwrap_or(ptr::null_mut()),
+            None => ptr::null_mut(),
         }
     }
 }
@@ -1549,12 +2250,130 @@ pub extern "C" fn wm_handle_mouse(mouse_x: c_int, mouse_y: c_int, left_button: b
     }
 }
 
+// Drain the kernel input queue: pointer events go to the window manager (if
+// running), key events back to the keyboard driver for read_key()
+fn drain_input() {
+    unsafe {
+        let mut event = InputEvent { kind: 0, buttons: 0, key: 0, scancode: 0, x: 0, y: 0, wheel: 0, timestamp: 0 };
+        let mut handled: u64 = 0;
+        while input_pop(&mut event) {
+            handled += 1;
+            match event.kind {
+                INPUT_EVENT_KEY => keyboard_deliver(event.key as c_char),
+                INPUT_EVENT_MOTION | INPUT_EVENT_BUTTON => {
+                    if let Some(ref mut wm) = WM_STATE {
+                        wm.handle_mouse(event.x, event.y, (event.buttons & MOUSE_LEFT_BUTTON) != 0);
+                    }
+                }
+                _ => {} // No scrollable windows yet, wheel events are dropped
+            }
+        }
+        if handled > 0 {
+            trace_emit(TRACE_INPUT, TRACE_INSTANT, handled, 0, 0);
+        }
+    }
+}
+
+// Run `callback` once per frame for `window` until it returns false or the
+// window is destroyed. The window is redrawn after every step.
+// Returns the animation id, or 0 if the animation table is full.
+#[no_mangle]
+pub extern "C" fn wm_animate(window: *mut Window, callback: AnimationCallback, user_data: *mut c_void) -> u32 {
+    unsafe {
+        if let Some(ref mut wm) = WM_STATE {
+            wm.animate(window, callback, user_data)
+        } else {
+            0
+        }
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn wm_animate_window_move(window: *mut Window, x: c_int, y: c_int, duration_ms: u32) -> u32 {
+    unsafe {
+        if let Some(ref mut wm) = WM_STATE {
+            wm.animate_move(window, x, y, duration_ms)
+        } else {
+            0
+        }
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn wm_animate_window_resize(window: *mut Window, width: u32, height: u32, duration_ms: u32) -> u32 {
+    unsafe {
+        if let Some(ref mut wm) = WM_STATE {
+            wm.animate_resize(window, width, height, duration_ms)
+        } else {
+            0
+        }
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn wm_animation_stop(id: u32) {
+    unsafe {
+        if let Some(ref mut wm) = WM_STATE {
+            wm.stop_animation(id);
+        }
+    }
+}
+
+// Thumbnail of a minimized window (XRGB8888, pitch = width), or null if the
+// window is not minimized or has none
+#[no_mangle]
+pub extern "C" fn wm_get_thumbnail(window: *mut Window, width: *mut u32, height: *mut u32) -> *const u32 {
+    unsafe {
+        if window.is_null() || !(*window).minimized {
+            return ptr::null();
+        }
+        let slot = (*window).id as usize;
+        if slot >= 32 {
+            return ptr::null();
+        }
+        match find_thumbnail(slot) {
+            Some(index) => {
+                let thumbnail = THUMBNAILS[index].as_mut().unwrap();
+                THUMBNAIL_CLOCK = THUMBNAIL_CLOCK.wrapping_add(1);
+                thumbnail.last_used = THUMBNAIL_CLOCK;
+                if !width.is_null() {
+                    *width = thumbnail.width;
+                }
+                if !height.is_null() {
+                    *height = thumbnail.height;
+                }
+                (ptr::addr_of!(THUMBNAIL_POOL[index])) as *const u32
+            }
+            None => ptr::null(),
+        }
+    }
+}
+
+#[no_mangle]
+pub extern "C" fn wm_frame_pending() -> bool {
+    unsafe {
+        if let Some(ref wm) = WM_STATE {
+            wm.frame_pending()
+        } else {
+            false
+        }
+    }
+}
+
+// One frame: process all queued input, then render
 #[no_mangle]
 pub extern "C" fn wm_update() {
     unsafe {
+        let window_count = match WM_STATE {
+            Some(ref wm) => wm.window_count as u64,
+            None => 0,
+        };
+        trace_emit(TRACE_WM_FRAME, TRACE_BEGIN, window_count, 0, 0);
+        drain_input();
         if let Some(ref mut wm) = WM_STATE {
             wm.update();
         }
+        trace_emit(TRACE_WM_FRAME, TRACE_END, window_count, 0, 0);
     }
 }
 
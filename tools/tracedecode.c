@@ -0,0 +1,183 @@
+// Decode a serial capture of the kernel's binary trace stream (kernel/src/trace.h)
+// into Chrome trace JSON, viewable in chrome://tracing or ui.perfetto.dev.
+//
+// Usage: tracedecode <serial capture> [output.json]
+//
+// Text printed on the same serial line (the kernel log) is skipped: packets are
+// found by their two magic bytes and checked for a known type.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_MAGIC0 0xfe
+#define TRACE_MAGIC1 0xa5
+#define TRACE_VERSION 1
+
+#define TRACE_PACKET_INFO   1
+#define TRACE_PACKET_STRING 2
+#define TRACE_PACKET_EVENT  3
+#define TRACE_PACKET_LOST   4
+
+#define MAX_EVENTS   65536
+#define MAX_CPUS     256
+#define INFO_SIZE    12  // u32 version, u64 tsc_hz
+#define RECORD_SIZE  40  // trace_record_t (must match kernel/src/trace.h)
+
+static char *event_names[MAX_EVENTS];
+static uint64_t tsc_hz = 0;
+static uint64_t first_tsc = 0;
+static int have_first_tsc = 0;
+static uint32_t next_seq[MAX_CPUS];
+static int seen_cpu[MAX_CPUS];
+static uint64_t lost_events = 0;
+
+static uint64_t read_le(const uint8_t *p, int bytes) {
+    uint64_t value = 0;
+    for (int i = bytes - 1; i >= 0; i--) {
+        value = (value << 8) | p[i];
+    }
+    return value;
+}
+
+static void print_name(FILE *out, const char *name) {
+    for (; *name; name++) {
+        if (*name == '"' || *name == '\\') {
+            fputc('\\', out);
+        }
+        fputc(*name, out);
+    }
+}
+
+// Timestamps in microseconds from the first event; raw TSC counts if the
+// kernel had no calibrated frequency
+static double event_time(uint64_t tsc) {
+    if (!have_first_tsc) {
+        first_tsc = tsc;
+        have_first_tsc = 1;
+    }
+    uint64_t delta = tsc - first_tsc;
+    if (tsc_hz == 0) {
+        return (double)delta;
+    }
+    return (double)delta * 1000000.0 / (double)tsc_hz;
+}
+
+static void emit_event(FILE *out, const uint8_t *rec, int *first) {
+    uint64_t tsc = read_le(rec, 8);
+    uint32_t seq = (uint32_t)read_le(rec + 8, 4);
+    uint16_t event = (uint16_t)read_le(rec + 12, 2);
+    uint8_t cpu = rec[14];
+    char phase = (char)rec[15];
+    uint64_t args[3];
+    for (int i = 0; i < 3; i++) {
+        args[i] = read_le(rec + 16 + i * 8, 8);
+    }
+    
+    // Sequence gaps are events the kernel dropped with a full ring
+    if (seen_cpu[cpu] && seq != next_seq[cpu]) {
+        lost_events += (uint32_t)(seq - next_seq[cpu]);
+    }
+    seen_cpu[cpu] = 1;
+    next_seq[cpu] = seq + 1;
+    
+    fprintf(out, "%s\n  {\"name\":\"", *first ? "" : ",");
+    *first = 0;
+    if (event_names[event]) {
+        print_name(out, event_names[event]);
+    } else {
+        fprintf(out, "event_%u", event);
+    }
+    fprintf(out, "\",\"ph\":\"%c\",\"ts\":%.3f,\"pid\":0,\"tid\":%u", phase, event_time(tsc), cpu);
+    if (phase == 'i') {
+        fprintf(out, ",\"s\":\"t\"");
+    }
+    fprintf(out, ",\"args\":{\"a0\":%llu,\"a1\":%llu,\"a2\":%llu}}",
+            (unsigned long long)args[0], (unsigned long long)args[1], (unsigned long long)args[2]);
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "usage: %s <serial capture> [output.json]\n", argv[0]);
+        return 1;
+    }
+    
+    FILE *in = fopen(argv[1], "rb");
+    if (!in) {
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(in, 0, SEEK_END);
+    long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    uint8_t *data = malloc(size > 0 ? (size_t)size : 1);
+    if (!data || fread(data, 1, (size_t)size, in) != (size_t)size) {
+        fprintf(stderr, "%s: read failed\n", argv[1]);
+        return 1;
+    }
+    fclose(in);
+    
+    FILE *out = stdout;
+    if (argc == 3) {
+        out = fopen(argv[2], "w");
+        if (!out) {
+            perror(argv[2]);
+            return 1;
+        }
+    }
+    
+    fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+    int first = 1;
+    uint64_t events = 0;
+    long pos = 0;
+    
+    while (pos + 3 <= size) {
+        if (data[pos] != TRACE_MAGIC0 || data[pos + 1] != TRACE_MAGIC1) {
+            pos++;
+            continue;
+        }
+        uint8_t type = data[pos + 2];
+        const uint8_t *payload = data + pos + 3;
+        long remaining = size - pos - 3;
+        
+        if (type == TRACE_PACKET_INFO && remaining >= INFO_SIZE) {
+            uint32_t version = (uint32_t)read_le(payload, 4);
+            if (version != TRACE_VERSION) {
+                fprintf(stderr, "warning: trace version %u, decoder expects %u\n", version, TRACE_VERSION);
+            }
+            tsc_hz = read_le(payload + 4, 8);
+            pos += 3 + INFO_SIZE;
+        } else if (type == TRACE_PACKET_STRING && remaining >= 3 && remaining >= 3 + payload[2]) {
+            uint16_t id = (uint16_t)read_le(payload, 2);
+            uint8_t length = payload[2];
+            free(event_names[id]);
+            event_names[id] = malloc(length + 1u);
+            memcpy(event_names[id], payload + 3, length);
+            event_names[id][length] = '\0';
+            pos += 3 + 3 + length;
+        } else if (type == TRACE_PACKET_EVENT && remaining >= RECORD_SIZE) {
+            emit_event(out, payload, &first);
+            events++;
+            pos += 3 + RECORD_SIZE;
+        } else if (type == TRACE_PACKET_LOST && remaining >= 4) {
+            // Already accounted for through sequence gaps
+            pos += 3 + 4;
+        } else {
+            pos++;  // Magic bytes inside text or a truncated packet
+        }
+    }
+    
+    fprintf(out, "\n]}\n");
+    if (out != stdout) {
+        fclose(out);
+    }
+    
+    fprintf(stderr, "%llu events decoded, %llu lost, tsc %llu Hz\n",
+            (unsigned long long)events, (unsigned long long)lost_events, (unsigned long long)tsc_hz);
+    if (tsc_hz == 0) {
+        fprintf(stderr, "warning: no TSC frequency in the capture, timestamps are in cycles\n");
+    }
+    free(data);
+    return 0;
+}